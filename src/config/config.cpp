@@ -1,6 +1,7 @@
 #include "config/config.h"
 
 #include "storage/pager/pager.h"
+#include "storage/wal/wal_record.h"
 
 #include <limits>
 #include <toml++/toml.h>
@@ -39,6 +40,25 @@ std::optional<Config> ConfigLoader::LoadFromFile(const std::filesystem::path& pa
     cfg.inline_threshold = *inline_threshold;
   }
 
+  if (const auto inline_rules = table["inline_rules"]) {
+    const auto* rules = inline_rules.as_array();
+    if (rules == nullptr) {
+      return std::nullopt;
+    }
+    for (const auto& node : *rules) {
+      const auto* rule = node.as_table();
+      if (rule == nullptr) {
+        return std::nullopt;
+      }
+      const auto prefix = (*rule)["prefix"].value<std::string>();
+      const auto threshold = (*rule)["threshold"].value<std::uint32_t>();
+      if (!prefix || !threshold) {
+        return std::nullopt;
+      }
+      cfg.inline_rules.push_back(storage::InlineRule{.prefix = *prefix, .threshold = *threshold});
+    }
+  }
+
   if (const auto group_commit_latency =
           table["group_commit_max_latency_ms"].value<std::uint32_t>()) {
     cfg.group_commit_max_latency_ms = *group_commit_latency;
@@ -48,6 +68,58 @@ std::optional<Config> ConfigLoader::LoadFromFile(const std::filesystem::path& pa
     cfg.cache_bytes = *cache_bytes;
   }
 
+  if (const auto checkpoint_interval = table["checkpoint_interval_ms"].value<std::uint32_t>()) {
+    cfg.checkpoint_interval_ms = *checkpoint_interval;
+  }
+
+  if (const auto checkpoint_wal_bytes = table["checkpoint_wal_bytes"].value<std::uint64_t>()) {
+    cfg.checkpoint_wal_bytes = *checkpoint_wal_bytes;
+  }
+
+  if (const auto checkpoint_bandwidth =
+          table["checkpoint_max_bytes_per_second"].value<std::uint64_t>()) {
+    cfg.checkpoint_max_bytes_per_second = *checkpoint_bandwidth;
+  }
+
+  if (const auto checkpoint_iops = table["checkpoint_max_iops"].value<std::uint32_t>()) {
+    cfg.checkpoint_max_iops = *checkpoint_iops;
+  }
+
+  if (const auto wal_segment_bytes = table["wal_segment_bytes"].value<std::uint64_t>()) {
+    cfg.wal_segment_bytes = *wal_segment_bytes;
+  }
+
+  if (const auto sweep_interval = table["ttl_sweep_interval_ms"].value<std::uint32_t>()) {
+    cfg.ttl_sweep_interval_ms = *sweep_interval;
+  }
+
+  if (const auto sweep_batch = table["ttl_sweep_batch"].value<std::uint32_t>()) {
+    cfg.ttl_sweep_batch = *sweep_batch;
+  }
+
+  if (const auto sweep_rate = table["ttl_sweep_max_per_second"].value<std::uint64_t>()) {
+    cfg.ttl_sweep_max_per_second = *sweep_rate;
+  }
+
+  if (const auto vlog_segment_bytes = table["vlog_segment_bytes"].value<std::uint64_t>()) {
+    cfg.vlog_segment_bytes = *vlog_segment_bytes;
+  }
+
+  if (const auto gc_interval = table["vlog_gc_interval_ms"].value<std::uint32_t>()) {
+    cfg.vlog_gc_interval_ms = *gc_interval;
+  }
+
+  if (const auto gc_live_ratio = table["vlog_gc_max_live_ratio"].value<double>()) {
+    cfg.vlog_gc_max_live_ratio = *gc_live_ratio;
+  }
+
+  if (const auto wal_schema = table["wal_schema"].value<std::string>()) {
+    if (!storage::wal::ParseWalSchema(*wal_schema).has_value()) {
+      return std::nullopt;
+    }
+    cfg.wal_schema = *wal_schema;
+  }
+
   if (const auto listen_address = table["listen_address"].value<std::string>()) {
     if (listen_address->empty()) {
       return std::nullopt;
@@ -75,6 +147,10 @@ std::optional<Config> ConfigLoader::LoadFromFile(const std::filesystem::path& pa
     return std::nullopt;
   }
 
+  if (!storage::InlineRulesValid(cfg.inline_rules, payload_size)) {
+    return std::nullopt;
+  }
+
   if (cfg.group_commit_max_latency_ms == 0) {
     return std::nullopt;
   }
@@ -83,6 +159,23 @@ std::optional<Config> ConfigLoader::LoadFromFile(const std::filesystem::path& pa
     return std::nullopt;
   }
 
+  if (cfg.checkpoint_interval_ms == 0 || cfg.checkpoint_wal_bytes == 0) {
+    return std::nullopt;
+  }
+
+  if (cfg.wal_segment_bytes == 0 || cfg.vlog_segment_bytes == 0) {
+    return std::nullopt;
+  }
+
+  if (cfg.ttl_sweep_interval_ms == 0 || cfg.ttl_sweep_batch == 0) {
+    return std::nullopt;
+  }
+
+  if (cfg.vlog_gc_interval_ms == 0 || !(cfg.vlog_gc_max_live_ratio >= 0.0) ||
+      cfg.vlog_gc_max_live_ratio >= 1.0) {
+    return std::nullopt;
+  }
+
   return cfg;
 }
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "storage/storage_common.h"
+
 #include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace jubilant::config {
 
@@ -11,8 +14,37 @@ struct Config {
   std::filesystem::path db_path;
   std::uint32_t page_size{4096};
   std::uint32_t inline_threshold{1024};
+  // Per-key-prefix inline thresholds, from [[inline_rules]] tables. Like inline_threshold they are
+  // recorded in the MANIFEST when a database is created.
+  std::vector<storage::InlineRule> inline_rules;
   std::uint32_t group_commit_max_latency_ms{5};
+  // Memory for caching. The value-log read cache holds all of it until a page cache shares it.
   std::uint64_t cache_bytes{64ULL * 1024ULL * 1024ULL};
+  // The background checkpointer runs once this interval passes or the WAL grows by
+  // checkpoint_wal_bytes, whichever comes first.
+  std::uint32_t checkpoint_interval_ms{1000};
+  std::uint64_t checkpoint_wal_bytes{64ULL * 1024ULL * 1024ULL};
+  // I/O budget for checkpoint page writes; 0 leaves a dimension unthrottled. The checkpointer
+  // raises it by up to 4x while the WAL outgrows checkpoint_wal_bytes.
+  std::uint64_t checkpoint_max_bytes_per_second{0};
+  std::uint32_t checkpoint_max_iops{0};
+  // The active WAL segment is sealed at the first checkpoint after it reaches this size; sealed
+  // segments are deleted once a checkpoint covers them.
+  std::uint64_t wal_segment_bytes{64ULL * 1024ULL * 1024ULL};
+  // Every ttl_sweep_interval_ms the TTL sweeper erases expired records and logs their tombstones,
+  // ttl_sweep_batch per WAL transaction and at most ttl_sweep_max_per_second (0: unlimited).
+  std::uint32_t ttl_sweep_interval_ms{1000};
+  std::uint32_t ttl_sweep_batch{256};
+  std::uint64_t ttl_sweep_max_per_second{10000};
+  // Value-log segments roll over at this size; GC reclaims space one whole segment at a time.
+  std::uint64_t vlog_segment_bytes{64ULL * 1024ULL * 1024ULL};
+  // Every vlog_gc_interval_ms a GC pass compacts the segments whose live ratio has fallen to
+  // vlog_gc_max_live_ratio; the next checkpoint then deletes them.
+  std::uint32_t vlog_gc_interval_ms{10000};
+  double vlog_gc_max_live_ratio{0.5};
+  // WAL encoding recorded in the MANIFEST when a database is created ("wal-v2" or
+  // "wal-compact-v1"). Existing databases keep the schema their manifest already names.
+  std::string wal_schema{"wal-v2"};
   std::string listen_address{"127.0.0.1"};
   std::uint16_t listen_port{6767};
 };
@@ -1,33 +1,108 @@
 #include "lock/lock_manager.h"
 
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
 namespace jubilant::lock {
 
+LockManager::LockManager(std::size_t stripe_count)
+    : stripe_count_(std::max<std::size_t>(stripe_count, 1)),
+      stripes_(std::make_unique<Stripe[]>(stripe_count_)) {}
+
 void LockManager::Acquire(const std::string& key, LockMode mode) {
-  auto& mutex = MutexFor(key);
+  auto& stripe = StripeFor(key);
+  Entry* entry = nullptr;
+  {
+    std::scoped_lock guard(stripe.mutex);
+    entry = &stripe.entries[key];
+    ++entry->references;
+  }
+
+  // Blocks outside the stripe mutex, so a waiter never holds up other keys on its stripe.
   if (mode == LockMode::kShared) {
-    mutex.lock_shared();
+    entry->mutex.lock_shared();
   } else {
-    mutex.lock();
+    entry->mutex.lock();
   }
 }
 
 void LockManager::Release(const std::string& key, LockMode mode) {
-  std::scoped_lock guard(map_mutex_);
-  auto mutex_iter = mutexes_.find(key);
-  if (mutex_iter == mutexes_.end()) {
+  auto& stripe = StripeFor(key);
+  std::scoped_lock guard(stripe.mutex);
+  const auto entry_iter = stripe.entries.find(key);
+  if (entry_iter == stripe.entries.end()) {
     return;
   }
 
+  auto& entry = entry_iter->second;
   if (mode == LockMode::kShared) {
-    mutex_iter->second.unlock_shared();
+    entry.mutex.unlock_shared();
   } else {
-    mutex_iter->second.unlock();
+    entry.mutex.unlock();
+  }
+  // A waiter still counts as a reference, so the mutex it blocks on is never freed under it.
+  if (--entry.references == 0) {
+    stripe.entries.erase(entry_iter);
+  }
+}
+
+std::size_t LockManager::active_keys() const {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < stripe_count_; ++i) {
+    std::scoped_lock guard(stripes_[i].mutex);
+    count += stripes_[i].entries.size();
+  }
+  return count;
+}
+
+LockSet::LockSet(LockManager& manager) : manager_(manager) {}
+
+LockSet::~LockSet() {
+  ReleaseAll();
+}
+
+void LockSet::Declare(const std::string& key, LockMode mode) {
+  if (held_ != 0) {
+    throw std::logic_error("Lock set already acquired");
+  }
+  auto [iter, inserted] = keys_.try_emplace(key, mode);
+  if (!inserted && mode == LockMode::kExclusive) {
+    iter->second = LockMode::kExclusive;
+  }
+}
+
+void LockSet::AcquireAll() {
+  if (held_ != 0) {
+    return;
+  }
+  for (const auto& [key, mode] : keys_) {
+    manager_.Acquire(key, mode);
+    ++held_;
+  }
+}
+
+void LockSet::ReleaseAll() {
+  auto iter = keys_.begin();
+  for (; held_ > 0; --held_, ++iter) {
+    manager_.Release(iter->first, iter->second);
+  }
+}
+
+std::size_t LockSet::size() const noexcept {
+  return keys_.size();
+}
+
+std::optional<LockMode> LockSet::mode(const std::string& key) const {
+  const auto iter = keys_.find(key);
+  if (iter == keys_.end()) {
+    return std::nullopt;
   }
+  return iter->second;
 }
 
-std::shared_mutex& LockManager::MutexFor(const std::string& key) {
-  std::scoped_lock guard(map_mutex_);
-  return mutexes_[key];
+LockManager::Stripe& LockManager::StripeFor(const std::string& key) const {
+  return stripes_[std::hash<std::string>{}(key) % stripe_count_];
 }
 
 } // namespace jubilant::lock
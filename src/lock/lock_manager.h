@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
@@ -10,18 +14,71 @@ namespace jubilant::lock {
 
 enum class LockMode : std::uint8_t { kShared, kExclusive };
 
+// Per-key reader/writer locks. A hash of the key picks one of stripe_count stripes, each with its
+// own table, so traffic on different keys rarely meets on the same mutex. An entry lives only
+// while some caller holds or waits for its key, so memory follows the active locks, not every key
+// ever touched.
 class LockManager {
 public:
-  LockManager() = default;
+  static constexpr std::size_t kDefaultStripeCount = 64;
+
+  explicit LockManager(std::size_t stripe_count = kDefaultStripeCount);
 
   void Acquire(const std::string& key, LockMode mode);
   void Release(const std::string& key, LockMode mode);
 
+  // Keys currently held or waited for.
+  [[nodiscard]] std::size_t active_keys() const;
+
 private:
-  std::shared_mutex& MutexFor(const std::string& key);
+  struct Entry {
+    std::shared_mutex mutex;
+    // Holders plus waiters; the entry is freed when it drops to zero.
+    std::size_t references{0};
+  };
+
+  // Padded to a cache line so neighbouring stripes' mutexes do not share one.
+  struct alignas(64) Stripe {
+    mutable std::mutex mutex;
+    // Node-based, so an entry stays put while its key is locked outside the stripe mutex.
+    std::unordered_map<std::string, Entry> entries;
+  };
+
+  Stripe& StripeFor(const std::string& key) const;
+
+  std::size_t stripe_count_;
+  std::unique_ptr<Stripe[]> stripes_;
+};
 
-  std::mutex map_mutex_;
-  std::unordered_map<std::string, std::shared_mutex> mutexes_;
+// One transaction's locks under strict two-phase locking. Every key it will touch is declared
+// first, at the strongest mode any of its operations needs, so a held lock never has to be
+// upgraded. AcquireAll() then takes them in key order, the one order every set uses, so two sets
+// can never wait on each other. The locks stay held until ReleaseAll() or destruction.
+class LockSet {
+public:
+  explicit LockSet(LockManager& manager);
+  ~LockSet();
+
+  LockSet(const LockSet&) = delete;
+  LockSet& operator=(const LockSet&) = delete;
+  LockSet(LockSet&&) = delete;
+  LockSet& operator=(LockSet&&) = delete;
+
+  // Only before AcquireAll(). Declaring a key again keeps the stronger of the two modes.
+  void Declare(const std::string& key, LockMode mode);
+  void AcquireAll();
+  void ReleaseAll();
+
+  [[nodiscard]] std::size_t size() const noexcept;
+  // The mode key was declared at, if it was.
+  [[nodiscard]] std::optional<LockMode> mode(const std::string& key) const;
+
+private:
+  LockManager& manager_;
+  // Ordered, so iteration is the canonical acquisition order.
+  std::map<std::string, LockMode> keys_;
+  // How many keys_, from the front, are currently held.
+  std::size_t held_{0};
 };
 
 } // namespace jubilant::lock
@@ -2,6 +2,7 @@
 
 #include "disk_generated.h"
 #include "storage/pager/pager.h"
+#include "storage/wal/wal_record.h"
 
 #include <filesystem>
 #include <flatbuffers/flatbuffers.h>
@@ -19,7 +20,7 @@ ManifestRecord ManifestStore::NewDefault(std::string uuid_seed) {
   manifest.db_uuid = std::move(uuid_seed);
   manifest.wire_schema = "wire-v1";
   manifest.disk_schema = "disk-v1";
-  manifest.wal_schema = "wal-v1";
+  manifest.wal_schema = std::string{storage::wal::kWalSchemaFlatBuffer};
   return manifest;
 }
 
@@ -70,6 +71,17 @@ std::optional<ManifestRecord> ManifestStore::Load() const {
   if (manifest_fb->hash_algorithm() != nullptr) {
     record.hash_algorithm = manifest_fb->hash_algorithm()->str();
   }
+  if (const auto* rules = manifest_fb->inline_rules(); rules != nullptr) {
+    for (flatbuffers::uoffset_t i = 0; i < rules->size(); ++i) {
+      const auto* rule = rules->Get(i);
+      storage::InlineRule parsed{};
+      if (rule->prefix() != nullptr) {
+        parsed.prefix = rule->prefix()->str();
+      }
+      parsed.threshold = rule->threshold();
+      record.inline_rules.push_back(std::move(parsed));
+    }
+  }
 
   const auto validation = Validate(record);
   if (!validation.ok) {
@@ -99,6 +111,10 @@ ManifestValidationResult ManifestStore::Validate(const ManifestRecord& manifest)
   } else if (manifest.inline_threshold == 0 || manifest.inline_threshold >= payload_size) {
     result.ok = false;
     result.message = "inline_threshold must be within (0, payload_size)";
+  } else if (!storage::InlineRulesValid(manifest.inline_rules, payload_size)) {
+    result.ok = false;
+    result.message = "inline_rules need unique, non-empty prefixes and thresholds within "
+                     "(0, payload_size)";
   } else if (manifest.db_uuid.empty()) {
     result.ok = false;
     result.message = "db_uuid must be populated";
@@ -111,6 +127,10 @@ ManifestValidationResult ManifestStore::Validate(const ManifestRecord& manifest)
   } else if (manifest.wal_schema.empty()) {
     result.ok = false;
     result.message = "wal_schema must be populated";
+  } else if (!storage::wal::ParseWalSchema(manifest.wal_schema).has_value() &&
+             !storage::wal::IsRetiredWalSchema(manifest.wal_schema)) {
+    result.ok = false;
+    result.message = "wal_schema must name a supported WAL encoding";
   } else if (manifest.hash_algorithm.empty()) {
     result.ok = false;
     result.message = "hash_algorithm must be populated";
@@ -145,11 +165,18 @@ bool ManifestStore::Persist(ManifestRecord& manifest) {
   const auto disk_schema = builder.CreateString(manifest.disk_schema);
   const auto wal_schema = builder.CreateString(manifest.wal_schema);
   const auto hash_algorithm = builder.CreateString(manifest.hash_algorithm);
-
-  const auto manifest_offset =
-      disk::CreateManifest(builder, manifest.generation, manifest.format_major,
-                           manifest.format_minor, manifest.page_size, manifest.inline_threshold,
-                           uuid_vec, wire_schema, disk_schema, wal_schema, hash_algorithm);
+  std::vector<flatbuffers::Offset<disk::InlineRule>> rule_offsets;
+  rule_offsets.reserve(manifest.inline_rules.size());
+  for (const auto& rule : manifest.inline_rules) {
+    rule_offsets.push_back(
+        disk::CreateInlineRule(builder, builder.CreateString(rule.prefix), rule.threshold));
+  }
+  const auto inline_rules = builder.CreateVector(rule_offsets);
+
+  const auto manifest_offset = disk::CreateManifest(
+      builder, manifest.generation, manifest.format_major, manifest.format_minor,
+      manifest.page_size, manifest.inline_threshold, uuid_vec, wire_schema, disk_schema,
+      wal_schema, hash_algorithm, inline_rules);
 
   builder.FinishSizePrefixed(manifest_offset, disk::ManifestIdentifier());
 
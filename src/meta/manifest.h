@@ -1,9 +1,12 @@
 #pragma once
 
+#include "storage/storage_common.h"
+
 #include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace jubilant::meta {
 
@@ -18,6 +21,9 @@ struct ManifestRecord {
   // SegmentPointer {segment_id, offset, length} instead of inline bytes. Persisted here so WAL,
   // value log, and B+Tree encode/decode decisions stay consistent.
   std::uint32_t inline_threshold{1024};
+  // Per-key-prefix overrides of inline_threshold, fixed when the database is created for the same
+  // reason the threshold is.
+  std::vector<storage::InlineRule> inline_rules;
   std::string db_uuid;
   std::string wire_schema;
   std::string disk_schema;
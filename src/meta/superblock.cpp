@@ -2,13 +2,50 @@
 
 #include "storage/checksum.h"
 
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <span>
+#include <unistd.h>
 #include <utility>
 
 namespace jubilant::meta {
 
+namespace {
+
+// Layout written before superblocks recorded the checkpoint's WAL position; still readable.
+struct PersistedV1 {
+  std::uint64_t generation;
+  std::uint64_t root_page_id;
+  std::uint64_t last_checkpoint_lsn;
+  std::uint64_t wall_base;
+  std::uint64_t mono_base;
+  std::uint64_t crc;
+};
+
+struct Persisted {
+  std::uint64_t generation;
+  std::uint64_t root_page_id;
+  std::uint64_t last_checkpoint_lsn;
+  std::uint64_t wall_base;
+  std::uint64_t mono_base;
+  std::uint64_t checkpoint_wal_segment;
+  std::uint64_t checkpoint_wal_offset;
+  std::uint64_t crc;
+};
+
+// The CRC covers every field before it.
+template <typename Layout> std::uint64_t PayloadCrc(const Layout& persisted) {
+  return storage::ComputeCrc32(std::span<const std::byte>(
+      reinterpret_cast<const std::byte*>(&persisted), sizeof(Layout) - sizeof(std::uint64_t)));
+}
+
+template <typename Layout> bool CrcMatches(const Layout& persisted) {
+  return PayloadCrc(persisted) == persisted.crc;
+}
+
+} // namespace
+
 SuperBlockStore::SuperBlockStore(const std::filesystem::path& base_dir)
     : path_a_(base_dir / "SUPERBLOCK_A"), path_b_(path_a_.parent_path() / "SUPERBLOCK_B") {}
 
@@ -23,32 +60,41 @@ std::optional<SuperBlock> SuperBlockStore::LoadActive() const {
       return std::nullopt;
     }
 
-    struct Persisted {
-      std::uint64_t generation;
-      std::uint64_t root_page_id;
-      std::uint64_t last_checkpoint_lsn;
-      std::uint64_t wall_base;
-      std::uint64_t mono_base;
-      std::uint64_t crc;
-    };
-
-    Persisted persisted{};
-    input_stream.read(reinterpret_cast<char*>(&persisted), sizeof(Persisted));
-    if (!input_stream) {
+    std::error_code size_error;
+    const auto file_bytes = std::filesystem::file_size(path, size_error);
+    if (size_error) {
       return std::nullopt;
     }
 
-    const auto payload_span = std::span<const std::byte>(
-        reinterpret_cast<const std::byte*>(&persisted), sizeof(Persisted) - sizeof(std::uint64_t));
-    const auto crc = storage::ComputeCrc32(payload_span);
-    if (crc != persisted.crc) {
-      return std::nullopt;
+    Persisted persisted{};
+    if (file_bytes == sizeof(PersistedV1)) {
+      PersistedV1 legacy{};
+      input_stream.read(reinterpret_cast<char*>(&legacy), sizeof(PersistedV1));
+      if (!input_stream || !CrcMatches(legacy)) {
+        return std::nullopt;
+      }
+      // No WAL position was recorded, so replay starts from the oldest segment.
+      persisted = Persisted{.generation = legacy.generation,
+                            .root_page_id = legacy.root_page_id,
+                            .last_checkpoint_lsn = legacy.last_checkpoint_lsn,
+                            .wall_base = legacy.wall_base,
+                            .mono_base = legacy.mono_base,
+                            .checkpoint_wal_segment = 0,
+                            .checkpoint_wal_offset = 0,
+                            .crc = 0};
+    } else {
+      input_stream.read(reinterpret_cast<char*>(&persisted), sizeof(Persisted));
+      if (!input_stream || !CrcMatches(persisted)) {
+        return std::nullopt;
+      }
     }
 
     SuperBlock superblock{};
     superblock.generation = persisted.generation;
     superblock.root_page_id = persisted.root_page_id;
     superblock.last_checkpoint_lsn = persisted.last_checkpoint_lsn;
+    superblock.checkpoint_wal_segment = persisted.checkpoint_wal_segment;
+    superblock.checkpoint_wal_offset = persisted.checkpoint_wal_offset;
     superblock.ttl_calibration.wall_base = persisted.wall_base;
     superblock.ttl_calibration.mono_base = persisted.mono_base;
     return superblock;
@@ -85,29 +131,30 @@ bool SuperBlockStore::WriteNext(const SuperBlock& superblock) {
     return false;
   }
 
-  struct Persisted {
-    std::uint64_t generation;
-    std::uint64_t root_page_id;
-    std::uint64_t last_checkpoint_lsn;
-    std::uint64_t wall_base;
-    std::uint64_t mono_base;
-    std::uint64_t crc;
-  };
-
   Persisted persisted{};
   persisted.generation = next_generation;
   persisted.root_page_id = superblock.root_page_id;
   persisted.last_checkpoint_lsn = superblock.last_checkpoint_lsn;
   persisted.wall_base = superblock.ttl_calibration.wall_base;
   persisted.mono_base = superblock.ttl_calibration.mono_base;
-
-  const auto payload_span = std::span<const std::byte>(
-      reinterpret_cast<const std::byte*>(&persisted), sizeof(Persisted) - sizeof(std::uint64_t));
-  persisted.crc = storage::ComputeCrc32(payload_span);
+  persisted.checkpoint_wal_segment = superblock.checkpoint_wal_segment;
+  persisted.checkpoint_wal_offset = superblock.checkpoint_wal_offset;
+  persisted.crc = PayloadCrc(persisted);
 
   out.write(reinterpret_cast<const char*>(&persisted), sizeof(Persisted));
-  out.flush();
-  return out.good();
+  out.close();
+  if (!out.good()) {
+    return false;
+  }
+
+  // Checkpoints release WAL segments once this returns, so the new generation must be durable.
+  const int file_descriptor = ::open(target.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  const bool synced = ::fsync(file_descriptor) == 0;
+  ::close(file_descriptor);
+  return synced;
 }
 
 } // namespace jubilant::meta
@@ -21,6 +21,11 @@ struct SuperBlock {
   std::uint64_t generation{0};
   std::uint64_t root_page_id{0};
   std::uint64_t last_checkpoint_lsn{0};
+  // WAL position of the first record after last_checkpoint_lsn; recovery replays from here. Both
+  // zero for a database that has not checkpointed since positions were recorded, which replays
+  // every segment.
+  std::uint64_t checkpoint_wal_segment{0};
+  std::uint64_t checkpoint_wal_offset{0};
   TtlCalibration ttl_calibration{};
 };
 
@@ -113,6 +113,10 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    // The network adapter streams raw values with sendfile(2), which cannot suppress SIGPIPE per
+    // call; a client hanging up mid-transfer must fail that send, not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
     std::cout << std::unitbuf;
     std::cerr << std::unitbuf;
 
@@ -12,7 +12,9 @@
 #include <netinet/in.h>
 #include <poll.h>
 #include <ranges>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <type_traits>
 #include <unistd.h>
 #include <variant>
@@ -84,6 +86,29 @@ bool SendAll(int socket_fd, const std::byte* buffer, std::size_t length) {
   return true;
 }
 
+// Streams length bytes of file_fd starting at offset straight to the socket. Accepted sockets
+// carry SO_SNDTIMEO, so each sendfile call blocks for at most kSendTimeout: a peer that stops
+// reading fails the transfer, while a slow but steady one can take as long as the value needs.
+bool SendFileAll(int socket_fd, int file_fd, std::uint64_t offset, std::uint64_t length) {
+  auto file_offset = static_cast<off_t>(offset);
+  while (length > 0) {
+    const auto sent = ::sendfile(socket_fd, file_fd, &file_offset, length);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // EAGAIN here means a whole send timeout passed without progress.
+      return false;
+    }
+    if (sent == 0) {
+      // The segment ended early; the peer would otherwise wait for bytes that never come.
+      return false;
+    }
+    length -= static_cast<std::uint64_t>(sent);
+  }
+  return true;
+}
+
 } // namespace
 
 NetworkServer::NetworkServer(Server& core_server, Config config)
@@ -151,16 +176,16 @@ void NetworkServer::Stop() {
     return;
   }
 
+  // Shutting the listener down wakes accept(2); it is closed only once the accept thread is gone.
   if (listen_fd_ >= 0) {
     ::shutdown(listen_fd_, SHUT_RDWR);
-    ::close(listen_fd_);
-    listen_fd_ = -1;
   }
 
   {
     std::lock_guard guard(connections_mutex_);
     for (auto& connection : connections_) {
       connection->active.store(false);
+      WakeWriter(*connection);
       if (connection->fd >= 0) {
         ::shutdown(connection->fd, SHUT_RDWR);
       }
@@ -170,6 +195,10 @@ void NetworkServer::Stop() {
   if (accept_thread_.joinable()) {
     accept_thread_.join();
   }
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+  }
   if (dispatch_thread_.joinable()) {
     dispatch_thread_.join();
   }
@@ -177,19 +206,16 @@ void NetworkServer::Stop() {
   std::vector<std::shared_ptr<Connection>> to_cleanup;
   {
     std::lock_guard guard(connections_mutex_);
-    to_cleanup = std::move(connections_);
-    pending_results_.clear();
+    to_cleanup = connections_;
   }
-
   for (auto& connection : to_cleanup) {
-    if (connection->thread.joinable()) {
-      connection->thread.join();
-    }
-    if (connection->fd >= 0) {
-      ::close(connection->fd);
-      connection->fd = -1;
-    }
+    CleanupConnection(connection);
   }
+
+  // A connection thread may have started its own cleanup first; wait for it to finish.
+  std::unique_lock guard(connections_mutex_);
+  connections_cv_.wait(guard, [this]() { return connections_.empty(); });
+  pending_results_.clear();
 }
 
 bool NetworkServer::running() const noexcept {
@@ -212,6 +238,20 @@ void NetworkServer::AcceptLoop() {
       continue;
     }
 
+    // Bounds every blocking send on the socket, sendfile included.
+    const auto send_seconds = std::chrono::duration_cast<std::chrono::seconds>(kSendTimeout);
+    timeval send_timeout{};
+    send_timeout.tv_sec = static_cast<time_t>(send_seconds.count());
+    send_timeout.tv_usec = static_cast<suseconds_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(kSendTimeout - send_seconds)
+            .count());
+    ::setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+#ifdef SO_NOSIGPIPE
+    // Where the platform has it, a peer hanging up fails sendfile with EPIPE instead of SIGPIPE.
+    const int no_sigpipe = 1;
+    ::setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
     auto connection = std::make_shared<Connection>();
     connection->fd = client_fd;
 
@@ -220,12 +260,15 @@ void NetworkServer::AcceptLoop() {
       connection->peer = std::string{addr_buf} + ":" + std::to_string(ntohs(client.sin_port));
     }
 
+    connection->writer = std::thread([this, connection]() { WriterLoop(connection); });
+    connection->thread = std::thread([this, connection]() { HandleConnection(connection); });
     {
       std::lock_guard guard(connections_mutex_);
       connections_.push_back(connection);
     }
-
-    connection->thread = std::thread([this, connection]() { HandleConnection(connection); });
+    // Both threads wait for this, so a cleanup they start sees both thread handles assigned.
+    connection->started.store(true);
+    connection->started.notify_all();
   }
 }
 
@@ -252,33 +295,86 @@ void NetworkServer::DispatchLoop() {
         continue;
       }
 
-      const auto response = EncodeResponse(result);
-      const auto payload = response.dump();
-      if (!WriteFrame(connection, payload)) {
-        CleanupConnection(connection);
-        continue;
+      // Values a raw_values read left in the value log are pinned now and streamed after the JSON
+      // frame. One that can no longer be resolved is reported as a failed read.
+      std::vector<storage::vlog::PinnedRecord> raw_values;
+      for (auto& op_result : result.operations) {
+        const auto* ref = op_result.value.has_value()
+                              ? std::get_if<storage::btree::ValueLogRef>(&op_result.value->value)
+                              : nullptr;
+        if (ref == nullptr) {
+          continue;
+        }
+        auto pinned = server_.PinValue(ref->pointer);
+        if (!pinned.has_value()) {
+          op_result.success = false;
+          op_result.value.reset();
+          continue;
+        }
+        raw_values.push_back(std::move(*pinned));
       }
 
-      std::lock_guard inflight_guard(connection->inflight_mutex);
-      connection->inflight.erase(result.id);
+      auto payload = EncodeResponse(result, raw_values).dump();
+      {
+        std::lock_guard outbox_guard(connection->outbox_mutex);
+        connection->outbox.push_back(
+            PendingResponse{.payload = std::move(payload), .raw_values = std::move(raw_values)});
+      }
+      connection->outbox_cv.notify_one();
     }
   }
 }
 
+void NetworkServer::WriterLoop(const std::shared_ptr<Connection>& connection) {
+  connection->started.wait(false);
+  while (true) {
+    PendingResponse response;
+    {
+      std::unique_lock guard(connection->outbox_mutex);
+      connection->outbox_cv.wait(guard, [&connection]() {
+        return !connection->active.load() || !connection->outbox.empty();
+      });
+      if (!connection->active.load()) {
+        return;
+      }
+      response = std::move(connection->outbox.front());
+      connection->outbox.pop_front();
+    }
+
+    if (!WriteResponse(connection, response.payload, response.raw_values)) {
+      CleanupConnection(connection);
+      return;
+    }
+  }
+}
+
+void NetworkServer::WakeWriter(Connection& connection) {
+  // Taking the lock orders this wake-up after the writer's last check of active.
+  {
+    std::lock_guard guard(connection.outbox_mutex);
+  }
+  connection.outbox_cv.notify_all();
+}
+
 void NetworkServer::HandleConnection(const std::shared_ptr<Connection>& connection) {
+  connection->started.wait(false);
   while (running_.load() && connection->active.load()) {
     std::string payload;
     if (!ReadFrame(connection->fd, payload)) {
       break;
     }
 
-    const auto request = DecodeRequest(payload);
-    if (!request.has_value()) {
+    auto request = DecodeRequest(payload);
+    if (!request.has_value() || !ReceiveChunkedValues(connection->fd, *request)) {
       break;
     }
     const auto& txn_request = *request;
 
-    if (!RegisterTransaction(connection, txn_request.id)) {
+    // Async transactions are acknowledged at enqueue. Their id is still registered, with no
+    // connection, so a request reusing it is refused until it completes and the dispatcher drops
+    // the completion instead of handing it to whoever reused the id.
+    const bool async = txn_request.durability == txn::DurabilityClass::kAsync;
+    if (!RegisterTransaction(async ? nullptr : connection, txn_request.id)) {
       TransactionResult duplicate{};
       duplicate.id = txn_request.id;
       duplicate.state = txn::TransactionState::kAborted;
@@ -294,6 +390,25 @@ void NetworkServer::HandleConnection(const std::shared_ptr<Connection>& connecti
       continue;
     }
 
+    if (async) {
+      TransactionResult acknowledged{};
+      acknowledged.id = txn_request.id;
+      acknowledged.state = txn::TransactionState::kPending;
+      if (!server_.SubmitTransaction(txn_request)) {
+        acknowledged.state = txn::TransactionState::kAborted;
+        ClearTransaction(txn_request.id);
+      }
+      for (const auto& operation : txn_request.operations) {
+        OperationResult operation_result{};
+        operation_result.type = operation.type;
+        operation_result.key = operation.key;
+        acknowledged.operations.push_back(std::move(operation_result));
+      }
+      const auto response = EncodeResponse(acknowledged).dump();
+      WriteFrame(connection, response);
+      continue;
+    }
+
     if (!server_.SubmitTransaction(txn_request)) {
       TransactionResult rejected{};
       rejected.id = txn_request.id;
@@ -306,7 +421,7 @@ void NetworkServer::HandleConnection(const std::shared_ptr<Connection>& connecti
       }
       const auto response = EncodeResponse(rejected).dump();
       WriteFrame(connection, response);
-      ClearTransaction(connection, txn_request.id);
+      ClearTransaction(txn_request.id);
     }
   }
 
@@ -330,8 +445,59 @@ bool NetworkServer::ReadFrame(int socket_fd, std::string& payload) {
   return ReadExact(socket_fd, reinterpret_cast<std::byte*>(payload.data()), length);
 }
 
+bool NetworkServer::ReceiveChunkedValues(int socket_fd, txn::TransactionRequest& request) {
+  std::string chunk;
+  try {
+    for (auto& operation : request.operations) {
+      if (operation.type != txn::OperationType::kSet || !operation.value.has_value()) {
+        continue;
+      }
+      auto* ref = std::get_if<storage::btree::ValueLogRef>(&operation.value->value);
+      if (ref == nullptr) {
+        continue;
+      }
+      auto stream = server_.OpenValueStream(ref->pointer.length);
+      if (!stream.has_value()) {
+        return false;
+      }
+      while (stream->remaining() > 0) {
+        if (!ReadFrame(socket_fd, chunk) || chunk.size() > stream->remaining()) {
+          return false;
+        }
+        stream->Write(std::as_bytes(std::span<const char>(chunk)));
+      }
+      auto appended = stream->Finish();
+      ref->pointer = appended.pointer;
+      request.value_holds.push_back(std::move(appended.hold));
+    }
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
 bool NetworkServer::WriteFrame(const std::shared_ptr<Connection>& connection,
                                std::string_view payload) {
+  std::scoped_lock guard(connection->write_mutex);
+  return WriteFrameLocked(connection->fd, payload);
+}
+
+bool NetworkServer::WriteResponse(const std::shared_ptr<Connection>& connection,
+                                  std::string_view payload,
+                                  std::span<const storage::vlog::PinnedRecord> raw_values) {
+  std::scoped_lock guard(connection->write_mutex);
+  if (!WriteFrameLocked(connection->fd, payload)) {
+    return false;
+  }
+  for (const auto& raw : raw_values) {
+    if (!SendFileAll(connection->fd, raw.fd, raw.offset, raw.length)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool NetworkServer::WriteFrameLocked(int socket_fd, std::string_view payload) {
   const auto length = static_cast<std::uint32_t>(payload.size());
   if (length == 0 || length > kMaxFrameSize) {
     return false;
@@ -341,12 +507,10 @@ bool NetworkServer::WriteFrame(const std::shared_ptr<Connection>& connection,
   std::array<std::byte, 4> prefix{};
   std::memcpy(prefix.data(), &network_length, sizeof(network_length));
 
-  std::scoped_lock guard(connection->write_mutex);
-  if (!SendAll(connection->fd, prefix.data(), prefix.size())) {
+  if (!SendAll(socket_fd, prefix.data(), prefix.size())) {
     return false;
   }
-  return SendAll(connection->fd, reinterpret_cast<const std::byte*>(payload.data()),
-                 payload.size());
+  return SendAll(socket_fd, reinterpret_cast<const std::byte*>(payload.data()), payload.size());
 }
 
 void NetworkServer::CleanupConnection(const std::shared_ptr<Connection>& connection) {
@@ -356,33 +520,38 @@ void NetworkServer::CleanupConnection(const std::shared_ptr<Connection>& connect
   }
 
   connection->active.store(false);
+  WakeWriter(*connection);
   if (connection->fd >= 0) {
     ::shutdown(connection->fd, SHUT_RDWR);
-    ::close(connection->fd);
-    connection->fd = -1;
   }
 
-  if (connection->thread.joinable()) {
-    if (connection->thread.get_id() == std::this_thread::get_id()) {
-      connection->thread.detach();
+  // Both threads are done with the socket before it closes, so its number cannot be reused under
+  // a send or recv still in flight.
+  for (auto* thread : {&connection->thread, &connection->writer}) {
+    if (!thread->joinable()) {
+      continue;
+    }
+    if (thread->get_id() == std::this_thread::get_id()) {
+      thread->detach();
     } else {
-      connection->thread.join();
+      thread->join();
     }
   }
 
   std::lock_guard guard(connections_mutex_);
-  {
-    std::lock_guard inflight_guard(connection->inflight_mutex);
-    for (const auto txn_id : connection->inflight) {
-      pending_results_.erase(txn_id);
-    }
-    connection->inflight.clear();
+  // Stop reads the descriptor under this lock.
+  if (connection->fd >= 0) {
+    ::close(connection->fd);
+    connection->fd = -1;
   }
+  // Its transactions stay registered until they complete: the dispatcher drops their results,
+  // and their ids cannot be reused before then.
 
   const auto iter = std::ranges::find(connections_, connection);
   if (iter != connections_.end()) {
     connections_.erase(iter);
   }
+  connections_cv_.notify_all();
 }
 
 bool NetworkServer::RegisterTransaction(const std::shared_ptr<Connection>& connection,
@@ -393,17 +562,12 @@ bool NetworkServer::RegisterTransaction(const std::shared_ptr<Connection>& conne
   }
 
   pending_results_.insert_or_assign(txn_id, connection);
-  std::lock_guard inflight_guard(connection->inflight_mutex);
-  connection->inflight.insert(txn_id);
   return true;
 }
 
-void NetworkServer::ClearTransaction(const std::shared_ptr<Connection>& connection,
-                                     std::uint64_t txn_id) {
+void NetworkServer::ClearTransaction(std::uint64_t txn_id) {
   std::lock_guard guard(connections_mutex_);
   pending_results_.erase(txn_id);
-  std::lock_guard inflight_guard(connection->inflight_mutex);
-  connection->inflight.erase(txn_id);
 }
 
 std::optional<txn::TransactionRequest> NetworkServer::DecodeRequest(const std::string& payload) {
@@ -437,6 +601,31 @@ std::optional<txn::TransactionRequest> NetworkServer::DecodeRequest(const nlohma
 
   txn::TransactionRequest request{};
   request.id = txn_id;
+
+  if (const auto raw_it = json.find("raw_values"); raw_it != json.end()) {
+    if (!raw_it->is_boolean()) {
+      return std::nullopt;
+    }
+    request.raw_values = raw_it->get<bool>();
+  }
+
+  if (const auto snapshot_it = json.find("snapshot"); snapshot_it != json.end()) {
+    if (!snapshot_it->is_boolean()) {
+      return std::nullopt;
+    }
+    request.snapshot = snapshot_it->get<bool>();
+  }
+
+  if (const auto durability_it = json.find("durability"); durability_it != json.end()) {
+    if (!durability_it->is_string()) {
+      return std::nullopt;
+    }
+    const auto durability = DurabilityFromString(durability_it->get<std::string>());
+    if (!durability.has_value()) {
+      return std::nullopt;
+    }
+    request.durability = *durability;
+  }
   for (const auto& operation_json : *operations_it) {
     const auto operation = DecodeOperation(operation_json);
     if (!operation.has_value()) {
@@ -497,7 +686,8 @@ std::optional<txn::Operation> NetworkServer::DecodeOperation(const nlohmann::jso
   } else if (operation.type == txn::OperationType::kGet) {
     if (const auto value_it = operation_json.find("value"); value_it != operation_json.end()) {
       const auto record = DecodeRecord(*value_it);
-      if (!record.has_value()) {
+      if (!record.has_value() ||
+          std::holds_alternative<storage::btree::ValueLogRef>(record->value)) {
         return std::nullopt;
       }
     }
@@ -513,11 +703,7 @@ NetworkServer::DecodeRecord(const nlohmann::json& value_json) {
   }
 
   const auto kind_it = value_json.find("kind");
-  const auto data_it = value_json.find("data");
-  if (kind_it == value_json.end() || data_it == value_json.end()) {
-    return std::nullopt;
-  }
-  if (!kind_it->is_string()) {
+  if (kind_it == value_json.end() || !kind_it->is_string()) {
     return std::nullopt;
   }
 
@@ -531,6 +717,31 @@ NetworkServer::DecodeRecord(const nlohmann::json& value_json) {
   }
 
   const auto kind = kind_it->get<std::string>();
+  // Chunked values arrive as frames after the request. Until ReceiveChunkedValues streams them
+  // into the value log, the ref is a placeholder carrying only the declared length.
+  if (const auto encoding_it = value_json.find("encoding"); encoding_it != value_json.end()) {
+    const auto length_it = value_json.find("length");
+    if (*encoding_it != "chunked" || value_json.contains("data") || length_it == value_json.end() ||
+        !length_it->is_number_unsigned()) {
+      return std::nullopt;
+    }
+    const auto length = length_it->get<std::uint64_t>();
+    if (length == 0 || length > storage::vlog::ValueLog::kMaxRecordBytes ||
+        (kind != "bytes" && kind != "string")) {
+      return std::nullopt;
+    }
+    storage::btree::ValueLogRef placeholder{};
+    placeholder.pointer.length = length;
+    placeholder.type = kind == "string" ? storage::btree::ValueType::kString
+                                        : storage::btree::ValueType::kBytes;
+    record.value = placeholder;
+    return record;
+  }
+
+  const auto data_it = value_json.find("data");
+  if (data_it == value_json.end()) {
+    return std::nullopt;
+  }
   if (kind == "bytes") {
     if (!data_it->is_string()) {
       return std::nullopt;
@@ -558,20 +769,26 @@ NetworkServer::DecodeRecord(const nlohmann::json& value_json) {
   return record;
 }
 
-nlohmann::json NetworkServer::EncodeResponse(const TransactionResult& result) {
+nlohmann::json
+NetworkServer::EncodeResponse(const TransactionResult& result,
+                              std::span<const storage::vlog::PinnedRecord> raw_values) {
   nlohmann::json json;
   json["txn_id"] = result.id;
   json["state"] = TransactionStateToString(result.state);
 
   nlohmann::json operations = nlohmann::json::array();
+  std::size_t next_raw = 0;
   for (const auto& op_result : result.operations) {
     nlohmann::json op_json;
     op_json["type"] = OperationTypeToString(op_result.type);
     op_json["key"] = op_result.key;
     op_json["success"] = op_result.success;
     if (op_result.value.has_value()) {
-      const auto encoded = EncodeRecord(*op_result.value);
-      if (encoded.has_value()) {
+      const auto* ref = std::get_if<storage::btree::ValueLogRef>(&op_result.value->value);
+      if (ref != nullptr && next_raw < raw_values.size()) {
+        op_json["value"] = EncodeRawRecord(*ref, op_result.value->metadata, raw_values[next_raw]);
+        ++next_raw;
+      } else if (const auto encoded = EncodeRecord(*op_result.value); encoded.has_value()) {
         op_json["value"] = *encoded;
       }
     }
@@ -616,6 +833,25 @@ std::optional<nlohmann::json> NetworkServer::EncodeRecord(const storage::btree::
   return value;
 }
 
+nlohmann::json NetworkServer::EncodeRawRecord(const storage::btree::ValueLogRef& ref,
+                                              const storage::btree::RecordMetadata& metadata,
+                                              const storage::vlog::PinnedRecord& raw) {
+  nlohmann::json value;
+  value["kind"] = ref.type == storage::btree::ValueType::kString ? "string" : "bytes";
+  value["encoding"] = "raw";
+  value["length"] = raw.length;
+  value["crc32"] = raw.crc;
+  // Compressed records go out as stored; the client expands them after checking the CRC.
+  if (raw.codec == storage::vlog::Codec::kZstd) {
+    value["codec"] = "zstd";
+  }
+  if (metadata.ttl_epoch_seconds != 0) {
+    value["metadata"] = nlohmann::json::object();
+    value["metadata"]["ttl_epoch_seconds"] = metadata.ttl_epoch_seconds;
+  }
+  return value;
+}
+
 std::string NetworkServer::EncodeBytes(const std::vector<std::byte>& data) {
   static constexpr char kAlphabet[] =
       "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -709,6 +945,19 @@ std::optional<txn::OperationType> NetworkServer::OperationTypeFromString(std::st
   return std::nullopt;
 }
 
+std::optional<txn::DurabilityClass> NetworkServer::DurabilityFromString(std::string_view value) {
+  if (value == "async") {
+    return txn::DurabilityClass::kAsync;
+  }
+  if (value == "group") {
+    return txn::DurabilityClass::kGroup;
+  }
+  if (value == "sync") {
+    return txn::DurabilityClass::kSync;
+  }
+  return std::nullopt;
+}
+
 std::string NetworkServer::TransactionStateToString(txn::TransactionState state) {
   switch (state) {
   case txn::TransactionState::kCommitted:
@@ -717,6 +966,8 @@ std::string NetworkServer::TransactionStateToString(txn::TransactionState state)
     return "aborted";
   case txn::TransactionState::kPending:
     return "pending";
+  case txn::TransactionState::kDurabilityFailed:
+    return "durability_failed";
   }
   return "pending";
 }
@@ -4,21 +4,26 @@
 #include "txn/transaction_request.h"
 
 #include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace jubilant::server {
 
+// Plain sends pass MSG_NOSIGNAL, but raw values go out through sendfile(2), which has no such
+// flag. On platforms without SO_NOSIGPIPE the hosting process must ignore SIGPIPE, as jubildb's
+// main does, or a client hanging up mid-transfer kills it.
 class NetworkServer {
 public:
   struct Config {
@@ -37,40 +42,71 @@ public:
   [[nodiscard]] std::uint16_t port() const noexcept;
 
 private:
+  // A response the dispatcher has encoded, with any raw values already pinned.
+  struct PendingResponse {
+    std::string payload;
+    std::vector<storage::vlog::PinnedRecord> raw_values;
+  };
+
   struct Connection {
     int fd{-1};
     std::string peer;
     std::thread thread;
+    std::thread writer;
+    std::atomic<bool> started{false};
     std::atomic<bool> active{true};
     std::atomic<bool> cleaned{false};
     std::mutex write_mutex;
-    std::mutex inflight_mutex;
-    std::unordered_set<std::uint64_t> inflight;
+    std::mutex outbox_mutex;
+    std::condition_variable outbox_cv;
+    std::deque<PendingResponse> outbox;
   };
 
   void AcceptLoop();
   void DispatchLoop();
   void HandleConnection(const std::shared_ptr<Connection>& connection);
+  // Sends the responses the dispatcher queued for one connection, in order. A peer that reads
+  // slowly, or not at all, stalls only its own writer, never the dispatcher.
+  void WriterLoop(const std::shared_ptr<Connection>& connection);
+  static void WakeWriter(Connection& connection);
   static bool ReadFrame(int socket_fd, std::string& payload);
+  // Reads the chunk frames that follow a request carrying chunked set values, in operation order,
+  // writing each straight into its value-log record so only one frame is ever held in memory. The
+  // placeholder refs DecodeRecord produced are replaced with the finished records' pointers.
+  bool ReceiveChunkedValues(int socket_fd, txn::TransactionRequest& request);
   static bool WriteFrame(const std::shared_ptr<Connection>& connection, std::string_view payload);
+  // Sends the JSON frame and then each raw value's bytes, in operation order, straight from its
+  // value-log segment with sendfile(2). The connection's write lock is held throughout so no other
+  // frame can interleave with the raw bytes.
+  static bool WriteResponse(const std::shared_ptr<Connection>& connection, std::string_view payload,
+                            std::span<const storage::vlog::PinnedRecord> raw_values);
+  static bool WriteFrameLocked(int socket_fd, std::string_view payload);
   void CleanupConnection(const std::shared_ptr<Connection>& connection);
 
+  // Claims txn_id until its completion is drained; false when it is still in flight. A null
+  // connection registers an async id, whose completion is dropped.
   bool RegisterTransaction(const std::shared_ptr<Connection>& connection, std::uint64_t txn_id);
-  void ClearTransaction(const std::shared_ptr<Connection>& connection, std::uint64_t txn_id);
+  void ClearTransaction(std::uint64_t txn_id);
 
   static std::optional<txn::TransactionRequest> DecodeRequest(const std::string& payload);
   static std::optional<txn::TransactionRequest> DecodeRequest(const nlohmann::json& json);
   static std::optional<txn::Operation> DecodeOperation(const nlohmann::json& operation_json);
   static std::optional<storage::btree::Record> DecodeRecord(const nlohmann::json& value_json);
 
-  static nlohmann::json EncodeResponse(const TransactionResult& result);
+  static nlohmann::json
+  EncodeResponse(const TransactionResult& result,
+                 std::span<const storage::vlog::PinnedRecord> raw_values = {});
   static std::optional<nlohmann::json> EncodeRecord(const storage::btree::Record& record);
+  static nlohmann::json EncodeRawRecord(const storage::btree::ValueLogRef& ref,
+                                        const storage::btree::RecordMetadata& metadata,
+                                        const storage::vlog::PinnedRecord& raw);
 
   static std::string EncodeBytes(const std::vector<std::byte>& data);
   static std::optional<std::vector<std::byte>> DecodeBytes(const std::string& encoded);
 
   static std::string OperationTypeToString(txn::OperationType type);
   static std::optional<txn::OperationType> OperationTypeFromString(std::string_view value);
+  static std::optional<txn::DurabilityClass> DurabilityFromString(std::string_view value);
   static std::string TransactionStateToString(txn::TransactionState state);
 
   Server& server_;
@@ -83,7 +119,11 @@ private:
   std::thread dispatch_thread_;
 
   mutable std::mutex connections_mutex_;
+  // Signalled as each connection finishes cleaning up, so Stop can wait for all of them.
+  std::condition_variable connections_cv_;
   std::vector<std::shared_ptr<Connection>> connections_;
+  // Every submitted id until its completion is drained. Completions whose connection is gone,
+  // async ones included, are dropped.
   std::unordered_map<std::uint64_t, std::weak_ptr<Connection>> pending_results_;
 };
 
@@ -1,10 +1,13 @@
 #include "server/server.h"
 
+#include <cstring>
+#include <exception>
 #include <filesystem>
 #include <random>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 
 namespace jubilant::server {
@@ -46,6 +49,8 @@ meta::ManifestRecord LoadOrCreateManifest(meta::ManifestStore& manifest_store,
   manifest = meta::ManifestStore::NewDefault(GenerateUuidLikeString());
   manifest->page_size = config.page_size;
   manifest->inline_threshold = config.inline_threshold;
+  manifest->inline_rules = config.inline_rules;
+  manifest->wal_schema = config.wal_schema;
 
   if (!manifest_store.Persist(*manifest)) {
     throw std::runtime_error("Failed to persist MANIFEST");
@@ -79,6 +84,80 @@ meta::SuperBlock LoadOrCreateSuperblock(meta::SuperBlockStore& superblock_store,
   return superblock;
 }
 
+storage::btree::Record RecoveredRecord(const storage::wal::UpsertPayload& upsert) {
+  storage::btree::Record record{};
+  record.metadata.ttl_epoch_seconds = upsert.ttl_epoch_seconds;
+  if (upsert.value_ptr.has_value()) {
+    record.value = storage::btree::ValueLogRef{
+        .pointer = *upsert.value_ptr,
+        .type = upsert.value_kind == storage::wal::ValueKind::kString
+                    ? storage::btree::ValueType::kString
+                    : storage::btree::ValueType::kBytes};
+    return record;
+  }
+  switch (upsert.value_kind) {
+  case storage::wal::ValueKind::kString:
+    record.value = std::string(reinterpret_cast<const char*>(upsert.value.data()),
+                               upsert.value.size());
+    break;
+  case storage::wal::ValueKind::kInt64: {
+    if (upsert.value.size() != sizeof(std::int64_t)) {
+      throw std::runtime_error("Corrupt int64 value in WAL upsert");
+    }
+    std::int64_t number = 0;
+    std::memcpy(&number, upsert.value.data(), sizeof(number));
+    record.value = number;
+    break;
+  }
+  default:
+    record.value = upsert.value;
+    break;
+  }
+  return record;
+}
+
+// Redo-only recovery: applies, in LSN order, the operations of every transaction whose commit
+// marker lies past the checkpoint. Earlier commits are already in the checkpointed leaves, and
+// the log before the checkpoint's recorded position holds nothing later, so it is not read.
+void RecoverFromWal(const storage::wal::WalManager& wal, storage::btree::BTree& btree,
+                    storage::Lsn checkpoint_lsn, storage::wal::WalPosition from) {
+  const auto replay = wal.Replay(from);
+  std::unordered_map<std::uint64_t, std::vector<const storage::wal::WalRecord*>> open_txns;
+  for (const auto& record : replay.committed) {
+    switch (record.type) {
+    case storage::wal::RecordType::kTxnBegin:
+      open_txns[record.txn_id].clear();
+      break;
+    case storage::wal::RecordType::kUpsert:
+    case storage::wal::RecordType::kTombstone:
+      open_txns[record.txn_id].push_back(&record);
+      break;
+    case storage::wal::RecordType::kTxnAbort:
+      open_txns.erase(record.txn_id);
+      break;
+    case storage::wal::RecordType::kTxnCommit: {
+      const auto iter = open_txns.find(record.txn_id);
+      if (iter == open_txns.end()) {
+        break;
+      }
+      if (record.lsn > checkpoint_lsn) {
+        for (const auto* op : iter->second) {
+          if (op->upsert.has_value()) {
+            btree.Insert(op->upsert->key, RecoveredRecord(*op->upsert));
+          } else if (op->tombstone_key.has_value()) {
+            (void)btree.Erase(*op->tombstone_key);
+          }
+        }
+      }
+      open_txns.erase(iter);
+      break;
+    }
+    case storage::wal::RecordType::kCheckpoint:
+      break;
+    }
+  }
+}
+
 } // namespace
 
 Server::Server(std::filesystem::path base_dir, std::size_t worker_count)
@@ -86,21 +165,54 @@ Server::Server(std::filesystem::path base_dir, std::size_t worker_count)
 
 Server::Server(const config::Config& config, std::size_t worker_count)
     : base_dir_(config.db_path), worker_count_(ResolveWorkerCount(worker_count)),
-      wal_manager_(base_dir_), manifest_store_(base_dir_), superblock_store_(base_dir_) {
+      group_commit_latency_(config.group_commit_max_latency_ms),
+      checkpoint_triggers_{.interval = std::chrono::milliseconds(config.checkpoint_interval_ms),
+                           .wal_bytes = config.checkpoint_wal_bytes},
+      checkpoint_io_limits_{.bytes_per_second = config.checkpoint_max_bytes_per_second,
+                            .iops = config.checkpoint_max_iops},
+      wal_segment_bytes_(config.wal_segment_bytes),
+      ttl_sweep_options_{.interval = std::chrono::milliseconds(config.ttl_sweep_interval_ms),
+                         .batch_size = config.ttl_sweep_batch,
+                         .max_per_second = config.ttl_sweep_max_per_second},
+      value_log_gc_options_{.interval = std::chrono::milliseconds(config.vlog_gc_interval_ms),
+                            .gc = {.max_live_ratio = config.vlog_gc_max_live_ratio}},
+      manifest_store_(base_dir_),
+      superblock_store_(base_dir_) {
   std::filesystem::create_directories(base_dir_);
   manifest_record_ = LoadOrCreateManifest(manifest_store_, config);
+  if (storage::wal::IsRetiredWalSchema(manifest_record_.wal_schema)) {
+    throw std::runtime_error("WAL schema " + manifest_record_.wal_schema +
+                             " uses the retired embedded-CRC framing and cannot be opened");
+  }
+  const auto wal_encoding = storage::wal::ParseWalSchema(manifest_record_.wal_schema);
+  if (!wal_encoding.has_value()) {
+    throw std::runtime_error("Unsupported WAL schema in MANIFEST: " + manifest_record_.wal_schema);
+  }
   superblock_ = superblock_store_.LoadActive().value_or(meta::SuperBlock{});
+  const storage::wal::WalPosition checkpoint_position{
+      .segment = static_cast<storage::SegmentId>(superblock_.checkpoint_wal_segment),
+      .offset = superblock_.checkpoint_wal_offset,
+      .lsn = superblock_.last_checkpoint_lsn};
+  wal_manager_.emplace(base_dir_, *wal_encoding, checkpoint_position);
   const auto ttl_calibration = storage::ttl::TtlClock::CalibrateNow();
   ttl_clock_.emplace(ttl_calibration);
   pager_.emplace(storage::Pager::Open(base_dir_ / "data.pages", manifest_record_.page_size));
-  value_log_.emplace(base_dir_ / "vlog");
+  // Leaves stay resident, so there is no page cache yet and the value-log read cache is the only
+  // consumer of cache_bytes. It gets the whole budget until a page cache needs a share.
+  value_log_.emplace(base_dir_ / "vlog", config.vlog_segment_bytes,
+                     static_cast<std::size_t>(config.cache_bytes));
+  wal_manager_->SetPreSyncHook([this]() { value_log_->Sync(); });
   auto& btree = btree_.emplace(
       storage::btree::BTree::Config{.pager = &pager_.value(),
                                     .value_log = &value_log_.value(),
                                     .inline_threshold = manifest_record_.inline_threshold,
+                                    .inline_rules = manifest_record_.inline_rules,
                                     .root_hint = superblock_.root_page_id,
-                                    .ttl_clock = ttl_clock_ ? &ttl_clock_.value() : nullptr});
+                                    .ttl_clock = ttl_clock_ ? &ttl_clock_.value() : nullptr,
+                                    .defer_page_writes = true});
+  RecoverFromWal(*wal_manager_, btree, superblock_.last_checkpoint_lsn, checkpoint_position);
   superblock_ = LoadOrCreateSuperblock(superblock_store_, superblock_, btree, ttl_calibration);
+  checkpointed_lsn_ = superblock_.last_checkpoint_lsn;
 }
 
 Server::~Server() {
@@ -117,6 +229,9 @@ void Server::Start() {
   }
 
   auto& btree = *btree_;
+  wal_manager_->StartGroupCommit(group_commit_latency_);
+  auto& appender = appender_.emplace(*value_log_);
+  ttl_clock_->StartTicker();
 
   for (std::size_t i = 0; i < worker_count_; ++i) {
     auto on_complete = [this](TransactionResult result) {
@@ -125,11 +240,24 @@ void Server::Start() {
       results_cv_.notify_all();
     };
 
-    auto worker = std::make_unique<Worker>("worker-" + std::to_string(i), receiver_, lock_manager_,
-                                           btree, btree_mutex_, on_complete);
+    auto worker = std::make_unique<Worker>("worker-" + std::to_string(i), receiver_,
+                                           lock_manager_, btree, on_complete,
+                                           &wal_manager_.value(), &appender, &checkpoint_gate_,
+                                           &snapshots_);
     worker->Start();
     workers_.push_back(std::move(worker));
   }
+
+  checkpointer_.io_budget().SetLimits(checkpoint_io_limits_);
+  checkpointer_.Start(
+      checkpoint_triggers_, [this]() { return BeginCheckpoint(); },
+      [this](storage::Lsn lsn) { return FlushCheckpoint(lsn); },
+      [this]() { return WalBytesSinceCheckpoint(); });
+  ttl_sweeper_.Start(ttl_sweep_options_,
+                     [this](std::size_t limit) { return SweepExpiredBatch(limit); });
+  value_log_collector_.Start(value_log_gc_options_, [this](const storage::vlog::GcOptions& gc) {
+    return btree_->CollectValueLogGarbage(gc);
+  });
 }
 
 void Server::Stop() {
@@ -143,7 +271,22 @@ void Server::Stop() {
     worker->Stop();
   }
   workers_.clear();
-
+  ttl_sweeper_.Stop();
+  // Stopped before the final checkpoint, which then deletes whatever its last pass retired.
+  value_log_collector_.Stop();
+  ttl_clock_->StopTicker();
+  appender_.reset();
+
+  // Workers are gone, so the flusher's final sync covers every acknowledged async commit.
+  wal_manager_->StopGroupCommit();
+  checkpointer_.Stop();
+  // A final checkpoint keeps the next start's replay short. If it fails, the WAL still covers
+  // everything it would have written. No reads compete with it, so it runs unthrottled.
+  checkpointer_.io_budget().SetLimits({});
+  try {
+    (void)Checkpoint();
+  } catch (const std::exception&) {
+  }
   results_cv_.notify_all();
 }
 
@@ -175,4 +318,181 @@ bool Server::running() const noexcept {
   return running_.load();
 }
 
+std::optional<storage::vlog::PinnedRecord>
+Server::PinValue(const storage::SegmentPointer& pointer) {
+  if (!value_log_) {
+    return std::nullopt;
+  }
+  return value_log_->Pin(pointer);
+}
+
+storage::vlog::ValueCache::Stats Server::value_cache_stats() const {
+  return value_log_ ? value_log_->cache_stats() : storage::vlog::ValueCache::Stats{};
+}
+
+std::vector<storage::btree::ValueSizeStats::PrefixReport> Server::InlineThresholdReport() const {
+  if (!btree_) {
+    return {};
+  }
+  // The statistics carry their own locks, so this does not wait on the tree.
+  return btree_->InlineThresholdReport();
+}
+
+storage::checkpoint::CheckpointStats Server::checkpoint_stats() const {
+  auto stats = checkpointer_.stats();
+  if (wal_manager_) {
+    const auto last_lsn = wal_manager_->next_lsn() - 1;
+    const auto checkpointed = checkpointed_lsn_.load();
+    stats.lag_lsns = last_lsn > checkpointed ? last_lsn - checkpointed : 0;
+    stats.lag_wal_bytes = WalBytesSinceCheckpoint();
+  }
+  return stats;
+}
+
+std::uint64_t Server::SweepExpired() {
+  return ttl_sweeper_.RunPass(ttl_sweep_options_,
+                              [this](std::size_t limit) { return SweepExpiredBatch(limit); });
+}
+
+storage::ttl::SweepStats Server::ttl_sweep_stats() const {
+  auto stats = ttl_sweeper_.stats();
+  if (btree_) {
+    stats.tracked = btree_->expiring_count();
+  }
+  return stats;
+}
+
+storage::vlog::GcReport Server::CollectValueLogGarbage() {
+  // Not WAL-logged: until a checkpoint covers the repointed leaves, replay resolves the old
+  // pointers, and the victims stay on disk until then.
+  return value_log_collector_.RunPass(value_log_gc_options_.gc,
+                                      [this](const storage::vlog::GcOptions& gc) {
+                                        return btree_->CollectValueLogGarbage(gc);
+                                      });
+}
+
+storage::vlog::CollectorStats Server::value_log_gc_stats() const {
+  return value_log_collector_.stats();
+}
+
+std::size_t Server::SweepExpiredBatch(std::size_t limit) {
+  const auto keys = btree_->ExpiredKeys(limit);
+  if (keys.empty()) {
+    return 0;
+  }
+
+  // Same order as a worker: the batch's key locks, then the gate. Every key stays locked until its
+  // tombstone is logged, so a write renewing one cannot reach the WAL ahead of the tombstone and be
+  // undone by replay.
+  lock::LockSet locks{lock_manager_};
+  for (const auto& key : keys) {
+    locks.Declare(key, lock::LockMode::kExclusive);
+  }
+  locks.AcquireAll();
+  std::shared_lock gate(checkpoint_gate_);
+  // A key renewed since it was listed is no longer expired and stays.
+  const auto erased = btree_->EraseExpired(keys);
+  std::vector<storage::wal::WalOp> tombstones;
+  for (const auto& key : erased) {
+    storage::wal::WalOp tombstone{};
+    tombstone.type = storage::wal::RecordType::kTombstone;
+    tombstone.key = key;
+    tombstones.push_back(tombstone);
+  }
+  if (!tombstones.empty()) {
+    (void)wal_manager_->AppendTransaction(next_sweep_txn_id_++, tombstones);
+  }
+  return tombstones.size();
+}
+
+std::optional<storage::checkpoint::CheckpointSnapshot> Server::Checkpoint() {
+  return checkpointer_.Run([this]() { return BeginCheckpoint(); },
+                           [this](storage::Lsn lsn) { return FlushCheckpoint(lsn); });
+}
+
+std::uint64_t Server::WalBytesSinceCheckpoint() const {
+  // Read the mark first: it never runs ahead of the append counter.
+  const auto checkpointed = checkpointed_wal_bytes_.load();
+  return wal_manager_->appended_bytes() - checkpointed;
+}
+
+std::optional<storage::Lsn> Server::BeginCheckpoint() {
+  // Commits prune their own keys, but images a snapshot or a commit still in flight kept alive
+  // then are only reclaimed here, once per checkpoint interval.
+  (void)btree_->CollectVersions(snapshots_.horizon());
+
+  // With the gate held no transaction sits between changing the tree and appending its commit, so
+  // the captured leaves reflect exactly the records up to lsn. Readers keep running meanwhile.
+  std::unique_lock gate(checkpoint_gate_);
+  if (!btree_->has_unflushed_changes()) {
+    return std::nullopt;
+  }
+  // Nothing is mid-append either, so the end of the log is exactly where records past lsn begin.
+  checkpoint_wal_position_ = wal_manager_->end_position();
+  checkpoint_wal_bytes_ = wal_manager_->appended_bytes();
+  const auto lsn = checkpoint_wal_position_.lsn;
+  // Read before the layout: a GC pass retiring segments after this point may have repointed its
+  // records only after the leaves were laid out, so this checkpoint must not delete them.
+  checkpoint_retired_segments_ = value_log_->retired_segments();
+  // Writers wait only for the layout, which copies the records. Encoding and comparing every leaf
+  // runs after they resume, so the pause does not grow with the cost of encoding the database.
+  checkpoint_pages_ = btree_->CaptureDirtyPages(lsn, [&gate]() { gate.unlock(); });
+  return lsn;
+}
+
+storage::checkpoint::FlushResult Server::FlushCheckpoint(storage::Lsn lsn) {
+  // Write-ahead rule: no page goes out before the WAL records it reflects are durable.
+  if (!wal_manager_->WaitDurable(lsn)) {
+    throw std::runtime_error("WAL not durable through checkpoint LSN");
+  }
+  storage::checkpoint::FlushResult result{};
+  auto& budget = checkpointer_.io_budget();
+  const auto page_bytes = static_cast<std::uint64_t>(pager_->page_size());
+  for (const auto& page : checkpoint_pages_.pages) {
+    result.throttled += budget.Acquire(page_bytes);
+    pager_->Write(page);
+    ++result.pages;
+    result.bytes += page_bytes;
+  }
+  pager_->Sync();
+
+  // This is the atomic switch to the new tree: until the superblock names the new root, recovery
+  // reads the previous tree, whose pages the writes above left untouched.
+  auto next = superblock_;
+  next.root_page_id = checkpoint_pages_.root_page_id;
+  next.last_checkpoint_lsn = lsn;
+  next.checkpoint_wal_segment = checkpoint_wal_position_.segment;
+  next.checkpoint_wal_offset = checkpoint_wal_position_.offset;
+  if (!superblock_store_.WriteNext(next)) {
+    throw std::runtime_error("Failed to write superblock");
+  }
+  superblock_ = superblock_store_.LoadActive().value_or(next);
+  // Only now may the pages the previous tree used be handed out again.
+  btree_->MarkFlushed(checkpoint_pages_);
+  checkpoint_pages_ = {};
+
+  checkpointed_lsn_ = lsn;
+  checkpointed_wal_bytes_ = checkpoint_wal_bytes_;
+
+  // The new leaves no longer reference the value-log segments GC retired before the capture, and
+  // recovery now starts after lsn, so neither those segments nor the WAL before lsn is needed
+  // again. The active segment is sealed once full, so whole segments fall behind later checkpoints.
+  value_log_->ReleaseRetiredSegments(checkpoint_retired_segments_);
+  checkpoint_retired_segments_.clear();
+  if (wal_manager_->active_segment_bytes() >= wal_segment_bytes_) {
+    // Lag then counts from the new segment's checkpoint marker, which this checkpoint covers.
+    checkpointed_lsn_ = wal_manager_->Rollover(lsn);
+  }
+  (void)wal_manager_->ReleaseSegmentsThrough(lsn);
+  return result;
+}
+
+std::optional<storage::vlog::ValueLog::AppendStream>
+Server::OpenValueStream(std::uint64_t length) {
+  if (!value_log_ || !running()) {
+    return std::nullopt;
+  }
+  return value_log_->BeginAppend(length);
+}
+
 } // namespace jubilant::server
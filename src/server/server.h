@@ -7,10 +7,15 @@
 #include "server/transaction_receiver.h"
 #include "server/worker.h"
 #include "storage/btree/btree.h"
+#include "storage/checkpoint/checkpointer.h"
 #include "storage/pager/pager.h"
 #include "storage/ttl/ttl_clock.h"
+#include "storage/ttl/ttl_sweeper.h"
 #include "storage/vlog/value_log.h"
+#include "storage/vlog/value_log_appender.h"
+#include "storage/vlog/value_log_collector.h"
 #include "storage/wal/wal_manager.h"
+#include "txn/snapshot_registry.h"
 #include "txn/transaction_request.h"
 
 #include <atomic>
@@ -40,25 +45,91 @@ public:
   bool WaitForResults(std::chrono::milliseconds timeout);
 
   [[nodiscard]] bool running() const noexcept;
+  [[nodiscard]] storage::vlog::ValueCache::Stats value_cache_stats() const;
+  // Checkpoint counters and flush rate, plus how far the last checkpoint trails the WAL.
+  [[nodiscard]] storage::checkpoint::CheckpointStats checkpoint_stats() const;
+
+  // Runs a checkpoint now, alongside traffic: flushes the leaves changed since the last one,
+  // records its LSN in the superblock, and releases the WAL segments it covers. nullopt when
+  // nothing changed. Throws when a write or sync fails.
+  std::optional<storage::checkpoint::CheckpointSnapshot> Checkpoint();
+  // Runs a TTL sweep pass now: erases records whose TTL has passed and logs their tombstones in
+  // batches, as the background sweeper does. Returns how many records it removed.
+  std::uint64_t SweepExpired();
+  // Sweeper counters, plus how many records still carry a TTL.
+  [[nodiscard]] storage::ttl::SweepStats ttl_sweep_stats() const;
+  // Runs a value-log GC pass now, as the background collector does: compacts the segments at or
+  // below the configured live ratio. The next checkpoint deletes the segments it retires.
+  storage::vlog::GcReport CollectValueLogGarbage();
+  [[nodiscard]] storage::vlog::CollectorStats value_log_gc_stats() const;
+
+  // Per-key-prefix value sizes seen since startup and the inline threshold each would suggest;
+  // feed the suggestions into [[inline_rules]] when creating the next database.
+  [[nodiscard]] std::vector<storage::btree::ValueSizeStats::PrefixReport>
+  InlineThresholdReport() const;
+
+  // Resolves a ValueLogRef returned by a raw_values read for zero-copy transfer.
+  [[nodiscard]] std::optional<storage::vlog::PinnedRecord>
+  PinValue(const storage::SegmentPointer& pointer);
+  // Opens a value-log record to be filled chunk by chunk; its finished pointer goes into a set
+  // operation as a ValueLogRef.
+  [[nodiscard]] std::optional<storage::vlog::ValueLog::AppendStream>
+  OpenValueStream(std::uint64_t length);
 
 private:
+  // Takes the checkpoint gate, captures the dirty leaves, and returns the LSN they reflect.
+  [[nodiscard]] std::optional<storage::Lsn> BeginCheckpoint();
+  // Writes the captured leaves once the WAL is durable through lsn, paced by the checkpoint I/O
+  // budget, then advances the superblock and releases what it covers.
+  storage::checkpoint::FlushResult FlushCheckpoint(storage::Lsn lsn);
+  [[nodiscard]] std::uint64_t WalBytesSinceCheckpoint() const;
+  // Erases up to limit expired records and logs their tombstones as one transaction.
+  std::size_t SweepExpiredBatch(std::size_t limit);
+
   std::filesystem::path base_dir_;
   std::size_t worker_count_{0};
+  std::chrono::milliseconds group_commit_latency_{0};
+  storage::checkpoint::CheckpointTriggers checkpoint_triggers_{};
+  storage::checkpoint::IoLimits checkpoint_io_limits_{};
+  std::uint64_t wal_segment_bytes_{0};
+  storage::ttl::SweepOptions ttl_sweep_options_{};
+  storage::vlog::CollectorOptions value_log_gc_options_{};
   std::atomic<bool> running_{false};
 
   lock::LockManager lock_manager_;
   std::optional<storage::Pager> pager_;
   std::optional<storage::vlog::ValueLog> value_log_;
+  // Runs while the server does; workers hand it their oversized values.
+  std::optional<storage::vlog::ValueLogAppender> appender_;
   std::optional<storage::ttl::TtlClock> ttl_clock_;
   std::optional<storage::btree::BTree> btree_;
-  storage::wal::WalManager wal_manager_;
+  std::optional<storage::wal::WalManager> wal_manager_;
   meta::ManifestStore manifest_store_;
   meta::SuperBlockStore superblock_store_;
   meta::ManifestRecord manifest_record_{};
   meta::SuperBlock superblock_{};
 
   TransactionReceiver receiver_;
-  std::shared_mutex btree_mutex_;
+  // Visible LSN and open snapshots for snapshot transactions.
+  txn::SnapshotRegistry snapshots_;
+  // Workers hold it shared between touching the tree and logging; checkpoints take it exclusively
+  // only while capturing dirty leaves.
+  std::shared_mutex checkpoint_gate_;
+  storage::checkpoint::Checkpointer checkpointer_;
+  // Leaves captured by BeginCheckpoint() for the FlushCheckpoint() that follows it.
+  storage::btree::BTree::DirtyPages checkpoint_pages_;
+  // Value-log segments GC had retired before that capture; only these are covered by its leaves.
+  std::vector<storage::SegmentId> checkpoint_retired_segments_;
+  // Where the log stood at that capture, for the superblock and the WAL volume trigger.
+  storage::wal::WalPosition checkpoint_wal_position_{};
+  std::uint64_t checkpoint_wal_bytes_{0};
+  // The last completed checkpoint, readable without the checkpointer's locks.
+  std::atomic<storage::Lsn> checkpointed_lsn_{0};
+  std::atomic<std::uint64_t> checkpointed_wal_bytes_{0};
+  storage::ttl::TtlSweeper ttl_sweeper_;
+  // WAL transaction ids for sweeper batches, kept apart from client-assigned ids.
+  std::atomic<std::uint64_t> next_sweep_txn_id_{1ULL << 63U};
+  storage::vlog::ValueLogCollector value_log_collector_;
 
   std::vector<std::unique_ptr<Worker>> workers_;
   std::mutex results_mutex_;
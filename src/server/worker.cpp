@@ -1,23 +1,61 @@
 #include "server/worker.h"
 
+#include <exception>
+#include <future>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <utility>
+#include <variant>
 
 namespace jubilant::server {
 
-Worker::KeyLockGuard::KeyLockGuard(lock::LockManager& manager, std::string key, lock::LockMode mode)
-    : manager_(manager), key_(std::move(key)), mode_(mode) {
-  manager_.Acquire(key_, mode_);
-}
+namespace {
+
+// Borrows the bytes of a record's value for the WAL. Integers are copied into scratch so the span
+// outlives the call; value-log references are logged as the pointer alone.
+storage::wal::WalOp ToWalUpsert(const std::string& key, const storage::btree::Record& record,
+                                std::int64_t& int_scratch) {
+  storage::wal::WalOp op{};
+  op.type = storage::wal::RecordType::kUpsert;
+  op.key = key;
+  op.ttl_epoch_seconds = record.metadata.ttl_epoch_seconds;
 
-Worker::KeyLockGuard::~KeyLockGuard() {
-  manager_.Release(key_, mode_);
+  const auto& value = record.value;
+  if (const auto* bytes = std::get_if<std::vector<std::byte>>(&value)) {
+    op.value = *bytes;
+    op.value_kind = storage::wal::ValueKind::kBytes;
+  } else if (const auto* str = std::get_if<std::string>(&value)) {
+    op.value = std::as_bytes(std::span<const char>(*str));
+    op.value_kind = storage::wal::ValueKind::kString;
+  } else if (const auto* number = std::get_if<std::int64_t>(&value)) {
+    int_scratch = *number;
+    op.value = std::as_bytes(std::span<const std::int64_t, 1>(&int_scratch, 1));
+    op.value_kind = storage::wal::ValueKind::kInt64;
+  } else if (const auto* ref = std::get_if<storage::btree::ValueLogRef>(&value)) {
+    op.value_ptr = ref->pointer;
+    op.value_kind = ref->type == storage::btree::ValueType::kString
+                        ? storage::wal::ValueKind::kString
+                        : storage::wal::ValueKind::kBytes;
+  }
+  return op;
 }
 
+} // namespace
+
 Worker::Worker(std::string name, TransactionReceiver& receiver, lock::LockManager& lock_manager,
-               storage::btree::BTree& btree, std::shared_mutex& btree_mutex,
-               CompletionFn on_complete)
+               storage::btree::BTree& btree, CompletionFn on_complete,
+               storage::wal::WalManager* wal_manager, storage::vlog::ValueLogAppender* appender,
+               std::shared_mutex* checkpoint_gate, txn::SnapshotRegistry* snapshots)
     : name_(std::move(name)), receiver_(receiver), lock_manager_(lock_manager), btree_(btree),
-      btree_mutex_(btree_mutex), on_complete_(std::move(on_complete)) {}
+      on_complete_(std::move(on_complete)), wal_manager_(wal_manager), appender_(appender),
+      checkpoint_gate_(checkpoint_gate), snapshots_(snapshots),
+      visibility_(snapshots != nullptr ? storage::btree::Visibility::kAtCommit
+                                       : storage::btree::Visibility::kImmediate) {
+  if (snapshots_ != nullptr && wal_manager_ == nullptr) {
+    throw std::invalid_argument("Snapshot reads need a WAL to stamp versions");
+  }
+}
 
 Worker::~Worker() {
   Stop();
@@ -72,45 +110,257 @@ TransactionResult Worker::Process(const txn::TransactionRequest& request) {
     result.state = txn::TransactionState::kAborted;
     return result;
   }
+  // Without a registry the locking path below gives the same consistent view.
+  if (request.snapshot && snapshots_ != nullptr) {
+    return ProcessSnapshot(request);
+  }
 
-  txn::TransactionContext context{request.id};
+  // Oversized values go to the value log before any lock is taken. The tree and the WAL then carry
+  // only the pointer, so each value reaches disk once and is synced with the WAL batch. The holds
+  // keep GC off their segments until this returns, inserted or not.
+  std::vector<std::optional<storage::btree::ValueLogRef>> spilled(request.operations.size());
+  std::vector<std::shared_ptr<const void>> holds;
+  try {
+    SpillValues(request, spilled, holds);
+  } catch (const std::exception&) {
+    result.state = txn::TransactionState::kAborted;
+    return result;
+  }
+
+  // Strict 2PL over the predeclared key set: reads lock shared, writes exclusive, and a key both
+  // read and written is locked exclusive from the start. Released on return, after the commit's
+  // durability wait or the abort.
+  lock::LockSet locks{lock_manager_};
   for (const auto& operation : request.operations) {
+    locks.Declare(operation.key, operation.type == txn::OperationType::kGet
+                                     ? lock::LockMode::kShared
+                                     : lock::LockMode::kExclusive);
+  }
+  locks.AcquireAll();
+
+  std::shared_lock<std::shared_mutex> gate_guard;
+  if (checkpoint_gate_ != nullptr) {
+    gate_guard = std::shared_lock(*checkpoint_gate_);
+  }
+
+  txn::TransactionContext context{request.id};
+  // Keys whose versioned writes await the commit LSN.
+  std::vector<std::string> written;
+  for (std::size_t i = 0; i < request.operations.size(); ++i) {
+    const auto& operation = request.operations[i];
     switch (operation.type) {
     case txn::OperationType::kGet:
-      ApplyRead(operation, context, result);
+      ApplyRead(operation, request.raw_values, context, result);
       break;
     case txn::OperationType::kSet:
-      ApplyWrite(operation, context, result);
+      ApplyWrite(operation, spilled[i], context, result);
       break;
     case txn::OperationType::kDelete:
       ApplyDelete(operation, result);
       break;
     default:
+      AbortVersions(written);
       result.state = txn::TransactionState::kAborted;
       context.MarkAborted();
       return result;
     }
+    if (snapshots_ != nullptr && operation.type != txn::OperationType::kGet) {
+      written.push_back(operation.key);
+    }
 
     if (context.state() == txn::TransactionState::kAborted) {
+      AbortVersions(written);
       result.state = context.state();
       return result;
     }
   }
 
+  // Registered before the append, so the visible LSN cannot pass this commit until its versions
+  // carry its LSN.
+  std::optional<std::uint64_t> ticket;
+  if (snapshots_ != nullptr && !written.empty()) {
+    ticket = snapshots_->BeginCommit();
+  }
+  std::optional<storage::Lsn> commit_lsn;
+  const bool logged = LogCommit(request, spilled, result, gate_guard, commit_lsn);
+  if (ticket.has_value()) {
+    if (commit_lsn.has_value()) {
+      btree_.CommitVersions(written, *commit_lsn);
+    } else {
+      // Never logged, and the gate is still held, so no checkpoint has captured these writes.
+      AbortVersions(written);
+    }
+    snapshots_->EndCommit(*ticket, commit_lsn);
+    (void)btree_.CollectVersions(written, snapshots_->horizon());
+  }
+  if (!logged) {
+    // Only versioned writes that never reached the log were undone above. Anything else is in the
+    // tree, and maybe in the WAL, so claiming a rollback would be false.
+    if (ticket.has_value() && !commit_lsn.has_value()) {
+      context.MarkAborted();
+      result.state = context.state();
+    } else {
+      result.state = txn::TransactionState::kDurabilityFailed;
+    }
+    return result;
+  }
+
   context.MarkCommitted();
   result.state = context.state();
   return result;
 }
 
-void Worker::ApplyRead(const txn::Operation& operation, txn::TransactionContext& context,
-                       TransactionResult& result) {
+TransactionResult Worker::ProcessSnapshot(const txn::TransactionRequest& request) {
+  TransactionResult result{};
+  result.id = request.id;
+
+  const auto snapshot = snapshots_->Open();
+  try {
+    for (const auto& operation : request.operations) {
+      OperationResult op_result{};
+      op_result.type = operation.type;
+      op_result.key = operation.key;
+      auto found = request.raw_values ? btree_.FindStoredAt(operation.key, snapshot)
+                                      : btree_.FindAt(operation.key, snapshot);
+      if (found.has_value()) {
+        op_result.success = true;
+        op_result.value = std::move(found);
+      }
+      result.operations.push_back(std::move(op_result));
+    }
+  } catch (...) {
+    snapshots_->Close(snapshot);
+    throw;
+  }
+  snapshots_->Close(snapshot);
+
+  result.state = txn::TransactionState::kCommitted;
+  return result;
+}
+
+void Worker::SpillValues(const txn::TransactionRequest& request,
+                         std::vector<std::optional<storage::btree::ValueLogRef>>& spilled,
+                         std::vector<std::shared_ptr<const void>>& holds) {
+  if (appender_ == nullptr) {
+    for (std::size_t i = 0; i < request.operations.size(); ++i) {
+      const auto& operation = request.operations[i];
+      if (operation.type != txn::OperationType::kSet || !operation.value.has_value()) {
+        continue;
+      }
+      if (auto value = btree_.SpillToValueLog(operation.key, *operation.value); value.has_value()) {
+        spilled[i] = value->ref;
+        holds.push_back(std::move(value->hold));
+      }
+    }
+    return;
+  }
+
+  // Every value is queued before any is awaited, so a transaction's appends go out as one batch.
+  // The futures view the request's values, so each one is drained even if an earlier one failed.
+  std::vector<std::future<storage::vlog::AppendResult>> pending(request.operations.size());
+  std::vector<storage::btree::ValueType> types(request.operations.size());
+  std::exception_ptr failure;
+  try {
+    for (std::size_t i = 0; i < request.operations.size(); ++i) {
+      const auto& operation = request.operations[i];
+      if (operation.type != txn::OperationType::kSet || !operation.value.has_value()) {
+        continue;
+      }
+      const auto payload = btree_.SpillPayloadFor(operation.key, *operation.value);
+      if (payload.has_value()) {
+        types[i] = payload->type;
+        pending[i] = appender_->Submit(payload->bytes);
+      }
+    }
+  } catch (...) {
+    failure = std::current_exception();
+  }
+  for (std::size_t i = 0; i < pending.size(); ++i) {
+    if (!pending[i].valid()) {
+      continue;
+    }
+    try {
+      auto appended = pending[i].get();
+      storage::btree::ValueLogRef ref{};
+      ref.pointer = appended.pointer;
+      ref.type = types[i];
+      spilled[i] = ref;
+      holds.push_back(std::move(appended.hold));
+    } catch (...) {
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+bool Worker::LogCommit(const txn::TransactionRequest& request,
+                       std::span<const std::optional<storage::btree::ValueLogRef>> spilled,
+                       const TransactionResult& result,
+                       std::shared_lock<std::shared_mutex>& gate_guard,
+                       std::optional<storage::Lsn>& commit_lsn) {
+  if (wal_manager_ == nullptr) {
+    return true;
+  }
+
+  std::vector<storage::wal::WalOp> ops;
+  std::vector<std::int64_t> int_scratch(request.operations.size());
+  for (std::size_t i = 0; i < request.operations.size(); ++i) {
+    const auto& operation = request.operations[i];
+    if (i >= result.operations.size() || !result.operations[i].success) {
+      continue;
+    }
+    if (operation.type == txn::OperationType::kSet && operation.value.has_value()) {
+      if (spilled[i].has_value()) {
+        const storage::btree::Record pointer_only{.value = *spilled[i],
+                                                  .metadata = operation.value->metadata};
+        ops.push_back(ToWalUpsert(operation.key, pointer_only, int_scratch[i]));
+      } else {
+        ops.push_back(ToWalUpsert(operation.key, *operation.value, int_scratch[i]));
+      }
+    } else if (operation.type == txn::OperationType::kDelete) {
+      storage::wal::WalOp tombstone{};
+      tombstone.type = storage::wal::RecordType::kTombstone;
+      tombstone.key = operation.key;
+      ops.push_back(tombstone);
+    }
+  }
+  if (ops.empty()) {
+    return true;
+  }
+
+  // The tree already holds these writes. Unless they are versioned, which lets the caller roll them
+  // back, a logging failure can only withdraw the acknowledgement, not the mutation.
+  try {
+    commit_lsn = wal_manager_->AppendTransaction(request.id, ops);
+    if (gate_guard.owns_lock()) {
+      gate_guard.unlock();
+    }
+    switch (request.durability) {
+    case txn::DurabilityClass::kAsync:
+      return true;
+    case txn::DurabilityClass::kGroup:
+      return wal_manager_->WaitDurable(*commit_lsn);
+    case txn::DurabilityClass::kSync:
+      wal_manager_->Flush();
+      return true;
+    }
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+void Worker::ApplyRead(const txn::Operation& operation, bool raw_values,
+                       txn::TransactionContext& context, TransactionResult& result) {
   OperationResult op_result{};
   op_result.type = operation.type;
   op_result.key = operation.key;
 
-  KeyLockGuard key_guard{lock_manager_, operation.key, lock::LockMode::kShared};
-  std::shared_lock tree_guard{btree_mutex_};
-  const auto found = btree_.Find(operation.key);
+  const auto found = raw_values ? btree_.FindStored(operation.key) : btree_.Find(operation.key);
   if (found.has_value()) {
     op_result.success = true;
     op_result.value = found;
@@ -120,8 +370,9 @@ void Worker::ApplyRead(const txn::Operation& operation, txn::TransactionContext&
   result.operations.push_back(std::move(op_result));
 }
 
-void Worker::ApplyWrite(const txn::Operation& operation, txn::TransactionContext& context,
-                        TransactionResult& result) {
+void Worker::ApplyWrite(const txn::Operation& operation,
+                        const std::optional<storage::btree::ValueLogRef>& spilled,
+                        txn::TransactionContext& context, TransactionResult& result) {
   OperationResult op_result{};
   op_result.type = operation.type;
   op_result.key = operation.key;
@@ -133,11 +384,19 @@ void Worker::ApplyWrite(const txn::Operation& operation, txn::TransactionContext
     return;
   }
 
-  KeyLockGuard key_guard{lock_manager_, operation.key, lock::LockMode::kExclusive};
-  std::unique_lock tree_guard{btree_mutex_};
-  btree_.Insert(operation.key, *operation.value);
+  if (spilled.has_value()) {
+    btree_.Insert(operation.key,
+                  storage::btree::Record{.value = *spilled, .metadata = operation.value->metadata},
+                  visibility_);
+  } else {
+    btree_.Insert(operation.key, *operation.value, visibility_);
+  }
   op_result.success = true;
-  op_result.value = operation.value;
+  // A chunked upload's value is already a value-log ref. Echoing it would make the dispatcher
+  // stream the whole upload back as if it had been read.
+  if (!std::holds_alternative<storage::btree::ValueLogRef>(operation.value->value)) {
+    op_result.value = operation.value;
+  }
   context.Write(operation.key, *operation.value);
 
   result.operations.push_back(std::move(op_result));
@@ -148,11 +407,15 @@ void Worker::ApplyDelete(const txn::Operation& operation, TransactionResult& res
   op_result.type = operation.type;
   op_result.key = operation.key;
 
-  KeyLockGuard key_guard{lock_manager_, operation.key, lock::LockMode::kExclusive};
-  std::unique_lock tree_guard{btree_mutex_};
-  op_result.success = btree_.Erase(operation.key);
+  op_result.success = btree_.Erase(operation.key, visibility_);
 
   result.operations.push_back(std::move(op_result));
 }
 
+void Worker::AbortVersions(std::span<const std::string> keys) {
+  if (snapshots_ != nullptr) {
+    btree_.AbortVersions(keys);
+  }
+}
+
 } // namespace jubilant::server
@@ -3,13 +3,18 @@
 #include "lock/lock_manager.h"
 #include "server/transaction_receiver.h"
 #include "storage/btree/btree.h"
+#include "storage/vlog/value_log_appender.h"
+#include "storage/wal/wal_manager.h"
+#include "txn/snapshot_registry.h"
 #include "txn/transaction_context.h"
 #include "txn/transaction_request.h"
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <shared_mutex>
+#include <span>
 #include <string>
 #include <thread>
 #include <vector>
@@ -33,8 +38,21 @@ class Worker {
 public:
   using CompletionFn = std::function<void(TransactionResult)>;
 
+  // wal_manager may be null, in which case commits are acknowledged without logging. Without an
+  // appender, oversized values are appended to the value log on the worker thread. A transaction
+  // takes the locks for its whole key set up front and holds them until it commits or aborts
+  // (strict 2PL). It then holds checkpoint_gate shared from its first tree access until its WAL
+  // append returns, so a checkpoint taking it exclusively sees only changes that are already
+  // logged. The tree latches itself, so workers writing different keys apply them in parallel.
+  // With snapshots, writes stay invisible to snapshot reads until stamped with their commit LSN
+  // and are rolled back if the transaction aborts; snapshot transactions then read without locks.
+  // snapshots needs wal_manager, whose LSNs stamp the versions.
   Worker(std::string name, TransactionReceiver& receiver, lock::LockManager& lock_manager,
-         storage::btree::BTree& btree, std::shared_mutex& btree_mutex, CompletionFn on_complete);
+         storage::btree::BTree& btree, CompletionFn on_complete,
+         storage::wal::WalManager* wal_manager = nullptr,
+         storage::vlog::ValueLogAppender* appender = nullptr,
+         std::shared_mutex* checkpoint_gate = nullptr,
+         txn::SnapshotRegistry* snapshots = nullptr);
   ~Worker();
 
   void Start();
@@ -43,37 +61,42 @@ public:
   [[nodiscard]] bool running() const noexcept;
 
 private:
-  class KeyLockGuard {
-  public:
-    KeyLockGuard(lock::LockManager& manager, std::string key, lock::LockMode mode);
-    ~KeyLockGuard();
-
-    KeyLockGuard(const KeyLockGuard&) = delete;
-    KeyLockGuard& operator=(const KeyLockGuard&) = delete;
-
-    KeyLockGuard(KeyLockGuard&&) = delete;
-    KeyLockGuard& operator=(KeyLockGuard&&) = delete;
-
-  private:
-    lock::LockManager& manager_;
-    std::string key_;
-    lock::LockMode mode_;
-  };
-
   void Run();
   TransactionResult Process(const txn::TransactionRequest& request);
-  void ApplyRead(const txn::Operation& operation, txn::TransactionContext& context,
-                 TransactionResult& result);
-  void ApplyWrite(const txn::Operation& operation, txn::TransactionContext& context,
-                  TransactionResult& result);
+  // A read-only transaction served at the visible LSN, taking no key locks or gate.
+  TransactionResult ProcessSnapshot(const txn::TransactionRequest& request);
+  void ApplyRead(const txn::Operation& operation, bool raw_values,
+                 txn::TransactionContext& context, TransactionResult& result);
+  void ApplyWrite(const txn::Operation& operation,
+                  const std::optional<storage::btree::ValueLogRef>& spilled,
+                  txn::TransactionContext& context, TransactionResult& result);
   void ApplyDelete(const txn::Operation& operation, TransactionResult& result);
+  // Rolls back the versioned writes to keys of a transaction that never reached the WAL.
+  void AbortVersions(std::span<const std::string> keys);
+  // Fills spilled with the value-log refs of the request's oversized set values.
+  void SpillValues(const txn::TransactionRequest& request,
+                   std::vector<std::optional<storage::btree::ValueLogRef>>& spilled,
+                   std::vector<std::shared_ptr<const void>>& holds);
+  // Releases gate_guard once the commit record is appended, before waiting for durability, and
+  // sets commit_lsn to the record's LSN. False when the append or the durability wait fails;
+  // commit_lsn then tells the two apart.
+  [[nodiscard]] bool LogCommit(const txn::TransactionRequest& request,
+                               std::span<const std::optional<storage::btree::ValueLogRef>> spilled,
+                               const TransactionResult& result,
+                               std::shared_lock<std::shared_mutex>& gate_guard,
+                               std::optional<storage::Lsn>& commit_lsn);
 
   std::string name_;
   TransactionReceiver& receiver_;
   lock::LockManager& lock_manager_;
   storage::btree::BTree& btree_;
-  std::shared_mutex& btree_mutex_;
   CompletionFn on_complete_;
+  storage::wal::WalManager* wal_manager_;
+  storage::vlog::ValueLogAppender* appender_;
+  std::shared_mutex* checkpoint_gate_;
+  txn::SnapshotRegistry* snapshots_;
+  // kAtCommit when snapshots_ is set.
+  storage::btree::Visibility visibility_;
 
   std::atomic<bool> running_{false};
   std::thread thread_;
@@ -1,8 +1,15 @@
 #include "storage/btree/btree.h"
 
+#include "storage/checksum.h"
+
 #include <algorithm>
 #include <cstring>
+#include <functional>
+#include <map>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 
 namespace jubilant::storage::btree {
 
@@ -18,28 +25,81 @@ enum class EncodedValueTag : std::uint8_t {
   kValueLogString = 4,
 };
 
+// Legacy leaves give every entry a 64-bit TTL. TTL-aware leaves follow the header with the page's
+// minimum TTL and delta width, and only entries whose tag carries kTagHasTtl store a TTL, as a
+// delta from that minimum. Leaves are always written TTL-aware; both are read.
+enum class LeafFormat : std::uint8_t {
+  kLegacy = 0,
+  kTtlAware = 1,
+};
+
 struct LeafHeader {
   std::uint8_t is_leaf{1U};
   std::uint16_t entry_count{0};
-  std::uint8_t reserved{0};
+  LeafFormat format{LeafFormat::kTtlAware};
   PageId next_leaf{kInvalidPageId};
 };
 
+// Follows a TTL-aware header: u64 minimum TTL (0 when no entry expires), u8 delta width.
+constexpr std::size_t kTtlSummarySize = sizeof(std::uint64_t) + sizeof(std::uint8_t);
+constexpr std::size_t kLeafPrefixSize = sizeof(LeafHeader) + kTtlSummarySize;
+
+constexpr std::uint8_t kTagHasTtl = 0x80U;
+constexpr std::uint8_t kTagValueMask = 0x7FU;
+
+// key_size, tag, value_len; a TTL-aware entry adds its TTL delta after the tag when it has one.
 constexpr std::size_t kEntryHeaderSize =
-    sizeof(std::uint16_t) + sizeof(std::uint8_t) + sizeof(std::uint64_t) + sizeof(std::uint64_t);
+    sizeof(std::uint16_t) + sizeof(std::uint8_t) + sizeof(std::uint64_t);
+constexpr std::size_t kLegacyEntryHeaderSize = kEntryHeaderSize + sizeof(std::uint64_t);
+
+// The TTLs of the entries on one leaf, which fix its delta base and width. Deltas take 32 bits
+// unless the page's TTLs span more than that (about 136 years).
+struct LeafTtlSpan {
+  std::uint64_t min{0};
+  std::uint64_t max{0};
+  std::size_t count{0};
+
+  [[nodiscard]] LeafTtlSpan With(std::uint64_t ttl) const noexcept {
+    if (ttl == 0) {
+      return *this;
+    }
+    if (count == 0) {
+      return LeafTtlSpan{.min = ttl, .max = ttl, .count = 1};
+    }
+    return LeafTtlSpan{.min = std::min(min, ttl), .max = std::max(max, ttl), .count = count + 1};
+  }
+
+  [[nodiscard]] std::uint8_t width() const noexcept {
+    return max - min <= std::numeric_limits<std::uint32_t>::max() ? sizeof(std::uint32_t)
+                                                                   : sizeof(std::uint64_t);
+  }
+
+  [[nodiscard]] std::size_t bytes() const noexcept { return count * width(); }
+};
 
 } // namespace
 
 BTree::BTree(Config config)
     : pager_(config.pager), value_log_(config.value_log),
-      inline_threshold_(config.inline_threshold), root_page_id_(config.root_hint),
-      ttl_clock_(config.ttl_clock) {
+      inline_threshold_(config.inline_threshold), inline_rules_(std::move(config.inline_rules)),
+      value_stats_(std::make_unique<ValueSizeStats>()), root_page_id_(config.root_hint),
+      ttl_clock_(config.ttl_clock), defer_page_writes_(config.defer_page_writes),
+      shards_(std::make_unique<std::array<Shard, kShardCount>>()),
+      page_latch_(std::make_unique<std::mutex>()) {
   if (pager_ == nullptr) {
     throw std::invalid_argument("Pager must not be null");
   }
   if (inline_threshold_ == 0 || inline_threshold_ >= pager_->payload_size()) {
     throw std::invalid_argument("Inline threshold must be within (0, payload_size)");
   }
+  if (!InlineRulesValid(inline_rules_, pager_->payload_size())) {
+    throw std::invalid_argument("Inline rules need unique prefixes and thresholds within "
+                                "(0, payload_size)");
+  }
+  std::stable_sort(inline_rules_.begin(), inline_rules_.end(),
+                   [](const auto& lhs, const auto& rhs) {
+                     return lhs.prefix.size() > rhs.prefix.size();
+                   });
   EnsureRootExists();
   LoadFromDisk(root_page_id_);
 }
@@ -77,9 +137,15 @@ void BTree::LoadFromDisk(PageId root_hint) {
   auto current = *root_page;
   while (true) {
     const auto leaf = DecodeLeafPage(current);
+    flushed_crcs_[current.id] = ComputeCrc32(current.payload);
     leaf_pages_.push_back(leaf);
     for (const auto& entry : leaf.entries) {
-      in_memory_.insert_or_assign(entry.key, entry.record);
+      auto& shard = ShardFor(entry.key);
+      shard.records.insert_or_assign(entry.key, entry.record);
+      // The page's minimum TTL says whether any entry on it expires at all.
+      if (leaf.min_ttl != 0) {
+        shard.expiry_index.Update(entry.key, 0, entry.record.metadata.ttl_epoch_seconds);
+      }
     }
 
     if (leaf.next_leaf == kInvalidPageId) {
@@ -91,82 +157,628 @@ void BTree::LoadFromDisk(PageId root_hint) {
     }
     current = *next;
   }
+
+  // Pages off the chain are leftovers of relocated leaves or of a checkpoint that never got
+  // published. Only a chain walked to its end proves that, so a broken one frees nothing.
+  if (!leaf_pages_.empty() && leaf_pages_.back().next_leaf == kInvalidPageId) {
+    for (PageId page_id = 0; page_id < pager_->page_count(); ++page_id) {
+      if (!flushed_crcs_.contains(page_id)) {
+        free_pages_.insert(page_id);
+      }
+    }
+  }
+
+  if (value_log_ != nullptr) {
+    for (const auto& shard : *shards_) {
+      for (const auto& [key, record] : shard.records) {
+        if (const auto* ref = std::get_if<ValueLogRef>(&record.value)) {
+          value_log_->MarkLive(ref->pointer);
+        }
+      }
+    }
+  }
 }
 
 std::optional<Record> BTree::Find(const std::string& key) const {
-  const auto iter = in_memory_.find(key);
-  if (iter == in_memory_.end()) {
+  auto stored = FindStored(key);
+  if (!stored.has_value()) {
+    return std::nullopt;
+  }
+  // The value-log read runs after the shard latch is dropped.
+  return Materialize(LeafEntry{.key = key, .record = std::move(*stored)});
+}
+
+std::optional<Record> BTree::FindStored(const std::string& key) const {
+  std::optional<Record> found;
+  {
+    auto& shard = ShardFor(key);
+    std::shared_lock latch(shard.latch);
+    const auto iter = shard.records.find(key);
+    found = ReadLocked(iter != shard.records.end() ? &iter->second : nullptr);
+  }
+  // Counted after the latch is dropped, so shared readers of a shard never wait on the stats.
+  if (found.has_value()) {
+    value_stats_->RecordRead(key, StoredSize(*found));
+  }
+  return found;
+}
+
+std::optional<Record> BTree::FindAt(const std::string& key, Lsn snapshot) const {
+  auto stored = FindStoredAt(key, snapshot);
+  if (!stored.has_value()) {
+    return std::nullopt;
+  }
+  return Materialize(LeafEntry{.key = key, .record = std::move(*stored)});
+}
+
+std::optional<Record> BTree::FindStoredAt(const std::string& key, Lsn snapshot) const {
+  std::optional<Record> found;
+  {
+    auto& shard = ShardFor(key);
+    std::shared_lock latch(shard.latch);
+    found = ReadLocked(ImageAtLocked(shard, key, snapshot));
+  }
+  if (found.has_value()) {
+    value_stats_->RecordRead(key, StoredSize(*found));
+  }
+  return found;
+}
+
+const Record* BTree::ImageAtLocked(const Shard& shard, const std::string& key, Lsn snapshot) {
+  const auto chain = shard.versions.find(key);
+  if (chain == shard.versions.end() ||
+      (chain->second.head_lsn.has_value() && *chain->second.head_lsn <= snapshot)) {
+    const auto iter = shard.records.find(key);
+    return iter != shard.records.end() ? &iter->second : nullptr;
+  }
+  const auto& history = chain->second.history;
+  const auto version = std::find_if(history.rbegin(), history.rend(),
+                                    [snapshot](const Version& entry) {
+                                      return entry.lsn <= snapshot;
+                                    });
+  if (version == history.rend() || !version->record.has_value()) {
+    return nullptr;
+  }
+  return &*version->record;
+}
+
+std::optional<Record> BTree::ReadLocked(const Record* image) const {
+  if (image == nullptr) {
     return std::nullopt;
   }
-  if (ttl_clock_ != nullptr && ttl_clock_->IsExpired(iter->second.metadata.ttl_epoch_seconds)) {
+  if (ttl_clock_ != nullptr && ttl_clock_->IsExpired(image->metadata.ttl_epoch_seconds)) {
     return std::nullopt;
   }
-  return Materialize(LeafEntry{.key = iter->first, .record = iter->second});
+  return *image;
 }
 
-void BTree::Insert(const std::string& key, Record record) {
+void BTree::Insert(const std::string& key, Record record, Visibility visibility) {
   if (key.empty()) {
     throw std::invalid_argument("Key must not be empty");
   }
 
-  if (!ShouldInline(record)) {
-    if (std::holds_alternative<ValueLogRef>(record.value)) {
-      in_memory_.insert_or_assign(key, std::move(record));
-      Persist();
-      return;
+  const auto spilled = SpillToValueLog(key, record);
+  if (spilled.has_value()) {
+    record.value = spilled->ref;
+  }
+  value_stats_->RecordWrite(key, StoredSize(record));
+  {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    ReplaceLocked(shard, key, std::move(record), visibility);
+  }
+  Persist();
+}
+
+std::optional<BTree::SpilledValue> BTree::SpillToValueLog(const std::string& key,
+                                                          const Record& record) const {
+  const auto payload = SpillPayloadFor(key, record);
+  if (!payload.has_value()) {
+    return std::nullopt;
+  }
+  if (value_log_ == nullptr) {
+    throw std::invalid_argument("Value log required for oversized values");
+  }
+
+  auto appended = value_log_->Append(payload->bytes);
+  SpilledValue spilled{};
+  spilled.ref.pointer = appended.pointer;
+  spilled.ref.type = payload->type;
+  spilled.hold = std::move(appended.hold);
+  return spilled;
+}
+
+std::optional<BTree::SpillPayload> BTree::SpillPayloadFor(const std::string& key,
+                                                          const Record& record) const {
+  if (ShouldInline(key, record) || std::holds_alternative<ValueLogRef>(record.value)) {
+    return std::nullopt;
+  }
+  SpillPayload payload{};
+  if (const auto* bytes = std::get_if<std::vector<std::byte>>(&record.value)) {
+    payload.bytes = *bytes;
+    payload.type = ValueType::kBytes;
+  } else if (const auto* str = std::get_if<std::string>(&record.value)) {
+    payload.bytes = std::as_bytes(std::span<const char>(*str));
+    payload.type = ValueType::kString;
+  } else {
+    throw std::invalid_argument("Unsupported value type for value log");
+  }
+  return payload;
+}
+
+bool BTree::Erase(const std::string& key, Visibility visibility) {
+  {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    if (!shard.records.contains(key)) {
+      return false;
     }
-    if (value_log_ == nullptr) {
-      throw std::invalid_argument("Value log required for oversized values");
+    ReplaceLocked(shard, key, std::nullopt, visibility);
+  }
+  Persist();
+  return true;
+}
+
+void BTree::ReplaceLocked(Shard& shard, const std::string& key, std::optional<Record> record,
+                          Visibility visibility) {
+  const auto existing = shard.records.find(key);
+  std::optional<Record> replaced;
+  if (existing != shard.records.end()) {
+    replaced = std::move(existing->second);
+  }
+  if (record.has_value() && value_log_ != nullptr) {
+    if (const auto* ref = std::get_if<ValueLogRef>(&record->value)) {
+      value_log_->MarkLive(ref->pointer);
     }
-    const auto serialized = [&]() {
-      if (auto* bytes = std::get_if<std::vector<std::byte>>(&record.value)) {
-        return *bytes;
-      }
-      if (auto* str = std::get_if<std::string>(&record.value)) {
-        return std::vector<std::byte>(
-            reinterpret_cast<const std::byte*>(str->data()),
-            reinterpret_cast<const std::byte*>(str->data() + str->size()));
-      }
-      throw std::invalid_argument("Unsupported value type for value log");
-    }();
+  }
+  shard.expiry_index.Update(key, replaced.has_value() ? replaced->metadata.ttl_epoch_seconds : 0,
+                            record.has_value() ? record->metadata.ttl_epoch_seconds : 0);
+
+  // A replaced image snapshots may still read keeps its value-log record live until it is pruned.
+  if (visibility == Visibility::kAtCommit) {
+    auto [chain, created] = shard.versions.try_emplace(key);
+    if (created) {
+      chain->second.history.push_back(Version{.lsn = 0, .record = std::move(replaced)});
+    } else if (chain->second.head_lsn.has_value()) {
+      chain->second.history.push_back(
+          Version{.lsn = *chain->second.head_lsn, .record = std::move(replaced)});
+      chain->second.head_lsn.reset();
+    } else {
+      // Rewritten by the transaction that wrote it, so no snapshot ever saw it.
+      ReleaseImage(replaced);
+    }
+  } else {
+    ReleaseImage(replaced);
+  }
 
-    const auto appended = value_log_->Append(serialized);
-    ValueLogRef ref{};
-    ref.pointer = appended.pointer;
-    ref.type =
-        std::holds_alternative<std::string>(record.value) ? ValueType::kString : ValueType::kBytes;
-    record.value = ref;
+  if (!record.has_value()) {
+    if (existing != shard.records.end()) {
+      shard.records.erase(existing);
+    }
+  } else if (existing != shard.records.end()) {
+    existing->second = std::move(*record);
+  } else {
+    shard.records.emplace(key, std::move(*record));
   }
+  ++shard.mutation_epoch;
+}
 
-  in_memory_.insert_or_assign(key, std::move(record));
-  Persist();
+void BTree::ReleaseImage(const std::optional<Record>& image) {
+  if (!image.has_value() || value_log_ == nullptr) {
+    return;
+  }
+  if (const auto* ref = std::get_if<ValueLogRef>(&image->value)) {
+    value_log_->MarkDead(ref->pointer);
+  }
 }
 
-bool BTree::Erase(const std::string& key) {
-  const auto erased = in_memory_.erase(key) > 0;
-  if (erased) {
+void BTree::CommitVersions(std::span<const std::string> keys, Lsn lsn) {
+  for (const auto& key : keys) {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    if (const auto chain = shard.versions.find(key);
+        chain != shard.versions.end() && !chain->second.head_lsn.has_value()) {
+      chain->second.head_lsn = lsn;
+    }
+  }
+}
+
+void BTree::AbortVersions(std::span<const std::string> keys) {
+  bool restored = false;
+  for (const auto& key : keys) {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    const auto chain = shard.versions.find(key);
+    if (chain == shard.versions.end() || chain->second.head_lsn.has_value()) {
+      continue;
+    }
+    auto version = std::move(chain->second.history.back());
+    chain->second.history.pop_back();
+    // The image was kept live while it sat in the history; putting it back marks it live again.
+    ReleaseImage(version.record);
+    ReplaceLocked(shard, key, std::move(version.record), Visibility::kImmediate);
+    if (chain->second.history.empty() && version.lsn == 0) {
+      shard.versions.erase(chain);
+    } else {
+      chain->second.head_lsn = version.lsn;
+    }
+    restored = true;
+  }
+  if (restored) {
+    Persist();
+  }
+}
+
+std::size_t BTree::CollectVersions(std::span<const std::string> keys, Lsn horizon) {
+  std::size_t dropped = 0;
+  for (const auto& key : keys) {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    if (const auto chain = shard.versions.find(key);
+        chain != shard.versions.end() && PruneLocked(chain->second, horizon, dropped)) {
+      shard.versions.erase(chain);
+    }
+  }
+  return dropped;
+}
+
+std::size_t BTree::CollectVersions(Lsn horizon) {
+  std::size_t dropped = 0;
+  for (auto& shard : *shards_) {
+    std::unique_lock latch(shard.latch);
+    for (auto chain = shard.versions.begin(); chain != shard.versions.end();) {
+      chain = PruneLocked(chain->second, horizon, dropped) ? shard.versions.erase(chain)
+                                                            : std::next(chain);
+    }
+  }
+  return dropped;
+}
+
+bool BTree::PruneLocked(VersionChain& chain, Lsn horizon, std::size_t& dropped) {
+  auto& history = chain.history;
+  if (chain.head_lsn.has_value() && *chain.head_lsn <= horizon) {
+    for (const auto& version : history) {
+      ReleaseImage(version.record);
+    }
+    dropped += history.size();
+    return true;
+  }
+  // Snapshots at horizon read the newest image at or before it; older ones are unreachable.
+  const auto newest_visible = std::find_if(history.rbegin(), history.rend(),
+                                           [horizon](const Version& version) {
+                                             return version.lsn <= horizon;
+                                           });
+  if (newest_visible == history.rend()) {
+    return false;
+  }
+  const auto first_kept = std::prev(newest_visible.base());
+  for (auto iter = history.begin(); iter != first_kept; ++iter) {
+    ReleaseImage(iter->record);
+  }
+  dropped += static_cast<std::size_t>(first_kept - history.begin());
+  history.erase(history.begin(), first_kept);
+  return false;
+}
+
+std::size_t BTree::retained_versions() const {
+  std::size_t count = 0;
+  for (auto& shard : *shards_) {
+    std::shared_lock latch(shard.latch);
+    for (const auto& [key, chain] : shard.versions) {
+      count += chain.history.size();
+    }
+  }
+  return count;
+}
+
+std::vector<std::string> BTree::ExpiredKeys(std::size_t limit) const {
+  if (ttl_clock_ == nullptr) {
+    return {};
+  }
+  // Each shard's soonest keys, merged by expiry so the result is soonest first across the tree.
+  const auto now = ttl_clock_->NowSeconds();
+  std::vector<std::pair<std::uint64_t, std::string>> due;
+  for (auto& shard : *shards_) {
+    std::shared_lock latch(shard.latch);
+    for (auto& key : shard.expiry_index.Due(now, limit)) {
+      due.emplace_back(shard.records.at(key).metadata.ttl_epoch_seconds, std::move(key));
+    }
+  }
+  std::sort(due.begin(), due.end());
+  due.resize(std::min(due.size(), limit));
+
+  std::vector<std::string> keys;
+  keys.reserve(due.size());
+  for (auto& [ttl, key] : due) {
+    keys.push_back(std::move(key));
+  }
+  return keys;
+}
+
+std::vector<std::string> BTree::EraseExpired(std::span<const std::string> keys) {
+  std::vector<std::string> erased;
+  if (ttl_clock_ == nullptr) {
+    return erased;
+  }
+  const auto now = ttl_clock_->NowSeconds();
+  for (const auto& key : keys) {
+    auto& shard = ShardFor(key);
+    std::unique_lock latch(shard.latch);
+    const auto iter = shard.records.find(key);
+    if (iter != shard.records.end() &&
+        ttl::TtlClock::IsExpiredAt(iter->second.metadata.ttl_epoch_seconds, now)) {
+      ReplaceLocked(shard, key, std::nullopt, Visibility::kImmediate);
+      erased.push_back(key);
+    }
+  }
+  if (!erased.empty()) {
     Persist();
   }
   return erased;
 }
 
-std::size_t BTree::size() const noexcept {
-  return in_memory_.size();
+std::size_t BTree::expiring_count() const {
+  std::size_t count = 0;
+  for (auto& shard : *shards_) {
+    std::shared_lock latch(shard.latch);
+    count += shard.expiry_index.size();
+  }
+  return count;
+}
+
+vlog::GcReport BTree::CollectValueLogGarbage(const vlog::GcOptions& options) {
+  vlog::GcReport report{};
+  if (value_log_ == nullptr) {
+    return report;
+  }
+  const auto victims = value_log_->SelectGcVictims(options);
+  if (victims.empty()) {
+    return report;
+  }
+
+  // Keyed by where the record sits now; maps to its copy once one exists. Images kept for
+  // snapshot readers move with the current ones, and share a copy when they share a record.
+  using Location = std::pair<SegmentId, std::uint64_t>;
+  std::map<Location, SegmentPointer> copies;
+  const auto in_victim = [&](const Record& record) -> const ValueLogRef* {
+    const auto* ref = std::get_if<ValueLogRef>(&record.value);
+    if (ref == nullptr ||
+        std::find(victims.begin(), victims.end(), ref->pointer.segment_id) == victims.end()) {
+      return nullptr;
+    }
+    return ref;
+  };
+  for (auto& shard : *shards_) {
+    std::shared_lock latch(shard.latch);
+    const auto collect = [&](const Record& record) {
+      if (const auto* ref = in_victim(record); ref != nullptr) {
+        copies.try_emplace(Location{ref->pointer.segment_id, ref->pointer.offset}, ref->pointer);
+      }
+    };
+    for (const auto& [key, record] : shard.records) {
+      collect(record);
+    }
+    for (const auto& [key, chain] : shard.versions) {
+      for (const auto& version : chain.history) {
+        if (version.record.has_value()) {
+          collect(*version.record);
+        }
+      }
+    }
+  }
+
+  // The copying and the sync run with no latch held. A failure leaves the tree untouched and the
+  // victims in place; copies nothing points at yet are just garbage for a later pass.
+  for (auto& [location, pointer] : copies) {
+    const auto old_length = pointer.length;
+    pointer = value_log_->Relocate(pointer).pointer;
+    report.bytes_relocated += old_length;
+  }
+  // The copies must be durable before any leaf points at them.
+  value_log_->Sync();
+
+  // Each shard is repointed under its own latch. A record rewritten since the scan no longer
+  // carries the old pointer and keeps its new value; its copy is left as garbage.
+  for (auto& shard : *shards_) {
+    std::unique_lock latch(shard.latch);
+    std::size_t repointed = 0;
+    const auto repoint = [&](Record& record) {
+      auto* ref = std::get_if<ValueLogRef>(&record.value);
+      if (ref == nullptr) {
+        return;
+      }
+      const auto copy = copies.find(Location{ref->pointer.segment_id, ref->pointer.offset});
+      if (copy == copies.end()) {
+        return;
+      }
+      value_log_->MarkLive(copy->second);
+      value_log_->MarkDead(ref->pointer);
+      ref->pointer = copy->second;
+      ++repointed;
+    };
+    for (auto& [key, record] : shard.records) {
+      repoint(record);
+    }
+    for (auto& [key, chain] : shard.versions) {
+      for (auto& version : chain.history) {
+        if (version.record.has_value()) {
+          repoint(*version.record);
+        }
+      }
+    }
+    if (repointed != 0) {
+      ++shard.mutation_epoch;
+      report.records_relocated += repointed;
+    }
+  }
+  if (report.records_relocated != 0) {
+    Persist();
+  }
+
+  value_log_->RetireSegments(victims);
+  report.retired_segments = victims;
+  return report;
+}
+
+std::size_t BTree::size() const {
+  std::size_t count = 0;
+  for (auto& shard : *shards_) {
+    std::shared_lock latch(shard.latch);
+    count += shard.records.size();
+  }
+  return count;
+}
+
+BTree::DirtyPages BTree::CaptureDirtyPages(Lsn lsn, const std::function<void()>& laid_out) {
+  std::scoped_lock guard(*page_latch_);
+  return CaptureDirtyPagesLocked(lsn, laid_out);
+}
+
+BTree::DirtyPages BTree::CaptureDirtyPagesLocked(Lsn lsn, const std::function<void()>& laid_out) {
+  DirtyPages dirty{.pages = {}, .released = {}, .root_page_id = root_page_id_, .epoch = 0};
+  bool unchanged = false;
+  {
+    // Writers wait only while the records are laid out into leaves. The leaves are copies, so
+    // relocating, encoding, and comparing them below runs without any shard latch.
+    const auto latches = LatchAllShared();
+    dirty.epoch = MutationEpochLocked();
+    unchanged = dirty.epoch == flushed_epoch_;
+    if (!unchanged) {
+      RebuildLeafPages(SortedRecordsLocked());
+    }
+  }
+  if (laid_out) {
+    laid_out();
+  }
+  if (unchanged) {
+    return dirty;
+  }
+  if (defer_page_writes_) {
+    RelocateChangedLeaves();
+  }
+  dirty.root_page_id = root_page_id_;
+
+  std::unordered_set<PageId> live;
+  for (const auto& leaf : leaf_pages_) {
+    live.insert(leaf.page_id);
+    auto page = EncodeLeafPage(leaf);
+    const auto flushed = flushed_crcs_.find(page.id);
+    if (flushed != flushed_crcs_.end() && flushed->second == ComputeCrc32(page.payload)) {
+      continue;
+    }
+    page.lsn = lsn;
+    dirty.pages.push_back(std::move(page));
+  }
+  for (const auto& [page_id, crc] : flushed_crcs_) {
+    if (!live.contains(page_id)) {
+      dirty.released.push_back(page_id);
+    }
+  }
+  std::sort(dirty.pages.begin(), dirty.pages.end(),
+            [](const Page& lhs, const Page& rhs) { return lhs.id < rhs.id; });
+  std::sort(dirty.released.begin(), dirty.released.end());
+  return dirty;
+}
+
+void BTree::MarkFlushed(const DirtyPages& dirty) {
+  std::scoped_lock guard(*page_latch_);
+  MarkFlushedLocked(dirty);
+}
+
+void BTree::MarkFlushedLocked(const DirtyPages& dirty) {
+  for (const auto& page : dirty.pages) {
+    flushed_crcs_[page.id] = ComputeCrc32(page.payload);
+  }
+  for (const auto page_id : dirty.released) {
+    flushed_crcs_.erase(page_id);
+    free_pages_.insert(page_id);
+  }
+  flushed_epoch_ = std::max(flushed_epoch_, dirty.epoch);
+}
+
+bool BTree::has_unflushed_changes() const {
+  std::scoped_lock guard(*page_latch_);
+  const auto latches = LatchAllShared();
+  return MutationEpochLocked() != flushed_epoch_;
 }
 
-PageId BTree::root_page_id() const noexcept {
+PageId BTree::root_page_id() const {
+  std::scoped_lock guard(*page_latch_);
   return root_page_id_;
 }
 
-bool BTree::ShouldInline(const Record& record) const {
+BTree::Shard& BTree::ShardFor(const std::string& key) const {
+  return (*shards_)[std::hash<std::string>{}(key) % kShardCount];
+}
+
+std::array<std::shared_lock<std::shared_mutex>, BTree::kShardCount> BTree::LatchAllShared() const {
+  std::array<std::shared_lock<std::shared_mutex>, kShardCount> latches;
+  for (std::size_t index = 0; index < kShardCount; ++index) {
+    latches[index] = std::shared_lock((*shards_)[index].latch);
+  }
+  return latches;
+}
+
+std::uint64_t BTree::MutationEpochLocked() const noexcept {
+  std::uint64_t epoch = 0;
+  for (const auto& shard : *shards_) {
+    epoch += shard.mutation_epoch;
+  }
+  return epoch;
+}
+
+std::vector<const BTree::RecordMap::value_type*> BTree::SortedRecordsLocked() const {
+  using Cursor = std::pair<RecordMap::const_iterator, RecordMap::const_iterator>;
+  const auto later = [](const Cursor& lhs, const Cursor& rhs) {
+    return lhs.first->first > rhs.first->first;
+  };
+  std::vector<Cursor> heads;
+  std::size_t total = 0;
+  for (const auto& shard : *shards_) {
+    total += shard.records.size();
+    if (!shard.records.empty()) {
+      heads.emplace_back(shard.records.begin(), shard.records.end());
+    }
+  }
+
+  std::vector<const RecordMap::value_type*> sorted;
+  sorted.reserve(total);
+  std::make_heap(heads.begin(), heads.end(), later);
+  while (!heads.empty()) {
+    std::pop_heap(heads.begin(), heads.end(), later);
+    auto& head = heads.back();
+    sorted.push_back(&*head.first);
+    if (++head.first == head.second) {
+      heads.pop_back();
+    } else {
+      std::push_heap(heads.begin(), heads.end(), later);
+    }
+  }
+  return sorted;
+}
+
+std::uint32_t BTree::InlineThresholdFor(std::string_view key) const noexcept {
+  for (const auto& rule : inline_rules_) {
+    if (key.starts_with(rule.prefix)) {
+      return rule.threshold;
+    }
+  }
+  return inline_threshold_;
+}
+
+std::vector<ValueSizeStats::PrefixReport> BTree::InlineThresholdReport() const {
+  return value_stats_->Report(static_cast<std::uint32_t>(pager_->payload_size() / 4));
+}
+
+bool BTree::ShouldInline(std::string_view key, const Record& record) const {
   if (std::holds_alternative<std::int64_t>(record.value)) {
     return true;
   }
   if (const auto* bytes = std::get_if<std::vector<std::byte>>(&record.value)) {
-    return bytes->size() <= inline_threshold_;
+    return bytes->size() <= InlineThresholdFor(key);
   }
   if (const auto* str = std::get_if<std::string>(&record.value)) {
-    return str->size() <= inline_threshold_;
+    return str->size() <= InlineThresholdFor(key);
   }
   if (std::holds_alternative<ValueLogRef>(record.value)) {
     return false;
@@ -174,6 +786,21 @@ bool BTree::ShouldInline(const Record& record) const {
   return true;
 }
 
+std::uint64_t BTree::StoredSize(const Record& record) noexcept {
+  return std::visit(
+      [](const auto& value) -> std::uint64_t {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, ValueLogRef>) {
+          return value.pointer.length;
+        } else if constexpr (std::is_same_v<T, std::int64_t>) {
+          return sizeof(value);
+        } else {
+          return value.size();
+        }
+      },
+      record.value);
+}
+
 Page BTree::EncodeLeafPage(const LeafPage& leaf) const {
   Page page{};
   page.id = leaf.page_id;
@@ -187,15 +814,26 @@ Page BTree::EncodeLeafPage(const LeafPage& leaf) const {
   header.entry_count = static_cast<std::uint16_t>(leaf.entries.size());
   header.next_leaf = leaf.next_leaf;
 
+  LeafTtlSpan ttls{};
+  for (const auto& entry : leaf.entries) {
+    ttls = ttls.With(entry.record.metadata.ttl_epoch_seconds);
+  }
+  const auto ttl_width = ttls.width();
+
   std::size_t offset = 0;
   std::memcpy(page.payload.data() + offset, &header, sizeof(LeafHeader));
   offset += sizeof(LeafHeader);
+  std::memcpy(page.payload.data() + offset, &ttls.min, sizeof(ttls.min));
+  offset += sizeof(ttls.min);
+  page.payload[offset++] = static_cast<std::byte>(ttl_width);
 
   for (const auto& entry : leaf.entries) {
     const auto key_size = static_cast<std::uint16_t>(entry.key.size());
     const auto& record = entry.record;
+    const auto ttl = record.metadata.ttl_epoch_seconds;
+    const std::size_t ttl_size = ttl != 0 ? ttl_width : 0;
 
-    if (offset + kEntryHeaderSize + key_size > page.payload.size()) {
+    if (offset + kEntryHeaderSize + ttl_size + key_size > page.payload.size()) {
       throw std::runtime_error("Entry does not fit in page");
     }
 
@@ -222,11 +860,20 @@ Page BTree::EncodeLeafPage(const LeafPage& leaf) const {
     std::memcpy(page.payload.data() + offset, &key_size, sizeof(std::uint16_t));
     offset += sizeof(std::uint16_t);
 
+    if (ttl != 0) {
+      tag_byte |= kTagHasTtl;
+    }
     page.payload[offset++] = static_cast<std::byte>(tag_byte);
 
-    std::memcpy(page.payload.data() + offset, &record.metadata.ttl_epoch_seconds,
-                sizeof(std::uint64_t));
-    offset += sizeof(std::uint64_t);
+    if (ttl_width == sizeof(std::uint32_t) && ttl != 0) {
+      const auto delta = static_cast<std::uint32_t>(ttl - ttls.min);
+      std::memcpy(page.payload.data() + offset, &delta, sizeof(delta));
+      offset += sizeof(delta);
+    } else if (ttl != 0) {
+      const std::uint64_t delta = ttl - ttls.min;
+      std::memcpy(page.payload.data() + offset, &delta, sizeof(delta));
+      offset += sizeof(delta);
+    }
 
     std::memcpy(page.payload.data() + offset, &value_len, sizeof(std::uint64_t));
     offset += sizeof(std::uint64_t);
@@ -286,9 +933,27 @@ BTree::LeafPage BTree::DecodeLeafPage(const Page& page) {
   leaf.page_id = page.id;
   leaf.next_leaf = header.next_leaf;
 
+  const bool legacy = header.format == LeafFormat::kLegacy;
+  if (!legacy && header.format != LeafFormat::kTtlAware) {
+    throw std::runtime_error("Unknown leaf page format");
+  }
+
   std::size_t offset = sizeof(LeafHeader);
+  std::uint64_t ttl_base = 0;
+  std::size_t ttl_width = 0;
+  if (!legacy) {
+    if (page.payload.size() < kLeafPrefixSize) {
+      throw std::runtime_error("Leaf page too small");
+    }
+    std::memcpy(&ttl_base, page.payload.data() + offset, sizeof(ttl_base));
+    offset += sizeof(ttl_base);
+    ttl_width = static_cast<std::uint8_t>(page.payload[offset++]);
+    leaf.min_ttl = ttl_base;
+  }
+
+  const auto entry_header_size = legacy ? kLegacyEntryHeaderSize : kEntryHeaderSize;
   for (std::uint16_t i = 0; i < header.entry_count; ++i) {
-    if (offset + kEntryHeaderSize > page.payload.size()) {
+    if (offset + entry_header_size > page.payload.size()) {
       throw std::runtime_error("Corrupt leaf entry header");
     }
 
@@ -302,8 +967,30 @@ BTree::LeafPage BTree::DecodeLeafPage(const Page& page) {
 
     tag_byte = static_cast<std::uint8_t>(page.payload[offset++]);
 
-    std::memcpy(&ttl, page.payload.data() + offset, sizeof(std::uint64_t));
-    offset += sizeof(std::uint64_t);
+    if (legacy) {
+      std::memcpy(&ttl, page.payload.data() + offset, sizeof(std::uint64_t));
+      offset += sizeof(std::uint64_t);
+      if (ttl != 0 && (leaf.min_ttl == 0 || ttl < leaf.min_ttl)) {
+        leaf.min_ttl = ttl;
+      }
+    } else if ((tag_byte & kTagHasTtl) != 0) {
+      tag_byte &= kTagValueMask;
+      if (offset + ttl_width + sizeof(std::uint64_t) > page.payload.size()) {
+        throw std::runtime_error("Corrupt leaf entry TTL");
+      }
+      if (ttl_width == sizeof(std::uint32_t)) {
+        std::uint32_t delta{};
+        std::memcpy(&delta, page.payload.data() + offset, sizeof(delta));
+        ttl = ttl_base + delta;
+      } else if (ttl_width == sizeof(std::uint64_t)) {
+        std::uint64_t delta{};
+        std::memcpy(&delta, page.payload.data() + offset, sizeof(delta));
+        ttl = ttl_base + delta;
+      } else {
+        throw std::runtime_error("Corrupt leaf TTL width");
+      }
+      offset += ttl_width;
+    }
 
     std::memcpy(&value_len, page.payload.data() + offset, sizeof(std::uint64_t));
     offset += sizeof(std::uint64_t);
@@ -390,13 +1077,18 @@ BTree::LeafPage BTree::DecodeLeafPage(const Page& page) {
 }
 
 void BTree::Persist() {
-  RebuildLeafPages();
-  for (const auto& leaf : leaf_pages_) {
-    pager_->Write(EncodeLeafPage(leaf));
+  if (defer_page_writes_) {
+    return;
   }
+  std::scoped_lock guard(*page_latch_);
+  const auto dirty = CaptureDirtyPagesLocked(0);
+  for (const auto& page : dirty.pages) {
+    pager_->Write(page);
+  }
+  MarkFlushedLocked(dirty);
 }
 
-void BTree::RebuildLeafPages() {
+void BTree::RebuildLeafPages(std::span<const RecordMap::value_type* const> records) {
   std::vector<PageId> existing_ids;
   existing_ids.reserve(leaf_pages_.size());
   for (const auto& leaf : leaf_pages_) {
@@ -412,31 +1104,36 @@ void BTree::RebuildLeafPages() {
     if (written_count < existing_ids.size()) {
       return existing_ids[written_count];
     }
-    return pager_->Allocate(PageType::kLeaf);
+    return AllocateLeafPage();
   };
 
-  auto iter = in_memory_.begin();
-  if (iter == in_memory_.end()) {
+  auto iter = records.begin();
+  if (iter == records.end()) {
     current.next_leaf = kInvalidPageId;
     leaf_pages_.push_back(current);
     return;
   }
 
-  while (iter != in_memory_.end()) {
+  while (iter != records.end()) {
     current.entries.clear();
-    std::size_t used = sizeof(LeafHeader);
-    while (iter != in_memory_.end()) {
-      LeafEntry entry{.key = iter->first, .record = iter->second};
+    // TTL bytes are counted apart: a new entry can widen every delta on the page.
+    std::size_t used = kLeafPrefixSize;
+    LeafTtlSpan ttls{};
+    while (iter != records.end()) {
+      LeafEntry entry{.key = (*iter)->first, .record = (*iter)->second};
       const auto entry_size = EncodedEntrySize(entry);
-      if (used + entry_size > payload_size) {
+      const auto next_ttls = ttls.With(entry.record.metadata.ttl_epoch_seconds);
+      if (used + entry_size + next_ttls.bytes() > payload_size) {
         break;
       }
       used += entry_size;
+      ttls = next_ttls;
       current.entries.push_back(entry);
       ++iter;
     }
+    current.min_ttl = ttls.min;
 
-    if (iter != in_memory_.end()) {
+    if (iter != records.end()) {
       const auto next_id = next_page_id(leaf_pages_.size() + 1);
       current.next_leaf = next_id;
       leaf_pages_.push_back(current);
@@ -450,6 +1147,41 @@ void BTree::RebuildLeafPages() {
   }
 }
 
+void BTree::RelocateChangedLeaves() {
+  // Leaves only link forward, so moving a leaf rewrites its predecessor's next pointer. Every leaf
+  // up to the last changed one therefore moves: the leaf-chain form of copying a root-to-leaf path.
+  std::optional<std::size_t> last_changed;
+  for (std::size_t index = 0; index < leaf_pages_.size(); ++index) {
+    const auto flushed = flushed_crcs_.find(leaf_pages_[index].page_id);
+    if (flushed == flushed_crcs_.end() ||
+        flushed->second != ComputeCrc32(EncodeLeafPage(leaf_pages_[index]).payload)) {
+      last_changed = index;
+    }
+  }
+  if (!last_changed.has_value()) {
+    return;
+  }
+
+  // Leaves already on pages the flushed tree does not reference were moved by an earlier capture
+  // that never got published; they can be rewritten where they are.
+  for (std::size_t index = 0; index <= *last_changed; ++index) {
+    if (flushed_crcs_.contains(leaf_pages_[index].page_id)) {
+      leaf_pages_[index].page_id = AllocateLeafPage();
+    }
+  }
+  for (std::size_t index = 0; index + 1 < leaf_pages_.size(); ++index) {
+    leaf_pages_[index].next_leaf = leaf_pages_[index + 1].page_id;
+  }
+  root_page_id_ = leaf_pages_.front().page_id;
+}
+
+PageId BTree::AllocateLeafPage() {
+  if (!free_pages_.empty()) {
+    return free_pages_.extract(free_pages_.begin()).value();
+  }
+  return pager_->Allocate(PageType::kLeaf);
+}
+
 std::size_t BTree::EncodedEntrySize(const LeafEntry& entry) {
   const auto key_size = entry.key.size();
   std::size_t value_size = 0;
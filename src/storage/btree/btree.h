@@ -1,15 +1,26 @@
 #pragma once
 
+#include "storage/btree/value_stats.h"
 #include "storage/pager/pager.h"
 #include "storage/storage_common.h"
+#include "storage/ttl/expiry_index.h"
 #include "storage/ttl/ttl_clock.h"
 #include "storage/vlog/value_log.h"
 
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <shared_mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -40,28 +51,155 @@ struct Record {
   RecordMetadata metadata;
 };
 
+// When a write becomes visible to snapshot reads (FindAt, FindStoredAt).
+enum class Visibility : std::uint8_t {
+  // Replaces the key's image outright: recovery, the TTL sweeper, stores without snapshots.
+  kImmediate,
+  // Keeps the image it replaced for snapshot readers until CommitVersions() stamps the write with
+  // its commit LSN, or AbortVersions() puts that image back.
+  kAtCommit,
+};
+
+// Safe to share between threads. Records are split across hash shards, each behind its own latch:
+// reads latch their key's shard shared and writes exclusive, so writers on different shards run
+// in parallel. Leaf-page state has a latch of its own that checkpoint capture and write-through
+// hold while they latch every shard in index order.
 class BTree {
 public:
   struct Config {
     Pager* pager{nullptr};
     vlog::ValueLog* value_log{nullptr};
-    // Matches manifest.inline_threshold so inline vs. value-log spill decisions stay stable across
-    // WAL replay and checkpoints.
+    // Matches manifest.inline_threshold and manifest.inline_rules so inline vs. value-log spill
+    // decisions stay stable across WAL replay and checkpoints.
     std::uint32_t inline_threshold{0};
+    std::vector<InlineRule> inline_rules{};
     PageId root_hint{0};
     const ttl::TtlClock* ttl_clock{nullptr};
+    // When set, mutations only mark the tree dirty and leaves reach the pager through
+    // CaptureDirtyPages() at checkpoint time, with the WAL covering everything since. Otherwise
+    // every mutation writes its changed leaves through.
+    //
+    // Deferred captures are copy-on-write: a captured leaf never overwrites a page the last flushed
+    // tree references. Changed leaves move to free pages, and the new tree becomes visible only
+    // when the caller publishes the captured root. Rewriting in place is not crash-safe here, since
+    // a layout change moves records between leaves and a crash partway through the page writes
+    // could leave a record on neither its old page nor its new one, with the WAL that held it
+    // already released.
+    bool defer_page_writes{false};
   };
 
   explicit BTree(Config config);
 
   [[nodiscard]] std::optional<Record> Find(const std::string& key) const;
-  void Insert(const std::string& key, Record record);
-  [[nodiscard]] bool Erase(const std::string& key);
-  [[nodiscard]] std::size_t size() const noexcept;
+  // Like Find, but a spilled value comes back as its ValueLogRef instead of being read from the
+  // value log, for callers that stream it out of the segment themselves.
+  [[nodiscard]] std::optional<Record> FindStored(const std::string& key) const;
+  // Find and FindStored as of a snapshot: the newest image committed at or before snapshot,
+  // skipping writes still pending. TTLs are judged against the current clock.
+  [[nodiscard]] std::optional<Record> FindAt(const std::string& key, Lsn snapshot) const;
+  [[nodiscard]] std::optional<Record> FindStoredAt(const std::string& key, Lsn snapshot) const;
+  void Insert(const std::string& key, Record record,
+              Visibility visibility = Visibility::kImmediate);
+  // Appends an oversized value to the value log and returns the reference Insert would store;
+  // nullopt when the record stays inline or already points into the log. Touches no tree state, so
+  // writers call it before applying the write and log only the resulting pointer in the WAL. Keep
+  // hold until the ref is inserted or abandoned, or GC may reclaim the value first.
+  struct SpilledValue {
+    ValueLogRef ref;
+    std::shared_ptr<const void> hold;
+  };
+  [[nodiscard]] std::optional<SpilledValue> SpillToValueLog(const std::string& key,
+                                                            const Record& record) const;
+  // What SpillToValueLog would append for record: the value's bytes, viewing record, and the type
+  // its ref carries. nullopt under the same conditions. Lets callers queue the append elsewhere.
+  struct SpillPayload {
+    std::span<const std::byte> bytes;
+    ValueType type{ValueType::kBytes};
+  };
+  [[nodiscard]] std::optional<SpillPayload> SpillPayloadFor(const std::string& key,
+                                                            const Record& record) const;
+  // The inline threshold that applies to key: its longest matching rule's, else the global one.
+  [[nodiscard]] std::uint32_t InlineThresholdFor(std::string_view key) const noexcept;
+  // Value sizes seen by Insert, Find, and FindStored, with a recommended threshold per key prefix.
+  // Recommendations are capped at a quarter of the page payload so a leaf still holds a few
+  // entries.
+  [[nodiscard]] std::vector<ValueSizeStats::PrefixReport> InlineThresholdReport() const;
+  [[nodiscard]] bool Erase(const std::string& key,
+                           Visibility visibility = Visibility::kImmediate);
+  // Makes the pending writes to keys visible to snapshots at or after lsn.
+  void CommitVersions(std::span<const std::string> keys, Lsn lsn);
+  // Restores the images the pending writes to keys replaced.
+  void AbortVersions(std::span<const std::string> keys);
+  // Drops replaced images no snapshot at or after horizon can read, for keys or for every key.
+  // Returns how many were dropped.
+  std::size_t CollectVersions(std::span<const std::string> keys, Lsn horizon);
+  std::size_t CollectVersions(Lsn horizon);
+  // Replaced images still kept for snapshot readers.
+  [[nodiscard]] std::size_t retained_versions() const;
+  // Up to limit keys whose TTL has passed by the tree's clock, soonest first; empty without one.
+  // Served from an expiry index kept beside the records, so live keys are never visited.
+  [[nodiscard]] std::vector<std::string> ExpiredKeys(std::size_t limit) const;
+  // Erases those of keys whose records are still expired, all judged at one clock reading, so a
+  // write that renewed one after ExpiredKeys() survives. Returns the keys it erased.
+  [[nodiscard]] std::vector<std::string> EraseExpired(std::span<const std::string> keys);
+  // Records carrying a TTL, expired or not.
+  [[nodiscard]] std::size_t expiring_count() const;
+  // One value-log GC pass: copies live records out of the sparsest segments, repoints their leaves,
+  // and retires the victims. The copies and their sync run unlatched; each shard is then latched
+  // alone to repoint the records still carrying an old pointer. The retired segments are only
+  // deleted by ValueLog::ReleaseRetiredSegments() once a checkpoint covers the new leaves.
+  vlog::GcReport CollectValueLogGarbage(const vlog::GcOptions& options);
+  [[nodiscard]] std::size_t size() const;
 
-  [[nodiscard]] PageId root_page_id() const noexcept;
+  [[nodiscard]] PageId root_page_id() const;
+
+  struct DirtyPages {
+    std::vector<Page> pages;
+    // Pages the captured tree no longer references. They become reusable once it is published.
+    std::vector<PageId> released;
+    PageId root_page_id{0};
+    std::uint64_t epoch{0};
+  };
+  // Encodes the leaves and returns those whose image differs from the last one marked flushed,
+  // stamped with lsn and ordered by page id. Every shard stays latched while the records are laid
+  // out into leaves; callers hold off writes that are not yet logged until then, so the image
+  // matches lsn. laid_out runs as soon as the layout is fixed, before any leaf is encoded, and is
+  // where such callers let writes resume.
+  [[nodiscard]] DirtyPages CaptureDirtyPages(Lsn lsn, const std::function<void()>& laid_out = {});
+  // Records that a capture reached the pager and, under shadow paging, that its root was
+  // published. Until then its pages are captured again and its released pages stay untouched.
+  void MarkFlushed(const DirtyPages& dirty);
+  [[nodiscard]] bool has_unflushed_changes() const;
 
 private:
+  using RecordMap = std::map<std::string, Record>;
+
+  struct Version {
+    Lsn lsn{0};
+    // nullopt when the key did not exist.
+    std::optional<Record> record;
+  };
+
+  // Kept only for keys whose history a snapshot may still need.
+  struct VersionChain {
+    // Images the current one replaced, oldest first. LSN 0 marks one committed before any
+    // snapshot that is still open or can still be opened.
+    std::vector<Version> history;
+    // Commit LSN of the current image; nullopt while a write to it is pending.
+    std::optional<Lsn> head_lsn;
+  };
+
+  struct Shard {
+    std::shared_mutex latch;
+    RecordMap records;
+    std::unordered_map<std::string, VersionChain> versions;
+    // Rebuilt from the leaves' TTLs on load and kept in step with records afterwards.
+    ttl::ExpiryIndex expiry_index;
+    // Mutations applied to this shard; the tree's epoch is the sum over all shards.
+    std::uint64_t mutation_epoch{0};
+  };
+  static constexpr std::size_t kShardCount = 16;
+
   struct LeafEntry {
     std::string key;
     Record record;
@@ -70,24 +208,66 @@ private:
   struct LeafPage {
     PageId page_id{0};
     PageId next_leaf{std::numeric_limits<PageId>::max()};
+    // Earliest TTL among the entries, 0 when none expires.
+    std::uint64_t min_ttl{0};
     std::vector<LeafEntry> entries;
   };
 
   Pager* pager_;
   vlog::ValueLog* value_log_;
   std::uint32_t inline_threshold_;
+  // Longest prefix first, so the first match is the most specific.
+  std::vector<InlineRule> inline_rules_;
+  // Behind a pointer so the tree stays movable.
+  std::unique_ptr<ValueSizeStats> value_stats_;
   PageId root_page_id_{0};
   const ttl::TtlClock* ttl_clock_{nullptr};
-  std::map<std::string, Record> in_memory_;
+  bool defer_page_writes_{false};
+  // Both behind pointers so the tree stays movable.
+  std::unique_ptr<std::array<Shard, kShardCount>> shards_;
+  // Guards root_page_id_ and everything below. Taken before any shard latch.
+  std::unique_ptr<std::mutex> page_latch_;
   std::vector<LeafPage> leaf_pages_;
+  // The newest mutation epoch whose leaves reached the pager.
+  std::uint64_t flushed_epoch_{0};
+  // Payload CRC of the image last written for each leaf, to skip rewriting unchanged ones.
+  std::unordered_map<PageId, std::uint32_t> flushed_crcs_;
+  // Pages no flushed leaf references, lowest first so relocated leaves land close together.
+  std::set<PageId> free_pages_;
 
+  [[nodiscard]] Shard& ShardFor(const std::string& key) const;
+  [[nodiscard]] std::array<std::shared_lock<std::shared_mutex>, kShardCount> LatchAllShared() const;
+  // Sum of the shards' epochs; callers hold every shard latch.
+  [[nodiscard]] std::uint64_t MutationEpochLocked() const noexcept;
+  // Every record in key order, merged across shards; callers hold every shard latch.
+  [[nodiscard]] std::vector<const RecordMap::value_type*> SortedRecordsLocked() const;
+  // Sets key's current image, nullopt erasing it, with value-log and expiry bookkeeping.
+  void ReplaceLocked(Shard& shard, const std::string& key, std::optional<Record> record,
+                     Visibility visibility);
+  // Drops what no snapshot at or after horizon can read from chain; true when nothing is left.
+  bool PruneLocked(VersionChain& chain, Lsn horizon, std::size_t& dropped);
+  // The image a snapshot sees for key: the head, or the newest history entry at or before snapshot.
+  // nullptr when the key did not exist then.
+  [[nodiscard]] static const Record* ImageAtLocked(const Shard& shard, const std::string& key,
+                                                   Lsn snapshot);
+  // A copy of image unless it is missing or expired.
+  [[nodiscard]] std::optional<Record> ReadLocked(const Record* image) const;
+  void ReleaseImage(const std::optional<Record>& image);
   void LoadFromDisk(PageId root_hint);
+  // Writes the changed leaves through unless page writes are deferred. Callers hold no latch.
   void Persist();
-  void RebuildLeafPages();
+  [[nodiscard]] DirtyPages CaptureDirtyPagesLocked(Lsn lsn,
+                                                   const std::function<void()>& laid_out = {});
+  void MarkFlushedLocked(const DirtyPages& dirty);
+  void RebuildLeafPages(std::span<const RecordMap::value_type* const> records);
+  void RelocateChangedLeaves();
+  [[nodiscard]] PageId AllocateLeafPage();
   void EnsureRootExists();
   [[nodiscard]] static LeafPage DecodeLeafPage(const Page& page);
   [[nodiscard]] Page EncodeLeafPage(const LeafPage& leaf) const;
-  [[nodiscard]] bool ShouldInline(const Record& record) const;
+  [[nodiscard]] bool ShouldInline(std::string_view key, const Record& record) const;
+  [[nodiscard]] static std::uint64_t StoredSize(const Record& record) noexcept;
+  // Excludes the entry's TTL, whose width depends on the other entries on its page.
   [[nodiscard]] static std::size_t EncodedEntrySize(const LeafEntry& entry);
   [[nodiscard]] Record Materialize(const LeafEntry& entry) const;
 };
@@ -0,0 +1,124 @@
+#include "storage/btree/value_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <map>
+#include <utility>
+
+namespace jubilant::storage::btree {
+
+void ValueSizeStats::RecordWrite(std::string_view key, std::uint64_t size) {
+  EntryFor(key).writes[BucketFor(size)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ValueSizeStats::RecordRead(std::string_view key, std::uint64_t size) {
+  EntryFor(key).reads[BucketFor(size)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<ValueSizeStats::PrefixReport>
+ValueSizeStats::Report(std::uint32_t max_threshold) const {
+  // Counts keep moving while they are read, so a report is a close snapshot rather than an exact
+  // one, which is all a tuning hint needs.
+  std::map<std::string, Histogram, std::less<>> merged;
+  for (const auto& slot : slots_) {
+    const auto* entry = slot.load(std::memory_order_acquire);
+    if (entry == nullptr) {
+      continue;
+    }
+    auto& target = merged[entry->prefix];
+    for (std::size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+      target.writes[bucket] = entry->writes[bucket].load(std::memory_order_relaxed);
+      target.reads[bucket] = entry->reads[bucket].load(std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<PrefixReport> reports;
+  reports.reserve(merged.size());
+  const auto floor = std::min(kMinRecommendedThreshold, max_threshold);
+  for (auto& [prefix, histogram] : merged) {
+    PrefixReport report{};
+    report.prefix = prefix;
+    report.histogram = histogram;
+    std::uint64_t recommended = floor;
+    for (std::size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+      const auto writes = report.histogram.writes[bucket];
+      const auto reads = report.histogram.reads[bucket];
+      report.writes += writes;
+      report.reads += reads;
+      const auto hot =
+          static_cast<double>(reads) >= kHotReadsPerWrite * static_cast<double>(writes);
+      if (reads > 0 && hot) {
+        recommended = std::max<std::uint64_t>(recommended, std::uint64_t{1} << bucket);
+      }
+    }
+    report.recommended_threshold =
+        static_cast<std::uint32_t>(std::min<std::uint64_t>(recommended, max_threshold));
+    reports.push_back(std::move(report));
+  }
+  return reports;
+}
+
+std::string_view ValueSizeStats::PrefixOf(std::string_view key) noexcept {
+  const auto delimiter = key.find_first_of(":/");
+  if (delimiter == std::string_view::npos || delimiter + 1 > kMaxPrefixBytes) {
+    return {};
+  }
+  return key.substr(0, delimiter + 1);
+}
+
+std::size_t ValueSizeStats::BucketFor(std::uint64_t size) noexcept {
+  if (size <= 1) {
+    return 0;
+  }
+  return std::min<std::size_t>(std::bit_width(size - 1), kBucketCount - 1);
+}
+
+ValueSizeStats::Entry& ValueSizeStats::EntryFor(std::string_view key) {
+  auto prefix = PrefixOf(key);
+  if (auto* entry = FindEntry(prefix); entry != nullptr) {
+    return *entry;
+  }
+  if (full_.load(std::memory_order_acquire)) {
+    return *FindEntry({});
+  }
+
+  std::scoped_lock guard(insert_mutex_);
+  const bool folded = !prefix.empty() && tracked_prefixes_ >= kMaxPrefixes;
+  if (folded) {
+    prefix = {};
+  }
+  auto* entry = FindEntry(prefix);
+  if (entry == nullptr) {
+    entry = entries_.emplace_back(std::make_unique<Entry>()).get();
+    entry->prefix = std::string(prefix);
+    auto slot = SlotFor(prefix);
+    while (slots_[slot].load(std::memory_order_relaxed) != nullptr) {
+      slot = (slot + 1) % kSlotCount;
+    }
+    // Release pairs with FindEntry's acquire, so a reader that sees the slot sees the prefix too.
+    slots_[slot].store(entry, std::memory_order_release);
+    if (!prefix.empty()) {
+      ++tracked_prefixes_;
+    }
+  }
+  if (folded) {
+    full_.store(true, std::memory_order_release);
+  }
+  return *entry;
+}
+
+ValueSizeStats::Entry* ValueSizeStats::FindEntry(std::string_view prefix) const noexcept {
+  for (auto slot = SlotFor(prefix);; slot = (slot + 1) % kSlotCount) {
+    auto* entry = slots_[slot].load(std::memory_order_acquire);
+    if (entry == nullptr || entry->prefix == prefix) {
+      return entry;
+    }
+  }
+}
+
+std::size_t ValueSizeStats::SlotFor(std::string_view prefix) noexcept {
+  return std::hash<std::string_view>{}(prefix) % kSlotCount;
+}
+
+} // namespace jubilant::storage::btree
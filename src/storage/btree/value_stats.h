@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jubilant::storage::btree {
+
+// Value-size histograms per key prefix, split into writes and reads, for tuning the inline
+// threshold. A key's prefix is its text up to and including the first ':' or '/'; keys without one,
+// and prefixes seen after kMaxPrefixes distinct ones, are grouped under "". Sizes are the stored
+// ones, so a spilled value counts its value-log record length. Recording is lock-free once a
+// prefix has been seen: a lookup in a table that only ever gains entries, then a relaxed increment.
+class ValueSizeStats {
+public:
+  // Bucket 0 holds sizes 0 and 1; bucket i holds sizes in (2^(i-1), 2^i].
+  static constexpr std::size_t kBucketCount = 33;
+  static constexpr std::size_t kMaxPrefixBytes = 64;
+  static constexpr std::size_t kMaxPrefixes = 1024;
+  // A size bucket read at least this often per write counts as hot and should stay inline.
+  static constexpr double kHotReadsPerWrite = 1.0;
+  // Recommendations never go below this, so small values do not each become a value-log record.
+  static constexpr std::uint32_t kMinRecommendedThreshold = 128;
+
+  struct Histogram {
+    std::array<std::uint64_t, kBucketCount> writes{};
+    std::array<std::uint64_t, kBucketCount> reads{};
+  };
+
+  struct PrefixReport {
+    std::string prefix;
+    Histogram histogram;
+    std::uint64_t writes{0};
+    std::uint64_t reads{0};
+    // Upper edge of the largest hot bucket, clamped to [kMinRecommendedThreshold, max_threshold].
+    std::uint32_t recommended_threshold{0};
+  };
+
+  void RecordWrite(std::string_view key, std::uint64_t size);
+  void RecordRead(std::string_view key, std::uint64_t size);
+  // Sorted by prefix.
+  [[nodiscard]] std::vector<PrefixReport> Report(std::uint32_t max_threshold) const;
+
+  [[nodiscard]] static std::string_view PrefixOf(std::string_view key) noexcept;
+  [[nodiscard]] static std::size_t BucketFor(std::uint64_t size) noexcept;
+
+private:
+  struct Entry {
+    std::string prefix;
+    std::array<std::atomic<std::uint64_t>, kBucketCount> writes{};
+    std::array<std::atomic<std::uint64_t>, kBucketCount> reads{};
+  };
+  // Open addressing with linear probing. Slots are filled once and never cleared, so a lookup can
+  // probe without a lock. At least twice the entries there can ever be (every tracked prefix and
+  // ""), which keeps probes short and guarantees an empty slot ends each one.
+  static constexpr std::size_t kSlotCount = 4096;
+  static_assert(kSlotCount >= 2 * (kMaxPrefixes + 1));
+
+  [[nodiscard]] Entry& EntryFor(std::string_view key);
+  [[nodiscard]] Entry* FindEntry(std::string_view prefix) const noexcept;
+  [[nodiscard]] static std::size_t SlotFor(std::string_view prefix) noexcept;
+
+  std::array<std::atomic<Entry*>, kSlotCount> slots_{};
+  // Set once a prefix has been folded into "", which exists from then on. Later unseen prefixes
+  // fold without taking insert_mutex_.
+  std::atomic<bool> full_{false};
+  // Serializes inserts; lookups never take it.
+  std::mutex insert_mutex_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::size_t tracked_prefixes_{0};
+};
+
+} // namespace jubilant::storage::btree
@@ -1,27 +1,152 @@
 #include "storage/checkpoint/checkpointer.h"
 
+#include <algorithm>
+#include <exception>
+#include <utility>
+
 namespace jubilant::storage::checkpoint {
 
+double CheckpointSnapshot::FlushBytesPerSecond() const noexcept {
+  const double seconds = std::chrono::duration<double>(duration).count();
+  return seconds > 0.0 ? static_cast<double>(bytes_flushed) / seconds : 0.0;
+}
+
+Checkpointer::~Checkpointer() {
+  Stop();
+}
+
 void Checkpointer::RequestCheckpoint(Lsn target_lsn) {
-  target_lsn_ = target_lsn;
+  {
+    std::scoped_lock guard(mutex_);
+    target_lsn_ = std::max(target_lsn_.value_or(0), target_lsn);
+  }
+  wake_cv_.notify_all();
 }
 
 std::optional<CheckpointSnapshot> Checkpointer::RunOnce(const FlushCallback& flush) {
-  if (!target_lsn_.has_value()) {
+  std::optional<Lsn> target;
+  {
+    std::scoped_lock guard(mutex_);
+    target = std::exchange(target_lsn_, std::nullopt);
+  }
+  if (!target.has_value()) {
     return std::nullopt;
   }
 
-  // Actual page flushing will use the provided callback to respect the WAL
-  // durability ordering. For now we report a no-op snapshot to unblock higher
-  // level scheduling and observability wiring.
-  flush(*target_lsn_);
-
   CheckpointSnapshot snapshot{};
-  snapshot.lsn = *target_lsn_;
-  snapshot.pages_flushed = 0;
+  snapshot.lsn = *target;
+  const auto started = std::chrono::steady_clock::now();
+  FlushResult result{};
+  try {
+    result = flush(*target);
+  } catch (...) {
+    std::scoped_lock guard(mutex_);
+    ++stats_.failures;
+    throw;
+  }
+  snapshot.pages_flushed = result.pages;
+  snapshot.bytes_flushed = result.bytes;
+  snapshot.throttled = result.throttled;
+  snapshot.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started);
 
-  target_lsn_.reset();
+  std::scoped_lock guard(mutex_);
+  ++stats_.checkpoints;
+  stats_.pages_flushed += snapshot.pages_flushed;
+  stats_.bytes_flushed += snapshot.bytes_flushed;
+  stats_.throttled += snapshot.throttled;
+  stats_.last = snapshot;
   return snapshot;
 }
 
+std::optional<CheckpointSnapshot> Checkpointer::Run(const BoundaryFn& boundary,
+                                                    const FlushCallback& flush) {
+  std::scoped_lock run_guard(run_mutex_);
+  if (const auto lsn = boundary(); lsn.has_value()) {
+    RequestCheckpoint(*lsn);
+  }
+  return RunOnce(flush);
+}
+
+void Checkpointer::Start(CheckpointTriggers triggers, BoundaryFn boundary, FlushCallback flush,
+                         WalBytesFn wal_bytes) {
+  std::scoped_lock guard(mutex_);
+  if (running_) {
+    return;
+  }
+  triggers_ = triggers;
+  boundary_ = std::move(boundary);
+  flush_ = std::move(flush);
+  wal_bytes_ = std::move(wal_bytes);
+  running_ = true;
+  stop_ = false;
+  thread_ = std::thread([this]() { Loop(); });
+}
+
+void Checkpointer::Stop() {
+  {
+    std::scoped_lock guard(mutex_);
+    if (!running_) {
+      return;
+    }
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  std::scoped_lock guard(mutex_);
+  running_ = false;
+}
+
+IoBudget& Checkpointer::io_budget() noexcept {
+  return io_budget_;
+}
+
+CheckpointStats Checkpointer::stats() const {
+  std::scoped_lock guard(mutex_);
+  auto stats = stats_;
+  stats.budget_scale = io_budget_.scale();
+  return stats;
+}
+
+double Checkpointer::BudgetScaleFor(std::uint64_t wal_bytes,
+                                    std::uint64_t wal_trigger_bytes) noexcept {
+  if (wal_trigger_bytes == 0) {
+    return 1.0;
+  }
+  const double backlog = static_cast<double>(wal_bytes) / static_cast<double>(wal_trigger_bytes);
+  return std::clamp(backlog, 1.0, kMaxBudgetScale);
+}
+
+void Checkpointer::Loop() {
+  auto last_run = std::chrono::steady_clock::now();
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      wake_cv_.wait_for(lock, std::min(triggers_.interval, kWalPollInterval),
+                        [this]() { return stop_ || target_lsn_.has_value(); });
+      if (stop_) {
+        return;
+      }
+      const bool due = target_lsn_.has_value() ||
+                       std::chrono::steady_clock::now() - last_run >= triggers_.interval;
+      lock.unlock();
+      const auto wal_bytes = wal_bytes_();
+      if (!due && wal_bytes < triggers_.wal_bytes) {
+        continue;
+      }
+      io_budget_.SetScale(BudgetScaleFor(wal_bytes, triggers_.wal_bytes));
+    }
+
+    // A failed checkpoint leaves its pages dirty; the next trigger captures them again.
+    try {
+      (void)Run(boundary_, flush_);
+    } catch (const std::exception&) {
+    }
+    last_run = std::chrono::steady_clock::now();
+  }
+}
+
 } // namespace jubilant::storage::checkpoint
@@ -1,29 +1,119 @@
 #pragma once
 
+#include "storage/checkpoint/io_budget.h"
 #include "storage/storage_common.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <mutex>
 #include <optional>
+#include <thread>
 
 namespace jubilant::storage::checkpoint {
 
 struct CheckpointSnapshot {
   Lsn lsn{0};
   std::uint64_t pages_flushed{0};
+  std::uint64_t bytes_flushed{0};
+  // Wall time of the flush, including the part spent waiting on the I/O budget.
+  std::chrono::nanoseconds duration{0};
+  std::chrono::nanoseconds throttled{0};
+
+  [[nodiscard]] double FlushBytesPerSecond() const noexcept;
+};
+
+// What a flush callback wrote, and how long the I/O budget held it back.
+struct FlushResult {
+  std::uint64_t pages{0};
+  std::uint64_t bytes{0};
+  std::chrono::nanoseconds throttled{0};
+};
+
+// A checkpoint starts once interval has passed since the last one or the WAL has grown by
+// wal_bytes, whichever comes first.
+struct CheckpointTriggers {
+  std::chrono::milliseconds interval{1000};
+  std::uint64_t wal_bytes{64ULL * 1024ULL * 1024ULL};
+};
+
+struct CheckpointStats {
+  std::uint64_t checkpoints{0};
+  std::uint64_t failures{0};
+  std::uint64_t pages_flushed{0};
+  std::uint64_t bytes_flushed{0};
+  std::chrono::nanoseconds throttled{0};
+  // Multiplier currently applied to the I/O budget; above 1 while checkpoints trail the WAL.
+  double budget_scale{1.0};
+  // How far the last completed checkpoint trails the log. Filled in by the owner of the WAL.
+  std::uint64_t lag_lsns{0};
+  std::uint64_t lag_wal_bytes{0};
+  std::optional<CheckpointSnapshot> last;
 };
 
 class Checkpointer {
 public:
-  using FlushCallback = std::function<void(Lsn)>;
+  // Writes the pages captured for the checkpoint at lsn, pacing them through io_budget(). Throws
+  // when the checkpoint cannot complete; it is then retried from a fresh boundary.
+  using FlushCallback = std::function<FlushResult(Lsn)>;
+  // Fixes the checkpoint boundary: captures the dirty pages and returns the LSN they reflect, or
+  // nullopt when nothing changed since the last checkpoint.
+  using BoundaryFn = std::function<std::optional<Lsn>()>;
+  // WAL bytes written since the last checkpoint.
+  using WalBytesFn = std::function<std::uint64_t()>;
 
   Checkpointer() = default;
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer&) = delete;
+  Checkpointer& operator=(const Checkpointer&) = delete;
+  Checkpointer(Checkpointer&&) = delete;
+  Checkpointer& operator=(Checkpointer&&) = delete;
 
+  // Also wakes the background thread, which then checkpoints without waiting for a trigger.
   void RequestCheckpoint(Lsn target_lsn);
   [[nodiscard]] std::optional<CheckpointSnapshot> RunOnce(const FlushCallback& flush);
 
+  // One full checkpoint on the caller's thread, serialized with the background thread.
+  std::optional<CheckpointSnapshot> Run(const BoundaryFn& boundary, const FlushCallback& flush);
+
+  void Start(CheckpointTriggers triggers, BoundaryFn boundary, FlushCallback flush,
+             WalBytesFn wal_bytes);
+  void Stop();
+
+  [[nodiscard]] IoBudget& io_budget() noexcept;
+  [[nodiscard]] CheckpointStats stats() const;
+
+  // Budget multiplier for a checkpoint that starts with wal_bytes of log behind it. Once the WAL
+  // outgrows the volume trigger, pages are being dirtied faster than the budget retires them, so
+  // the budget grows in proportion, up to kMaxBudgetScale.
+  [[nodiscard]] static double BudgetScaleFor(std::uint64_t wal_bytes,
+                                             std::uint64_t wal_trigger_bytes) noexcept;
+
+  static constexpr double kMaxBudgetScale = 4.0;
+
 private:
+  // How often the background thread samples WAL growth between interval deadlines.
+  static constexpr std::chrono::milliseconds kWalPollInterval{50};
+
+  void Loop();
+
+  std::mutex run_mutex_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_cv_;
   std::optional<Lsn> target_lsn_;
+  CheckpointStats stats_{};
+  IoBudget io_budget_;
+
+  CheckpointTriggers triggers_{};
+  BoundaryFn boundary_;
+  FlushCallback flush_;
+  WalBytesFn wal_bytes_;
+  bool running_{false};
+  bool stop_{false};
+  std::thread thread_;
 };
 
 } // namespace jubilant::storage::checkpoint
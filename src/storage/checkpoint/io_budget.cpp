@@ -0,0 +1,99 @@
+#include "storage/checkpoint/io_budget.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace jubilant::storage::checkpoint {
+
+namespace {
+
+constexpr double kBurstSeconds = std::chrono::duration<double>(IoBudget::kBurstWindow).count();
+
+double Refilled(double tokens, double rate, double elapsed_seconds) {
+  return std::min(rate * kBurstSeconds, tokens + (rate * elapsed_seconds));
+}
+
+} // namespace
+
+IoBudget::IoBudget(IoLimits limits) : limits_(limits) {}
+
+void IoBudget::SetLimits(IoLimits limits) {
+  std::scoped_lock guard(mutex_);
+  limits_ = limits;
+  primed_ = false;
+}
+
+void IoBudget::SetScale(double scale) {
+  std::scoped_lock guard(mutex_);
+  // Settle tokens earned at the old rate before the new one applies.
+  Refill(Clock::now());
+  scale_ = std::max(scale, 1.0);
+}
+
+std::chrono::nanoseconds IoBudget::Acquire(std::uint64_t bytes) {
+  const auto wait = Reserve(bytes, Clock::now());
+  if (wait > std::chrono::nanoseconds::zero()) {
+    std::this_thread::sleep_for(wait);
+  }
+  return wait;
+}
+
+std::chrono::nanoseconds IoBudget::Reserve(std::uint64_t bytes, Clock::time_point now) {
+  std::scoped_lock guard(mutex_);
+  Refill(now);
+
+  double wait_seconds = 0.0;
+  if (limits_.bytes_per_second != 0) {
+    byte_tokens_ -= static_cast<double>(bytes);
+    if (byte_tokens_ < 0.0) {
+      const double rate = static_cast<double>(limits_.bytes_per_second) * scale_;
+      wait_seconds = std::max(wait_seconds, -byte_tokens_ / rate);
+    }
+  }
+  if (limits_.iops != 0) {
+    op_tokens_ -= 1.0;
+    if (op_tokens_ < 0.0) {
+      const double rate = static_cast<double>(limits_.iops) * scale_;
+      wait_seconds = std::max(wait_seconds, -op_tokens_ / rate);
+    }
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(wait_seconds));
+}
+
+IoLimits IoBudget::limits() const {
+  std::scoped_lock guard(mutex_);
+  return limits_;
+}
+
+double IoBudget::scale() const {
+  std::scoped_lock guard(mutex_);
+  return scale_;
+}
+
+bool IoBudget::unlimited() const {
+  std::scoped_lock guard(mutex_);
+  return limits_.bytes_per_second == 0 && limits_.iops == 0;
+}
+
+void IoBudget::Refill(Clock::time_point now) {
+  const double byte_rate = static_cast<double>(limits_.bytes_per_second) * scale_;
+  const double op_rate = static_cast<double>(limits_.iops) * scale_;
+  if (!primed_) {
+    // Start with a full burst so a first small checkpoint is not delayed at all.
+    byte_tokens_ = byte_rate * kBurstSeconds;
+    op_tokens_ = op_rate * kBurstSeconds;
+    last_refill_ = now;
+    primed_ = true;
+    return;
+  }
+  if (now <= last_refill_) {
+    return;
+  }
+  const double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+  byte_tokens_ = Refilled(byte_tokens_, byte_rate, elapsed);
+  op_tokens_ = Refilled(op_tokens_, op_rate, elapsed);
+  last_refill_ = now;
+}
+
+} // namespace jubilant::storage::checkpoint
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace jubilant::storage::checkpoint {
+
+// Ceilings on checkpoint page writes. Zero leaves that dimension unlimited.
+struct IoLimits {
+  std::uint64_t bytes_per_second{0};
+  std::uint32_t iops{0};
+};
+
+// Token bucket pacing checkpoint writes so a large flush does not starve foreground reads of
+// device bandwidth. Each write takes one op token and its size in byte tokens. Either bucket may
+// go negative; the writer then sleeps until the deficit refills, which keeps the long-run rate at
+// the limit while letting a single write larger than the burst still go through.
+class IoBudget {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // How much unused budget may accumulate. Kept short so an idle period cannot turn into a burst
+  // long enough to show up in read latency.
+  static constexpr std::chrono::milliseconds kBurstWindow{100};
+
+  explicit IoBudget(IoLimits limits = {});
+
+  void SetLimits(IoLimits limits);
+  // Multiplies both rates. The checkpointer raises it above 1 while the WAL grows faster than
+  // checkpoints retire it, so a throttled flush cannot fall behind indefinitely.
+  void SetScale(double scale);
+
+  // Blocks until a write of bytes fits the budget and returns how long it waited.
+  std::chrono::nanoseconds Acquire(std::uint64_t bytes);
+  // Charges a write of bytes at now and returns how long the caller must wait before issuing it.
+  [[nodiscard]] std::chrono::nanoseconds Reserve(std::uint64_t bytes, Clock::time_point now);
+
+  [[nodiscard]] IoLimits limits() const;
+  [[nodiscard]] double scale() const;
+  [[nodiscard]] bool unlimited() const;
+
+private:
+  void Refill(Clock::time_point now);
+
+  mutable std::mutex mutex_;
+  IoLimits limits_{};
+  double scale_{1.0};
+  double byte_tokens_{0.0};
+  double op_tokens_{0.0};
+  Clock::time_point last_refill_{};
+  bool primed_{false};
+};
+
+} // namespace jubilant::storage::checkpoint
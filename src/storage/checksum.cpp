@@ -30,8 +30,12 @@ constexpr std::array<std::uint32_t, 256> kCrcTable = BuildTable();
 } // namespace
 
 std::uint32_t ComputeCrc32(std::span<const std::byte> data) {
-  std::uint32_t crc = kCrc32Seed;
+  return ExtendCrc32(0, data);
+}
 
+std::uint32_t ExtendCrc32(std::uint32_t crc, std::span<const std::byte> data) {
+  // Undo the previous final XOR; for crc == 0 this is exactly the seed.
+  crc ^= kCrc32FinalXor;
   for (const auto byte : data) {
     const auto index = static_cast<std::uint8_t>(byte) ^ (crc & 0xFFU);
     crc = (crc >> 8U) ^ kCrcTable[index];
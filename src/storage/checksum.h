@@ -10,4 +10,8 @@ namespace jubilant::storage {
 // validation.
 std::uint32_t ComputeCrc32(std::span<const std::byte> data);
 
+// Continues a checksum across pieces: folding every chunk of a buffer through ExtendCrc32, starting
+// from 0, yields ComputeCrc32 of the whole buffer.
+std::uint32_t ExtendCrc32(std::uint32_t crc, std::span<const std::byte> data);
+
 } // namespace jubilant::storage
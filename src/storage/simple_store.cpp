@@ -35,6 +35,7 @@ SimpleStore::SimpleStore(std::filesystem::path db_dir, meta::ManifestRecord mani
       tree_(btree::BTree::Config{.pager = &pager_,
                                  .value_log = &value_log_,
                                  .inline_threshold = manifest_.inline_threshold,
+                                 .inline_rules = manifest_.inline_rules,
                                  .root_hint = superblock_.root_page_id,
                                  .ttl_clock = ttl_clock_ ? &ttl_clock_.value() : nullptr}) {
   const auto calibration = ttl_clock_->calibration();
@@ -100,9 +101,17 @@ bool SimpleStore::Delete(const std::string& key) {
 }
 
 void SimpleStore::Sync() {
+  value_log_.Sync();
   pager_.Sync();
   manifest_store_.Persist(manifest_);
   superblock_store_.WriteNext(superblock_);
+  value_log_.ReleaseRetiredSegments();
+}
+
+vlog::GcReport SimpleStore::CollectValueLogGarbage(const vlog::GcOptions& options) {
+  auto report = tree_.CollectValueLogGarbage(options);
+  RefreshRoot();
+  return report;
 }
 
 std::uint64_t SimpleStore::size() const noexcept {
@@ -116,6 +125,7 @@ SimpleStore::Stats SimpleStore::stats() const {
   stats.superblock = superblock_store_.LoadActive().value_or(superblock_);
   stats.page_count = pager_.page_count();
   stats.key_count = tree_.size();
+  stats.value_log_segments = value_log_.usage();
   return stats;
 }
 
@@ -10,6 +10,7 @@
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace jubilant::storage {
 
@@ -21,8 +22,12 @@ public:
   void Set(const std::string& key, btree::Record record);
   bool Delete(const std::string& key);
 
+  // Checkpoints the tree and superblock, then deletes value-log segments retired by earlier GC
+  // passes now that the repointed leaves are the recovery baseline.
   void Sync();
 
+  [[nodiscard]] vlog::GcReport CollectValueLogGarbage(const vlog::GcOptions& options = {});
+
   [[nodiscard]] std::uint64_t size() const noexcept;
 
   struct Stats {
@@ -30,6 +35,7 @@ public:
     meta::SuperBlock superblock;
     std::uint64_t page_count{0};
     std::uint64_t key_count{0};
+    std::vector<vlog::SegmentUsage> value_log_segments;
   };
 
   [[nodiscard]] Stats stats() const;
@@ -2,9 +2,14 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <charconv>
 #include <iomanip>
+#include <limits>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace jubilant::storage {
 
@@ -41,6 +46,32 @@ struct SegmentPointer {
   std::uint64_t length{0};
 };
 
+// Per-key-prefix override of the manifest's inline threshold; the longest matching prefix wins.
+// Rules live in the manifest next to the global threshold, so WAL replay re-applies the same spill
+// decisions the original writes made.
+struct InlineRule {
+  std::string prefix;
+  std::uint32_t threshold{0};
+};
+
+// Every rule needs a non-empty prefix that no other rule repeats and a threshold that, like the
+// global one, lies within (0, payload_size).
+[[nodiscard]] inline bool InlineRulesValid(const std::vector<InlineRule>& rules,
+                                           std::size_t payload_size) {
+  for (std::size_t i = 0; i < rules.size(); ++i) {
+    if (rules[i].prefix.empty() || rules[i].threshold == 0 ||
+        rules[i].threshold >= payload_size) {
+      return false;
+    }
+    for (std::size_t j = 0; j < i; ++j) {
+      if (rules[j].prefix == rules[i].prefix) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 [[nodiscard]] inline std::string FormatSegmentSequence(SegmentId segment_id) {
   std::ostringstream stream;
   stream << std::setfill('0') << std::setw(6) << (segment_id + 1);
@@ -55,6 +86,33 @@ struct SegmentPointer {
   return "vlog-" + FormatSegmentSequence(segment_id) + ".seg";
 }
 
+// Inverse of FormatSegmentSequence between prefix and suffix; nullopt for any other file name.
+[[nodiscard]] inline std::optional<SegmentId>
+ParseSegmentName(std::string_view name, std::string_view prefix, std::string_view suffix) {
+  if (name.size() <= prefix.size() + suffix.size() || !name.starts_with(prefix) ||
+      !name.ends_with(suffix)) {
+    return std::nullopt;
+  }
+  const auto digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+  std::uint64_t sequence = 0;
+  const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), sequence);
+  if (error != std::errc{} || end != digits.data() + digits.size() || sequence == 0 ||
+      sequence - 1 > std::numeric_limits<SegmentId>::max()) {
+    return std::nullopt;
+  }
+  return static_cast<SegmentId>(sequence - 1);
+}
+
+// Inverse of WalSegmentName; nullopt for any other file name.
+[[nodiscard]] inline std::optional<SegmentId> ParseWalSegmentName(std::string_view name) {
+  return ParseSegmentName(name, "wal-", ".log");
+}
+
+// Inverse of ValueLogSegmentName; nullopt for any other file name.
+[[nodiscard]] inline std::optional<SegmentId> ParseValueLogSegmentName(std::string_view name) {
+  return ParseSegmentName(name, "vlog-", ".seg");
+}
+
 [[nodiscard]] inline std::filesystem::path WalSegmentPath(const std::filesystem::path& base_dir,
                                                           SegmentId segment_id) {
   return base_dir / WalSegmentName(segment_id);
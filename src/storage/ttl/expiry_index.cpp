@@ -0,0 +1,48 @@
+#include "storage/ttl/expiry_index.h"
+
+namespace jubilant::storage::ttl {
+
+void ExpiryIndex::Update(const std::string& key, std::uint64_t previous_ttl, std::uint64_t ttl) {
+  if (previous_ttl == ttl) {
+    return;
+  }
+  Remove(key, previous_ttl);
+  if (ttl != 0) {
+    entries_.emplace(ttl, key);
+  }
+}
+
+void ExpiryIndex::Remove(const std::string& key, std::uint64_t ttl) {
+  if (ttl == 0) {
+    return;
+  }
+  if (const auto iter = entries_.find(std::pair{ttl, key}); iter != entries_.end()) {
+    entries_.erase(iter);
+  }
+}
+
+void ExpiryIndex::Clear() noexcept {
+  entries_.clear();
+}
+
+std::vector<std::string> ExpiryIndex::Due(std::uint64_t now_seconds, std::size_t limit) const {
+  std::vector<std::string> due;
+  for (auto iter = entries_.begin();
+       iter != entries_.end() && iter->first <= now_seconds && due.size() < limit; ++iter) {
+    due.push_back(iter->second);
+  }
+  return due;
+}
+
+std::optional<std::uint64_t> ExpiryIndex::next_expiry() const {
+  if (entries_.empty()) {
+    return std::nullopt;
+  }
+  return entries_.begin()->first;
+}
+
+std::size_t ExpiryIndex::size() const noexcept {
+  return entries_.size();
+}
+
+} // namespace jubilant::storage::ttl
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jubilant::storage::ttl {
+
+// Keys that carry a TTL, ordered by expiry so the soonest ones can be found without visiting the
+// rest. Keys without a TTL (ttl_epoch_seconds == 0) are never tracked.
+class ExpiryIndex {
+public:
+  // Moves key from previous_ttl to ttl; either may be 0.
+  void Update(const std::string& key, std::uint64_t previous_ttl, std::uint64_t ttl);
+  void Remove(const std::string& key, std::uint64_t ttl);
+  void Clear() noexcept;
+
+  // Up to limit keys whose expiry is at or before now_seconds, soonest first.
+  [[nodiscard]] std::vector<std::string> Due(std::uint64_t now_seconds, std::size_t limit) const;
+  [[nodiscard]] std::optional<std::uint64_t> next_expiry() const;
+  [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+  std::set<std::pair<std::uint64_t, std::string>> entries_;
+};
+
+} // namespace jubilant::storage::ttl
@@ -36,6 +36,18 @@ std::chrono::steady_clock::time_point MakeMonotonicBase(std::uint64_t nanos_sinc
   return std::chrono::steady_clock::time_point{std::chrono::nanoseconds{clamped}};
 }
 
+std::uint64_t EstimateWallSeconds(std::uint64_t wall_base,
+                                  std::chrono::steady_clock::time_point monotonic_base) {
+  const auto mono_delta = std::chrono::steady_clock::now() - monotonic_base;
+  const auto wall_now = std::chrono::seconds{wall_base} +
+                        std::chrono::duration_cast<std::chrono::seconds>(mono_delta);
+  const auto wall_seconds = wall_now.count();
+  if (wall_seconds < 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(wall_seconds);
+}
+
 } // namespace
 
 Calibration TtlClock::CalibrateNow() {
@@ -49,29 +61,70 @@ Calibration TtlClock::CalibrateNow() {
 
 TtlClock::TtlClock(Calibration calibration)
     : calibration_(calibration),
-      monotonic_base_(MakeMonotonicBase(calibration.monotonic_time_nanos)) {}
+      monotonic_base_(MakeMonotonicBase(calibration.monotonic_time_nanos)),
+      ticker_(std::make_unique<Ticker>()) {}
 
 Calibration TtlClock::calibration() const noexcept {
   return calibration_;
 }
 
 std::uint64_t TtlClock::WallNowSeconds() const noexcept {
-  const auto mono_now = std::chrono::steady_clock::now();
-  const auto mono_delta = mono_now - monotonic_base_;
-  const auto wall_now = std::chrono::seconds{calibration_.wall_clock_unix_seconds} +
-                        std::chrono::duration_cast<std::chrono::seconds>(mono_delta);
-  const auto wall_seconds = wall_now.count();
-  if (wall_seconds < 0) {
-    return 0;
-  }
-  return static_cast<std::uint64_t>(wall_seconds);
+  return EstimateWallSeconds(calibration_.wall_clock_unix_seconds, monotonic_base_);
+}
+
+std::uint64_t TtlClock::NowSeconds() const noexcept {
+  const auto published = ticker_->now_seconds.load(std::memory_order_relaxed);
+  return published != 0 ? published : WallNowSeconds();
 }
 
 bool TtlClock::IsExpired(std::uint64_t ttl_epoch_seconds) const noexcept {
   if (ttl_epoch_seconds == 0) {
     return false;
   }
-  return ttl_epoch_seconds <= WallNowSeconds();
+  return IsExpiredAt(ttl_epoch_seconds, NowSeconds());
+}
+
+void TtlClock::StartTicker() {
+  std::scoped_lock guard(ticker_->mutex);
+  if (ticker_->thread.joinable()) {
+    return;
+  }
+  ticker_->stop = false;
+  // Publish before returning so the first reads already skip the clock.
+  ticker_->now_seconds.store(std::max<std::uint64_t>(WallNowSeconds(), 1),
+                             std::memory_order_relaxed);
+  // Captures copies rather than this, which may move while the thread runs.
+  ticker_->thread = std::thread([ticker = ticker_.get(),
+                                 wall_base = calibration_.wall_clock_unix_seconds,
+                                 monotonic_base = monotonic_base_]() {
+    std::unique_lock lock(ticker->mutex);
+    while (!ticker->wake_cv.wait_for(lock, kTickInterval, [ticker]() { return ticker->stop; })) {
+      ticker->now_seconds.store(
+          std::max<std::uint64_t>(EstimateWallSeconds(wall_base, monotonic_base), 1),
+          std::memory_order_relaxed);
+    }
+  });
+}
+
+void TtlClock::StopTicker() {
+  ticker_->Stop();
+}
+
+TtlClock::Ticker::~Ticker() {
+  Stop();
+}
+
+void TtlClock::Ticker::Stop() {
+  {
+    std::scoped_lock guard(mutex);
+    if (!thread.joinable()) {
+      return;
+    }
+    stop = true;
+  }
+  wake_cv.notify_all();
+  thread.join();
+  now_seconds.store(0, std::memory_order_relaxed);
 }
 
 } // namespace jubilant::storage::ttl
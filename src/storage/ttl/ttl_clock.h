@@ -1,7 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace jubilant::storage::ttl {
 
@@ -12,17 +17,47 @@ struct Calibration {
 
 class TtlClock {
 public:
+  // How often a running ticker republishes NowSeconds(). Expiry is observed at most this late.
+  static constexpr std::chrono::milliseconds kTickInterval{100};
+
   static Calibration CalibrateNow();
 
   explicit TtlClock(Calibration calibration);
 
   [[nodiscard]] Calibration calibration() const noexcept;
+  // Reads the monotonic clock. Prefer NowSeconds() on hot paths.
   [[nodiscard]] std::uint64_t WallNowSeconds() const noexcept;
+  // The ticker's last published WallNowSeconds(), a single relaxed load; falls back to reading
+  // the clock while no ticker runs.
+  [[nodiscard]] std::uint64_t NowSeconds() const noexcept;
   [[nodiscard]] bool IsExpired(std::uint64_t ttl_epoch_seconds) const noexcept;
+  // For scans: read NowSeconds() once and judge every record against it.
+  [[nodiscard]] static constexpr bool IsExpiredAt(std::uint64_t ttl_epoch_seconds,
+                                                  std::uint64_t now_seconds) noexcept {
+    return ttl_epoch_seconds != 0 && ttl_epoch_seconds <= now_seconds;
+  }
+
+  // Runs a thread that publishes the clock every kTickInterval, so readers skip the clock call.
+  void StartTicker();
+  void StopTicker();
 
 private:
+  struct Ticker {
+    // Zero while no ticker runs; no real wall-clock estimate is ever zero.
+    std::atomic<std::uint64_t> now_seconds{0};
+    std::mutex mutex;
+    std::condition_variable wake_cv;
+    bool stop{false};
+    std::thread thread;
+
+    ~Ticker();
+    void Stop();
+  };
+
   Calibration calibration_{};
   std::chrono::steady_clock::time_point monotonic_base_;
+  // Behind a pointer so the clock stays movable and the thread's target never moves.
+  std::unique_ptr<Ticker> ticker_;
 };
 
 } // namespace jubilant::storage::ttl
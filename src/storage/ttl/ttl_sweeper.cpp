@@ -0,0 +1,116 @@
+#include "storage/ttl/ttl_sweeper.h"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace jubilant::storage::ttl {
+
+TtlSweeper::~TtlSweeper() {
+  Stop();
+}
+
+std::uint64_t TtlSweeper::RunPass(const SweepOptions& options, const SweepBatchFn& sweep_batch) {
+  std::scoped_lock run_guard(run_mutex_);
+  const auto batch_size = std::max<std::size_t>(options.batch_size, 1);
+  const auto started = std::chrono::steady_clock::now();
+  std::uint64_t removed_total = 0;
+  bool failed = false;
+  while (true) {
+    const auto batch_started = std::chrono::steady_clock::now();
+    std::size_t removed = 0;
+    try {
+      removed = sweep_batch(batch_size);
+    } catch (const std::exception&) {
+      failed = true;
+      break;
+    }
+    removed_total += removed;
+    {
+      std::scoped_lock guard(mutex_);
+      ++stats_.batches;
+      stats_.records_expired += removed;
+    }
+    // A short batch means the index has nothing else due.
+    if (removed < batch_size || !Pace(options, removed, batch_started)) {
+      break;
+    }
+  }
+
+  std::scoped_lock guard(mutex_);
+  ++stats_.passes;
+  if (failed) {
+    ++stats_.failures;
+  }
+  stats_.last_pass_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started);
+  return removed_total;
+}
+
+bool TtlSweeper::Pace(const SweepOptions& options, std::size_t removed,
+                      std::chrono::steady_clock::time_point batch_started) {
+  std::unique_lock lock(mutex_);
+  if (options.max_per_second == 0) {
+    return !stop_;
+  }
+  const auto budget = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(static_cast<double>(removed) /
+                                    static_cast<double>(options.max_per_second)));
+  const auto resume_at = batch_started + budget;
+  const auto now = std::chrono::steady_clock::now();
+  if (resume_at > now) {
+    stats_.throttled += resume_at - now;
+    wake_cv_.wait_until(lock, resume_at, [this]() { return stop_; });
+  }
+  return !stop_;
+}
+
+void TtlSweeper::Start(SweepOptions options, SweepBatchFn sweep_batch) {
+  std::scoped_lock guard(mutex_);
+  if (running_) {
+    return;
+  }
+  options_ = options;
+  sweep_batch_ = std::move(sweep_batch);
+  running_ = true;
+  stop_ = false;
+  thread_ = std::thread([this]() { Loop(); });
+}
+
+void TtlSweeper::Stop() {
+  {
+    std::scoped_lock guard(mutex_);
+    if (!running_) {
+      return;
+    }
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  std::scoped_lock guard(mutex_);
+  running_ = false;
+  stop_ = false;
+}
+
+SweepStats TtlSweeper::stats() const {
+  std::scoped_lock guard(mutex_);
+  return stats_;
+}
+
+void TtlSweeper::Loop() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      wake_cv_.wait_for(lock, options_.interval, [this]() { return stop_; });
+      if (stop_) {
+        return;
+      }
+    }
+    (void)RunPass(options_, sweep_batch_);
+  }
+}
+
+} // namespace jubilant::storage::ttl
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace jubilant::storage::ttl {
+
+// A pass starts every interval and removes expired records batch_size at a time until a batch
+// comes back short. max_per_second caps the removal rate so a mass expiry cannot flood the WAL;
+// 0 leaves it unlimited.
+struct SweepOptions {
+  std::chrono::milliseconds interval{1000};
+  std::size_t batch_size{256};
+  std::uint64_t max_per_second{0};
+};
+
+struct SweepStats {
+  std::uint64_t passes{0};
+  std::uint64_t batches{0};
+  std::uint64_t records_expired{0};
+  std::uint64_t failures{0};
+  // Time spent waiting on max_per_second between batches.
+  std::chrono::nanoseconds throttled{0};
+  std::chrono::nanoseconds last_pass_duration{0};
+  // Records still carrying a TTL. Filled in by the owner of the tree.
+  std::uint64_t tracked{0};
+};
+
+// Background thread that reclaims expired records instead of leaving them in leaves and value-log
+// segments until overwritten. The callback does the removal, so the owner decides how tombstones
+// are logged and which locks they take.
+class TtlSweeper {
+public:
+  // Removes up to limit expired records as one logged batch and returns how many it removed.
+  // Throws when the batch cannot be logged; the pass then stops and retries at the next interval.
+  using SweepBatchFn = std::function<std::size_t(std::size_t limit)>;
+
+  TtlSweeper() = default;
+  ~TtlSweeper();
+
+  TtlSweeper(const TtlSweeper&) = delete;
+  TtlSweeper& operator=(const TtlSweeper&) = delete;
+  TtlSweeper(TtlSweeper&&) = delete;
+  TtlSweeper& operator=(TtlSweeper&&) = delete;
+
+  // One full pass on the caller's thread, serialized with the background thread. Returns how many
+  // records it removed.
+  std::uint64_t RunPass(const SweepOptions& options, const SweepBatchFn& sweep_batch);
+
+  void Start(SweepOptions options, SweepBatchFn sweep_batch);
+  void Stop();
+
+  [[nodiscard]] SweepStats stats() const;
+
+private:
+  void Loop();
+  // Sleeps until removed records fit max_per_second since batch_started; false once stopping.
+  bool Pace(const SweepOptions& options, std::size_t removed,
+            std::chrono::steady_clock::time_point batch_started);
+
+  std::mutex run_mutex_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  SweepStats stats_{};
+
+  SweepOptions options_{};
+  SweepBatchFn sweep_batch_;
+  bool running_{false};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+} // namespace jubilant::storage::ttl
@@ -0,0 +1,73 @@
+#include "storage/vlog/value_cache.h"
+
+namespace jubilant::storage::vlog {
+
+ValueCache::ValueCache(std::size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {}
+
+bool ValueCache::Lookup(const SegmentPointer& pointer, std::vector<std::byte>& out) {
+  std::shared_ptr<const std::vector<std::byte>> value;
+  {
+    std::scoped_lock guard(mutex_);
+    const auto iter = index_.find(Key{pointer.segment_id, pointer.offset});
+    if (iter == index_.end()) {
+      ++stats_.misses;
+      return false;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    value = iter->second->value;
+  }
+  // The copy runs outside the lock; the shared_ptr keeps the value alive if it is evicted.
+  out.assign(value->begin(), value->end());
+  return true;
+}
+
+void ValueCache::Insert(const SegmentPointer& pointer, const std::vector<std::byte>& value) {
+  if (value.size() > capacity_bytes_ / 8) {
+    return;
+  }
+  auto shared = std::make_shared<const std::vector<std::byte>>(value);
+
+  std::scoped_lock guard(mutex_);
+  const Key key{pointer.segment_id, pointer.offset};
+  if (index_.contains(key)) {
+    return;
+  }
+  lru_.push_front(Entry{.key = key, .value = std::move(shared)});
+  index_.emplace(key, lru_.begin());
+  stats_.bytes += value.size();
+  stats_.entries = index_.size();
+  EvictLocked();
+}
+
+void ValueCache::EraseSegment(SegmentId segment_id) {
+  std::scoped_lock guard(mutex_);
+  for (auto iter = lru_.begin(); iter != lru_.end();) {
+    if (iter->key.first != segment_id) {
+      ++iter;
+      continue;
+    }
+    stats_.bytes -= iter->value->size();
+    index_.erase(iter->key);
+    iter = lru_.erase(iter);
+  }
+  stats_.entries = index_.size();
+}
+
+ValueCache::Stats ValueCache::stats() const {
+  std::scoped_lock guard(mutex_);
+  return stats_;
+}
+
+void ValueCache::EvictLocked() {
+  while (stats_.bytes > capacity_bytes_ && !lru_.empty()) {
+    const auto& victim = lru_.back();
+    stats_.bytes -= victim.value->size();
+    index_.erase(victim.key);
+    lru_.pop_back();
+    ++stats_.evictions;
+  }
+  stats_.entries = index_.size();
+}
+
+} // namespace jubilant::storage::vlog
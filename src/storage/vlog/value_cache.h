@@ -0,0 +1,71 @@
+#pragma once
+
+#include "storage/storage_common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jubilant::storage::vlog {
+
+// Decoded value-log records, least recently used first out once the byte budget is exceeded.
+// Records never change once written, so entries only leave through eviction or when their segment
+// is deleted.
+class ValueCache {
+public:
+  struct Stats {
+    std::uint64_t hits{0};
+    std::uint64_t misses{0};
+    std::uint64_t evictions{0};
+    std::size_t entries{0};
+    std::size_t bytes{0};
+
+    [[nodiscard]] double hit_rate() const noexcept {
+      const auto lookups = hits + misses;
+      return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+  };
+
+  explicit ValueCache(std::size_t capacity_bytes);
+
+  // Copies a cached value into out; counts a hit or a miss.
+  [[nodiscard]] bool Lookup(const SegmentPointer& pointer, std::vector<std::byte>& out);
+  // Values larger than an eighth of the budget are not admitted, so one large read cannot flush
+  // every hot entry.
+  void Insert(const SegmentPointer& pointer, const std::vector<std::byte>& value);
+  void EraseSegment(SegmentId segment_id);
+
+  [[nodiscard]] std::size_t capacity_bytes() const noexcept { return capacity_bytes_; }
+  [[nodiscard]] Stats stats() const;
+
+private:
+  using Key = std::pair<SegmentId, std::uint64_t>;
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const noexcept {
+      return std::hash<std::uint64_t>{}(key.first * 0x9E3779B97F4A7C15ULL ^ key.second);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<const std::vector<std::byte>> value;
+  };
+
+  void EvictLocked();
+
+  std::size_t capacity_bytes_;
+  mutable std::mutex mutex_;
+  // Most recently used at the front.
+  std::list<Entry> lru_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+  Stats stats_{};
+};
+
+} // namespace jubilant::storage::vlog
@@ -3,102 +3,669 @@
 #include "storage/checksum.h"
 #include "storage/storage_common.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
-#include <fstream>
+#include <memory>
 #include <span>
 #include <stdexcept>
+#include <unistd.h>
+#include <utility>
+#include <zstd.h>
 
 namespace jubilant::storage::vlog {
 
 namespace {
 
+constexpr std::uint32_t kCodecShift = 30;
+constexpr std::uint32_t kStoredLengthMask = (1U << kCodecShift) - 1;
+// Below this a value is too small for compression to repay its CPU cost.
+constexpr std::size_t kMinCompressBytes = 1024;
+// Larger values compress a prefix of this size first, so an incompressible blob costs one small
+// compression attempt rather than a full one.
+constexpr std::size_t kCompressProbeBytes = 64ULL * 1024ULL;
+// zstd's fastest regular level; appends sit on the commit path.
+constexpr int kCompressionLevel = 1;
+
 struct RecordHeader {
+  // Stored payload length in the low 30 bits, Codec in the top two.
   std::uint32_t length{0};
   std::uint32_t crc{0};
+
+  [[nodiscard]] std::uint32_t stored_length() const noexcept { return length & kStoredLengthMask; }
+  [[nodiscard]] Codec codec() const noexcept { return static_cast<Codec>(length >> kCodecShift); }
 };
 
+std::span<const std::byte> HeaderBytes(const RecordHeader& header) {
+  return {reinterpret_cast<const std::byte*>(&header), sizeof(header)};
+}
+
+std::uint64_t RecordBytes(const SegmentPointer& pointer) {
+  return sizeof(RecordHeader) + pointer.length;
+}
+
+// Kept only when it saves at least an eighth; smaller gains do not pay for decompressing on read.
+bool WorthCompressing(std::size_t compressed, std::size_t original) {
+  return compressed <= original - (original / 8);
+}
+
+std::size_t CompressInto(std::vector<std::byte>& out, std::span<const std::byte> data) {
+  thread_local const std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context{
+      ZSTD_createCCtx(), &ZSTD_freeCCtx};
+  out.resize(ZSTD_compressBound(data.size()));
+  return ZSTD_compressCCtx(context.get(), out.data(), out.size(), data.data(), data.size(),
+                           kCompressionLevel);
+}
+
+// Returns the zstd frame for data when compression pays off, otherwise nullopt.
+std::optional<std::vector<std::byte>> TryCompress(std::span<const std::byte> data) {
+  if (data.size() < kMinCompressBytes) {
+    return std::nullopt;
+  }
+  std::vector<std::byte> compressed;
+  if (data.size() > kCompressProbeBytes) {
+    const auto probed = CompressInto(compressed, data.first(kCompressProbeBytes));
+    if (ZSTD_isError(probed) != 0U || !WorthCompressing(probed, kCompressProbeBytes)) {
+      return std::nullopt;
+    }
+  }
+  const auto size = CompressInto(compressed, data);
+  if (ZSTD_isError(size) != 0U || !WorthCompressing(size, data.size())) {
+    return std::nullopt;
+  }
+  compressed.resize(size);
+  return compressed;
+}
+
+void WriteFully(int file_descriptor, const std::byte* data, std::size_t size,
+                std::uint64_t offset) {
+  while (size > 0) {
+    const auto written = ::pwrite(file_descriptor, data, size, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Failed to append to value log segment");
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+    offset += static_cast<std::uint64_t>(written);
+  }
+}
+
+bool ReadFully(int file_descriptor, std::byte* data, std::size_t size, std::uint64_t offset) {
+  while (size > 0) {
+    const auto read = ::pread(file_descriptor, data, size, static_cast<off_t>(offset));
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      return false;
+    }
+    data += read;
+    size -= static_cast<std::size_t>(read);
+    offset += static_cast<std::uint64_t>(read);
+  }
+  return true;
+}
+
+// Checks a header-prefixed record against the pointer and its CRC and trims anything past it.
+bool CheckRecord(const SegmentPointer& pointer, std::vector<std::byte>& record) {
+  RecordHeader header{};
+  if (record.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, record.data(), sizeof(header));
+  const auto stored_length = header.stored_length();
+  if ((pointer.length != 0 && pointer.length != stored_length) ||
+      record.size() - sizeof(header) < stored_length) {
+    return false;
+  }
+  record.resize(sizeof(header) + stored_length);
+  return ComputeCrc32(std::span<const std::byte>(record).subspan(sizeof(header))) == header.crc;
+}
+
+// Expands a checked record's payload into out.
+bool ExpandRecord(std::span<const std::byte> record, std::vector<std::byte>& out) {
+  RecordHeader header{};
+  std::memcpy(&header, record.data(), sizeof(header));
+  const auto payload = record.subspan(sizeof(header));
+  switch (header.codec()) {
+  case Codec::kNone:
+    out.assign(payload.begin(), payload.end());
+    return true;
+  case Codec::kZstd: {
+    const auto size = ZSTD_getFrameContentSize(payload.data(), payload.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) {
+      return false;
+    }
+    out.resize(size);
+    const auto expanded = ZSTD_decompress(out.data(), out.size(), payload.data(), payload.size());
+    return ZSTD_isError(expanded) == 0U && expanded == size;
+  }
+  }
+  return false;
+}
+
 } // namespace
 
-ValueLog::ValueLog(std::filesystem::path base_dir) : base_dir_(std::move(base_dir)) {
+ValueLog::SegmentFile::~SegmentFile() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+ValueLog::ValueLog(std::filesystem::path base_dir, std::uint64_t segment_bytes,
+                   std::size_t cache_bytes)
+    : base_dir_(std::move(base_dir)), segment_bytes_(segment_bytes),
+      cache_(cache_bytes == 0 ? nullptr : std::make_unique<ValueCache>(cache_bytes)) {
+  if (segment_bytes_ == 0) {
+    throw std::invalid_argument("Value log segment size must be positive");
+  }
   std::filesystem::create_directories(base_dir_);
-  const auto segment_path = SegmentPath(0);
-  if (std::filesystem::exists(segment_path)) {
-    next_pointer_.segment_id = 0;
-    next_pointer_.offset = std::filesystem::file_size(segment_path);
+  // GC deletes whole segments, so the surviving ids may have gaps. Appends resume at the end of the
+  // highest one.
+  for (const auto& entry : std::filesystem::directory_iterator(base_dir_)) {
+    const auto segment_id = ParseValueLogSegmentName(entry.path().filename().string());
+    if (!segment_id.has_value() || !entry.is_regular_file()) {
+      continue;
+    }
+    segments_[*segment_id] = SegmentUsage{
+        .segment_id = *segment_id, .total_bytes = entry.file_size(), .live_bytes = 0};
+  }
+  if (!segments_.empty()) {
+    const auto& active = segments_.rbegin()->second;
+    next_pointer_.segment_id = active.segment_id;
+    next_pointer_.offset = active.total_bytes;
     next_pointer_.length = 0;
+    flushed_offset_ = active.total_bytes;
+  }
+}
+
+ValueLog::ValueLog(ValueLog&& other) noexcept
+    : base_dir_(std::move(other.base_dir_)), segment_bytes_(other.segment_bytes_),
+      next_pointer_(other.next_pointer_), flushed_offset_(other.flushed_offset_),
+      append_buffer_(std::move(other.append_buffer_)), open_files_(std::move(other.open_files_)),
+      segments_(std::move(other.segments_)), retired_(std::move(other.retired_)),
+      pending_(std::move(other.pending_)), cache_(std::move(other.cache_)) {
+  other.append_buffer_.clear();
+}
+
+ValueLog& ValueLog::operator=(ValueLog&& other) noexcept {
+  if (this != &other) {
+    base_dir_ = std::move(other.base_dir_);
+    segment_bytes_ = other.segment_bytes_;
+    next_pointer_ = other.next_pointer_;
+    flushed_offset_ = other.flushed_offset_;
+    append_buffer_ = std::move(other.append_buffer_);
+    other.append_buffer_.clear();
+    open_files_ = std::move(other.open_files_);
+    segments_ = std::move(other.segments_);
+    retired_ = std::move(other.retired_);
+    pending_ = std::move(other.pending_);
+    cache_ = std::move(other.cache_);
+  }
+  return *this;
+}
+
+ValueLog::~ValueLog() {
+  // Best effort: an unsynced tail was never promised durable, but a clean shutdown should not drop
+  // it either.
+  try {
+    std::scoped_lock guard(append_mutex_);
+    FlushBufferLocked();
+  } catch (const std::exception&) {
   }
 }
 
-AppendResult ValueLog::Append(const std::vector<std::byte>& data) {
-  const auto segment_path = SegmentPath(next_pointer_.segment_id);
-  std::ofstream out(segment_path, std::ios::binary | std::ios::app);
-  if (!out) {
-    throw std::runtime_error("Failed to open value log segment for append");
+AppendResult ValueLog::Append(std::span<const std::byte> data) {
+  return AppendEncoded(Encode(data));
+}
+
+EncodedRecord ValueLog::Encode(std::span<const std::byte> data) {
+  if (data.size() > kMaxRecordBytes) {
+    throw std::invalid_argument("Value log record too large");
+  }
+  EncodedRecord record{};
+  if (auto compressed = TryCompress(data); compressed.has_value()) {
+    record.codec = Codec::kZstd;
+    record.compressed = std::move(*compressed);
+    record.payload = record.compressed;
+  } else {
+    record.payload = data;
   }
+  record.crc = ComputeCrc32(record.payload);
+  return record;
+}
 
+AppendResult ValueLog::AppendEncoded(const EncodedRecord& record) {
   RecordHeader header{};
-  header.length = static_cast<std::uint32_t>(data.size());
-  header.crc = ComputeCrc32(std::span<const std::byte>(data.data(), data.size()));
+  header.length = static_cast<std::uint32_t>(record.payload.size()) |
+                  (static_cast<std::uint32_t>(record.codec) << kCodecShift);
+  header.crc = record.crc;
 
+  std::scoped_lock guard(append_mutex_);
   AppendResult result{};
-  result.pointer = next_pointer_;
-  result.pointer.length = data.size();
+  result.pointer = ReserveLocked(record.payload.size());
+  WriteRecordLocked(result.pointer, HeaderBytes(header), record.payload);
+  result.hold = HoldLocked(result.pointer.segment_id);
+  return result;
+}
 
-  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
-  out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
-  out.flush();
-  if (!out.good()) {
-    throw std::runtime_error("Failed to append to value log segment");
+ValueLog::AppendStream ValueLog::BeginAppend(std::uint64_t length) {
+  if (length > kMaxRecordBytes) {
+    throw std::invalid_argument("Value log record too large");
   }
+  std::scoped_lock guard(append_mutex_);
+  const auto pointer = ReserveLocked(length);
+  // The stream writes straight into its slot, so everything buffered in front of it goes out first
+  // and later buffered appends land behind it.
+  FlushBufferLocked();
+  flushed_offset_ += RecordBytes(pointer);
+  auto file = FileLocked(pointer.segment_id, true);
+  const int fd = file->fd;
+  return AppendStream(*this, std::move(file), HoldLocked(pointer.segment_id), fd, pointer);
+}
 
-  next_pointer_.offset += sizeof(header) + data.size();
-  next_pointer_.length = 0;
+ValueLog::AppendStream::AppendStream(ValueLog& owner, std::shared_ptr<const void> pin,
+                                     std::shared_ptr<const void> hold, int fd,
+                                     SegmentPointer pointer)
+    : owner_(&owner), pin_(std::move(pin)), hold_(std::move(hold)), fd_(fd), pointer_(pointer) {}
+
+void ValueLog::AppendStream::Write(std::span<const std::byte> chunk) {
+  if (chunk.size() > remaining()) {
+    throw std::invalid_argument("Value log stream exceeds its declared length");
+  }
+  WriteFully(fd_, chunk.data(), chunk.size(), pointer_.offset + sizeof(RecordHeader) + written_);
+  crc_ = ExtendCrc32(crc_, chunk);
+  written_ += chunk.size();
+}
+
+AppendResult ValueLog::AppendStream::Finish() {
+  if (owner_ == nullptr || remaining() != 0) {
+    throw std::logic_error("Value log stream finished before its declared length");
+  }
+  RecordHeader header{};
+  header.length = static_cast<std::uint32_t>(pointer_.length);
+  header.crc = crc_;
+  WriteFully(fd_, HeaderBytes(header).data(), sizeof(header), pointer_.offset);
+
+  // Sync() only covers the active segment. One sealed while the stream was open was synced before
+  // this record was complete, so the record is synced here instead.
+  bool sealed = false;
+  {
+    std::scoped_lock guard(owner_->append_mutex_);
+    sealed = pointer_.segment_id != owner_->next_pointer_.segment_id;
+  }
+  if (sealed && ::fdatasync(fd_) != 0) {
+    throw std::runtime_error("Failed to sync value log segment");
+  }
+
+  AppendResult result{};
+  result.pointer = pointer_;
+  result.hold = std::move(hold_);
+  owner_ = nullptr;
+  pin_.reset();
   return result;
 }
 
 std::optional<std::vector<std::byte>> ValueLog::Read(const SegmentPointer& pointer) const {
-  const auto segment_path = SegmentPath(pointer.segment_id);
-  if (!std::filesystem::exists(segment_path)) {
+  std::vector<std::byte> value;
+  if (!ReadInto(pointer, value)) {
     return std::nullopt;
   }
+  return value;
+}
 
-  std::ifstream input_stream(segment_path, std::ios::binary);
-  if (!input_stream) {
-    return std::nullopt;
+bool ValueLog::ReadInto(const SegmentPointer& pointer, std::vector<std::byte>& out) const {
+  if (cache_ && cache_->Lookup(pointer, out)) {
+    return true;
+  }
+  // Encoded records are staged in a per-thread buffer so steady-state reads do not allocate.
+  thread_local std::vector<std::byte> record;
+  if (!ReadRecord(pointer, record) || !ExpandRecord(record, out)) {
+    return false;
   }
+  if (cache_) {
+    cache_->Insert(pointer, out);
+  }
+  return true;
+}
 
-  input_stream.seekg(static_cast<std::streamoff>(pointer.offset));
-  if (!input_stream.good()) {
+ValueCache::Stats ValueLog::cache_stats() const {
+  return cache_ ? cache_->stats() : ValueCache::Stats{};
+}
+
+std::optional<PinnedRecord> ValueLog::Pin(const SegmentPointer& pointer) {
+  std::shared_ptr<SegmentFile> file;
+  {
+    std::scoped_lock guard(append_mutex_);
+    if (pointer.segment_id == next_pointer_.segment_id && pointer.offset >= flushed_offset_) {
+      FlushBufferLocked();
+    }
+    file = FileLocked(pointer.segment_id, false);
+  }
+  if (!file) {
     return std::nullopt;
   }
 
   RecordHeader header{};
-  input_stream.read(reinterpret_cast<char*>(&header), sizeof(header));
-  if (!input_stream.good()) {
+  if (!ReadFully(file->fd, reinterpret_cast<std::byte*>(&header), sizeof(header),
+                 pointer.offset) ||
+      (pointer.length != 0 && pointer.length != header.stored_length())) {
     return std::nullopt;
   }
+  PinnedRecord pinned{};
+  pinned.fd = file->fd;
+  pinned.offset = pointer.offset + sizeof(header);
+  pinned.length = header.stored_length();
+  pinned.crc = header.crc;
+  pinned.codec = header.codec();
+  pinned.pin = std::move(file);
+  return pinned;
+}
 
-  std::vector<std::byte> data(header.length);
-  if (pointer.length != 0 && pointer.length != header.length) {
-    return std::nullopt;
+void ValueLog::Sync() {
+  std::shared_ptr<SegmentFile> file;
+  {
+    std::scoped_lock guard(append_mutex_);
+    if (next_pointer_.offset == 0) {
+      return;
+    }
+    FlushBufferLocked();
+    file = FileLocked(next_pointer_.segment_id, true);
   }
-  input_stream.read(reinterpret_cast<char*>(data.data()),
-                    static_cast<std::streamsize>(header.length));
-  if (!input_stream.good()) {
-    return std::nullopt;
+  // Appends continue into the page cache while the sync runs; they are covered by the next one.
+  if (::fdatasync(file->fd) != 0) {
+    throw std::runtime_error("Failed to sync value log segment");
   }
+}
 
-  const auto crc = ComputeCrc32(std::span<const std::byte>(data.data(), data.size()));
-  if (crc != header.crc) {
-    return std::nullopt;
+void ValueLog::MarkLive(const SegmentPointer& pointer) {
+  std::scoped_lock guard(append_mutex_);
+  auto& usage = segments_[pointer.segment_id];
+  usage.segment_id = pointer.segment_id;
+  usage.live_bytes += RecordBytes(pointer);
+}
+
+void ValueLog::MarkDead(const SegmentPointer& pointer) {
+  std::scoped_lock guard(append_mutex_);
+  const auto iter = segments_.find(pointer.segment_id);
+  if (iter == segments_.end()) {
+    return;
+  }
+  iter->second.live_bytes -= std::min(iter->second.live_bytes, RecordBytes(pointer));
+}
+
+std::vector<SegmentUsage> ValueLog::usage() const {
+  std::scoped_lock guard(append_mutex_);
+  std::vector<SegmentUsage> result;
+  result.reserve(segments_.size());
+  for (const auto& [segment_id, usage] : segments_) {
+    result.push_back(usage);
+  }
+  return result;
+}
+
+std::vector<SegmentId> ValueLog::SelectGcVictims(const GcOptions& options) {
+  std::scoped_lock guard(append_mutex_);
+  std::vector<SegmentUsage> candidates;
+  for (const auto& [segment_id, usage] : segments_) {
+    if (usage.total_bytes == 0 || usage.live_ratio() > options.max_live_ratio ||
+        std::find(retired_.begin(), retired_.end(), segment_id) != retired_.end() ||
+        HeldLocked(segment_id)) {
+      continue;
+    }
+    candidates.push_back(usage);
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.live_ratio() < rhs.live_ratio();
+  });
+  if (candidates.size() > options.max_segments) {
+    candidates.resize(options.max_segments);
   }
 
-  return data;
+  std::vector<SegmentId> victims;
+  victims.reserve(candidates.size());
+  for (const auto& candidate : candidates) {
+    victims.push_back(candidate.segment_id);
+    if (candidate.segment_id == next_pointer_.segment_id) {
+      SealActiveLocked();
+    }
+  }
+  return victims;
+}
+
+AppendResult ValueLog::Relocate(const SegmentPointer& pointer) {
+  std::vector<std::byte> record;
+  if (!ReadRecord(pointer, record)) {
+    throw std::runtime_error("Failed to read live value log record for relocation");
+  }
+  const auto bytes = std::span<const std::byte>(record);
+  AppendResult appended{};
+  {
+    std::scoped_lock guard(append_mutex_);
+    appended.pointer = ReserveLocked(record.size() - sizeof(RecordHeader));
+    WriteRecordLocked(appended.pointer, bytes.first(sizeof(RecordHeader)),
+                      bytes.subspan(sizeof(RecordHeader)));
+  }
+  return appended;
+}
+
+void ValueLog::RetireSegments(std::span<const SegmentId> segment_ids) {
+  std::scoped_lock guard(append_mutex_);
+  for (const auto segment_id : segment_ids) {
+    if (std::find(retired_.begin(), retired_.end(), segment_id) == retired_.end()) {
+      retired_.push_back(segment_id);
+    }
+  }
+}
+
+std::vector<SegmentId> ValueLog::retired_segments() const {
+  std::scoped_lock guard(append_mutex_);
+  return retired_;
+}
+
+std::size_t ValueLog::ReleaseRetiredSegments() {
+  return ReleaseRetiredSegments(retired_segments());
+}
+
+std::size_t ValueLog::ReleaseRetiredSegments(std::span<const SegmentId> segment_ids) {
+  std::scoped_lock guard(append_mutex_);
+  std::size_t released = 0;
+  for (const auto segment_id : segment_ids) {
+    const auto retired = std::find(retired_.begin(), retired_.end(), segment_id);
+    if (retired == retired_.end() || HeldLocked(segment_id)) {
+      continue;
+    }
+    retired_.erase(retired);
+    const auto iter = segments_.find(segment_id);
+    // A segment that gained a reference since its GC pass, however it got one, is live again and
+    // simply stays.
+    if (iter != segments_.end() && iter->second.live_bytes != 0) {
+      continue;
+    }
+    open_files_.erase(segment_id);
+    if (cache_) {
+      cache_->EraseSegment(segment_id);
+    }
+    std::error_code error;
+    std::filesystem::remove(SegmentPath(segment_id), error);
+    if (error) {
+      throw std::runtime_error("Failed to delete retired value log segment");
+    }
+    segments_.erase(segment_id);
+    ++released;
+  }
+  return released;
+}
+
+std::shared_ptr<ValueLog::SegmentFile> ValueLog::FileLocked(SegmentId segment_id,
+                                                            bool create) const {
+  if (const auto iter = open_files_.find(segment_id); iter != open_files_.end()) {
+    return iter->second;
+  }
+
+  const auto segment_path = SegmentPath(segment_id);
+  const int flags = O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0);
+  const int file_descriptor = ::open(segment_path.c_str(), flags, 0644);
+  if (file_descriptor < 0) {
+    if (create) {
+      throw std::runtime_error("Failed to open value log segment");
+    }
+    return nullptr;
+  }
+
+  // Sealed segments are only read, so the oldest one is the cheapest to reopen later.
+  if (open_files_.size() >= kMaxOpenSegments) {
+    for (auto iter = open_files_.begin(); iter != open_files_.end(); ++iter) {
+      if (iter->first != next_pointer_.segment_id) {
+        open_files_.erase(iter);
+        break;
+      }
+    }
+  }
+  auto file = std::make_shared<SegmentFile>(file_descriptor);
+  open_files_.emplace(segment_id, file);
+  return file;
+}
+
+bool ValueLog::ReadRecord(const SegmentPointer& pointer, std::vector<std::byte>& record) const {
+  std::shared_ptr<SegmentFile> file;
+  {
+    std::scoped_lock guard(append_mutex_);
+    if (pointer.segment_id == next_pointer_.segment_id && pointer.offset >= flushed_offset_) {
+      const auto start = pointer.offset - flushed_offset_;
+      if (start + sizeof(RecordHeader) > append_buffer_.size()) {
+        return false;
+      }
+      // Copy just this record, not the rest of the buffer, so appends wait only for the copy.
+      std::uint64_t length = pointer.length;
+      if (length == 0) {
+        RecordHeader header{};
+        std::memcpy(&header, append_buffer_.data() + start, sizeof(header));
+        length = header.stored_length();
+      }
+      const auto end = std::min<std::uint64_t>(start + sizeof(RecordHeader) + length,
+                                               append_buffer_.size());
+      record.assign(append_buffer_.begin() + static_cast<std::ptrdiff_t>(start),
+                    append_buffer_.begin() + static_cast<std::ptrdiff_t>(end));
+    } else {
+      file = FileLocked(pointer.segment_id, false);
+      if (!file) {
+        return false;
+      }
+    }
+  }
+  if (!file) {
+    // Checked outside the lock; a short copy fails here like a short read would.
+    return CheckRecord(pointer, record);
+  }
+
+  // Pointers handed out by Append carry the stored length, so header and payload come back in one
+  // pread.
+  std::uint64_t length = pointer.length;
+  if (length == 0) {
+    RecordHeader header{};
+    if (!ReadFully(file->fd, reinterpret_cast<std::byte*>(&header), sizeof(header),
+                   pointer.offset)) {
+      return false;
+    }
+    length = header.stored_length();
+  }
+  record.resize(sizeof(RecordHeader) + length);
+  return ReadFully(file->fd, record.data(), record.size(), pointer.offset) &&
+         CheckRecord(pointer, record);
+}
+
+void ValueLog::WriteRecordLocked(const SegmentPointer& pointer, std::span<const std::byte> header,
+                                 std::span<const std::byte> payload) {
+  if (header.size() + payload.size() >= kAppendBufferBytes) {
+    // Large values skip the buffer rather than being copied through it.
+    FlushBufferLocked();
+    const auto file = FileLocked(pointer.segment_id, true);
+    WriteFully(file->fd, header.data(), header.size(), flushed_offset_);
+    WriteFully(file->fd, payload.data(), payload.size(), flushed_offset_ + header.size());
+    flushed_offset_ += header.size() + payload.size();
+  } else {
+    append_buffer_.insert(append_buffer_.end(), header.begin(), header.end());
+    append_buffer_.insert(append_buffer_.end(), payload.begin(), payload.end());
+  }
+
+  if (append_buffer_.size() >= kAppendBufferBytes) {
+    FlushBufferLocked();
+  }
+}
+
+std::shared_ptr<const void> ValueLog::HoldLocked(SegmentId segment_id) {
+  {
+    std::scoped_lock guard(pending_->mutex);
+    ++pending_->counts[segment_id];
+  }
+  return {pending_.get(), [pending = pending_, segment_id](const void*) {
+            std::scoped_lock guard(pending->mutex);
+            const auto iter = pending->counts.find(segment_id);
+            if (iter != pending->counts.end() && --iter->second == 0) {
+              pending->counts.erase(iter);
+            }
+          }};
+}
+
+bool ValueLog::HeldLocked(SegmentId segment_id) const {
+  std::scoped_lock guard(pending_->mutex);
+  return pending_->counts.contains(segment_id);
+}
+
+SegmentPointer ValueLog::ReserveLocked(std::uint64_t length) {
+  const auto record_bytes = sizeof(RecordHeader) + length;
+  if (next_pointer_.offset != 0 && next_pointer_.offset + record_bytes > segment_bytes_) {
+    SealActiveLocked();
+  }
+  if (next_pointer_.offset == 0) {
+    PreallocateActiveLocked();
+  }
+
+  auto pointer = next_pointer_;
+  pointer.length = length;
+  next_pointer_.offset += record_bytes;
+  next_pointer_.length = 0;
+  auto& usage = segments_[pointer.segment_id];
+  usage.segment_id = pointer.segment_id;
+  usage.total_bytes = next_pointer_.offset;
+  return pointer;
+}
+
+void ValueLog::FlushBufferLocked() {
+  if (append_buffer_.empty()) {
+    return;
+  }
+  const auto file = FileLocked(next_pointer_.segment_id, true);
+  WriteFully(file->fd, append_buffer_.data(), append_buffer_.size(), flushed_offset_);
+  flushed_offset_ += append_buffer_.size();
+  append_buffer_.clear();
+}
+
+void ValueLog::SealActiveLocked() {
+  if (next_pointer_.offset != 0) {
+    FlushBufferLocked();
+    if (::fdatasync(FileLocked(next_pointer_.segment_id, true)->fd) != 0) {
+      throw std::runtime_error("Failed to sync value log segment");
+    }
+  }
+  next_pointer_.segment_id += 1;
+  next_pointer_.offset = 0;
+  next_pointer_.length = 0;
+  flushed_offset_ = 0;
 }
 
-void ValueLog::RunGcCycle() {
-  // GC scheduling and live-data computation depend on WAL checkpoints. This
-  // placeholder keeps the API shape stable until those pieces land.
+void ValueLog::PreallocateActiveLocked() const {
+  // Reserve the whole segment up front so appends do not fragment it or stall on block allocation.
+  // KEEP_SIZE leaves the file size at the real end of data, which is what reopening relies on.
+  // Filesystems without fallocate simply grow the file on demand.
+  const auto file = FileLocked(next_pointer_.segment_id, true);
+  (void)::fallocate(file->fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(segment_bytes_));
 }
 
 std::filesystem::path ValueLog::SegmentPath(SegmentId segment_id) const {
@@ -1,32 +1,238 @@
 #pragma once
 
 #include "storage/storage_common.h"
+#include "storage/vlog/value_cache.h"
 
 #include <cstdint>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <vector>
 
 namespace jubilant::storage::vlog {
 
 using storage::SegmentPointer;
 
+// How a record's payload is stored. The codec lives in the top bits of the record header's length
+// word, so records written before compression existed read back as kNone.
+enum class Codec : std::uint8_t { kNone = 0, kZstd = 1 };
+
+// A payload ready for appending: compressed when worthwhile and checksummed. payload views either
+// compressed or the caller's original bytes, which must then outlive the record. Move it rather
+// than copy it, or payload keeps pointing into the original.
+struct EncodedRecord {
+  Codec codec{Codec::kNone};
+  std::uint32_t crc{0};
+  std::vector<std::byte> compressed;
+  std::span<const std::byte> payload;
+};
+
 struct AppendResult {
   // Full segment pointer (segment_id, offset, length) for the appended payload.
   SegmentPointer pointer{};
+  // Keeps GC away from the record's segment until the B+Tree has reported the pointer live.
+  // Holders drop it once the ref is inserted or abandoned.
+  std::shared_ptr<const void> hold;
+};
+
+// Live bytes are the records some B+Tree leaf still references; everything else in total_bytes
+// (overwritten, deleted, or never-committed values) is reclaimable by GC.
+struct SegmentUsage {
+  SegmentId segment_id{0};
+  std::uint64_t total_bytes{0};
+  std::uint64_t live_bytes{0};
+
+  [[nodiscard]] double live_ratio() const noexcept {
+    return total_bytes == 0 ? 1.0
+                            : static_cast<double>(live_bytes) / static_cast<double>(total_bytes);
+  }
+};
+
+// A record's payload located inside its segment file, for handing to sendfile(2) without copying
+// it through user space. pin keeps the descriptor open for as long as the caller holds it. length,
+// crc and codec describe the bytes as stored, so a compressed payload stays compressed on the
+// wire; the bytes have not been checked against the CRC.
+struct PinnedRecord {
+  std::shared_ptr<const void> pin;
+  int fd{-1};
+  std::uint64_t offset{0};
+  std::uint64_t length{0};
+  std::uint32_t crc{0};
+  Codec codec{Codec::kNone};
+};
+
+struct GcOptions {
+  // Segments at or below this live ratio are compacted, lowest ratio first.
+  double max_live_ratio{0.5};
+  std::size_t max_segments{4};
+};
+
+struct GcReport {
+  std::vector<SegmentId> retired_segments;
+  std::uint64_t records_relocated{0};
+  std::uint64_t bytes_relocated{0};
 };
 
+// Appends may arrive from several workers at once and are serialized internally. Reads of
+// previously returned pointers need no coordination with appends.
+//
+// Segment descriptors stay open in a small table and are read with pread. Small appends collect in
+// an in-memory buffer that reaches the file when it fills, on rollover, or at Sync(); the WAL's
+// pre-sync hook therefore drains it once per group commit. Reads of still-buffered records are
+// served from the buffer.
+//
+// Append compresses a payload with zstd when it is large enough and a probe says it shrinks; the
+// record is otherwise stored as-is. Pointers, CRCs and live-byte accounting all describe the
+// stored bytes, and reads expand them transparently.
 class ValueLog {
 public:
-  explicit ValueLog(std::filesystem::path base_dir);
+  static constexpr std::uint64_t kDefaultSegmentBytes = 64ULL * 1024ULL * 1024ULL;
+  static constexpr std::size_t kAppendBufferBytes = 1024ULL * 1024ULL;
+  static constexpr std::size_t kMaxOpenSegments = 16;
+  // Stored payload limit; the header's remaining length bits hold the codec.
+  static constexpr std::uint64_t kMaxRecordBytes = (1ULL << 30U) - 1;
 
-  [[nodiscard]] AppendResult Append(const std::vector<std::byte>& data);
+  // Appends roll over to a fresh segment once the next record would push the active one past
+  // segment_bytes. A record larger than the cap gets a segment of its own. A non-zero cache_bytes
+  // keeps recently read values in a ValueCache of that size.
+  explicit ValueLog(std::filesystem::path base_dir,
+                    std::uint64_t segment_bytes = kDefaultSegmentBytes,
+                    std::size_t cache_bytes = 0);
+
+  ValueLog(const ValueLog&) = delete;
+  ValueLog& operator=(const ValueLog&) = delete;
+  ValueLog(ValueLog&& other) noexcept;
+  ValueLog& operator=(ValueLog&& other) noexcept;
+  ~ValueLog();
+
+  // Writes one record whose payload arrives in pieces, so a value never has to be held in memory
+  // whole. Streamed payloads are stored uncompressed. The record's space is reserved up front and
+  // its header, carrying the CRC accumulated over every chunk, is written last; a stream abandoned
+  // before Finish() leaves a hole no pointer refers to, which counts as dead bytes for GC.
+  class AppendStream {
+  public:
+    AppendStream(const AppendStream&) = delete;
+    AppendStream& operator=(const AppendStream&) = delete;
+    AppendStream(AppendStream&&) noexcept = default;
+    AppendStream& operator=(AppendStream&&) noexcept = default;
+    ~AppendStream() = default;
+
+    // Throws if the chunk would run past the length passed to BeginAppend.
+    void Write(std::span<const std::byte> chunk);
+    // Throws unless exactly the declared length has been written.
+    [[nodiscard]] AppendResult Finish();
+    [[nodiscard]] std::uint64_t remaining() const noexcept { return pointer_.length - written_; }
+
+  private:
+    friend class ValueLog;
+    AppendStream(ValueLog& owner, std::shared_ptr<const void> pin, std::shared_ptr<const void> hold,
+                 int fd, SegmentPointer pointer);
+
+    ValueLog* owner_{nullptr};
+    std::shared_ptr<const void> pin_;
+    std::shared_ptr<const void> hold_;
+    int fd_{-1};
+    SegmentPointer pointer_{};
+    std::uint64_t written_{0};
+    std::uint32_t crc_{0};
+  };
+
+  [[nodiscard]] AppendResult Append(std::span<const std::byte> data);
+  // Append in two steps. Encode is pure CPU work and needs no lock, so callers can run it on their
+  // own thread and leave only AppendEncoded to whoever serializes the writes.
+  [[nodiscard]] static EncodedRecord Encode(std::span<const std::byte> data);
+  [[nodiscard]] AppendResult AppendEncoded(const EncodedRecord& record);
+  [[nodiscard]] AppendStream BeginAppend(std::uint64_t length);
   [[nodiscard]] std::optional<std::vector<std::byte>> Read(const SegmentPointer& pointer) const;
-  void RunGcCycle();
+  // Like Read, but expands the value into out, reusing its capacity. Returns false where Read would
+  // return nullopt.
+  [[nodiscard]] bool ReadInto(const SegmentPointer& pointer, std::vector<std::byte>& out) const;
+  // All zero when the log was opened without a cache.
+  [[nodiscard]] ValueCache::Stats cache_stats() const;
+  // Locates a record for zero-copy transfer, first writing out the append buffer if the record is
+  // still in it. Returns nullopt when the segment is gone or the header does not match.
+  [[nodiscard]] std::optional<PinnedRecord> Pin(const SegmentPointer& pointer);
+  // Writes out the append buffer and forces the active segment to stable storage. The WAL runs this
+  // before each of its own syncs so a logged SegmentPointer never outlives the bytes it references.
+  void Sync();
+
+  // Liveness accounting. The B+Tree reports every reference it gains or drops, including the ones
+  // it loads from disk, so usage() reflects what a GC pass would keep.
+  void MarkLive(const SegmentPointer& pointer);
+  void MarkDead(const SegmentPointer& pointer);
+  [[nodiscard]] std::vector<SegmentUsage> usage() const;
+
+  // GC building blocks; BTree::CollectValueLogGarbage drives them because only the tree knows which
+  // records are referenced. SelectGcVictims seals the active segment when it qualifies so new
+  // appends, including relocated records, never land in a victim. It passes over segments with
+  // appends still held, whose pointers the tree has not seen yet.
+  [[nodiscard]] std::vector<SegmentId> SelectGcVictims(const GcOptions& options);
+  // Copies the record, still encoded, forward to the active segment. Liveness stays with the
+  // original until the caller repoints a reference and reports both sides.
+  [[nodiscard]] AppendResult Relocate(const SegmentPointer& pointer);
+  // Victims stay readable until a checkpoint makes the repointed leaves the recovery baseline;
+  // ReleaseRetiredSegments() then deletes them and returns how many were removed. A checkpoint
+  // racing a GC pass releases only the segments retired before it captured its leaves, since
+  // leaves captured earlier still point into the later victims.
+  void RetireSegments(std::span<const SegmentId> segment_ids);
+  [[nodiscard]] std::vector<SegmentId> retired_segments() const;
+  std::size_t ReleaseRetiredSegments();
+  std::size_t ReleaseRetiredSegments(std::span<const SegmentId> segment_ids);
 
 private:
+  // Readers hold a reference while they pread, so evicting or deleting a segment never closes a
+  // descriptor out from under them.
+  struct SegmentFile {
+    explicit SegmentFile(int descriptor) : fd(descriptor) {}
+    ~SegmentFile();
+    SegmentFile(const SegmentFile&) = delete;
+    SegmentFile& operator=(const SegmentFile&) = delete;
+    SegmentFile(SegmentFile&&) = delete;
+    SegmentFile& operator=(SegmentFile&&) = delete;
+
+    int fd;
+  };
+
   std::filesystem::path base_dir_;
+  std::uint64_t segment_bytes_{kDefaultSegmentBytes};
+  // Guards everything below. Not transferred on move.
+  mutable std::mutex append_mutex_;
   SegmentPointer next_pointer_{};
+  // Bytes of the active segment already handed to the kernel; next_pointer_.offset minus this is
+  // the size of append_buffer_.
+  std::uint64_t flushed_offset_{0};
+  std::vector<std::byte> append_buffer_;
+  mutable std::map<SegmentId, std::shared_ptr<SegmentFile>> open_files_;
+  std::map<SegmentId, SegmentUsage> segments_;
+  std::vector<SegmentId> retired_;
+  // Appends whose AppendResult::hold is still alive, per segment. The holds share it, so it has
+  // its own mutex and outlives a move of the log.
+  struct PendingAppends {
+    std::mutex mutex;
+    std::map<SegmentId, std::size_t> counts;
+  };
+  std::shared_ptr<PendingAppends> pending_{std::make_shared<PendingAppends>()};
+  // Read and GC paths touch it without append_mutex_; it locks itself.
+  std::unique_ptr<ValueCache> cache_;
+
+  [[nodiscard]] std::shared_ptr<const void> HoldLocked(SegmentId segment_id);
+  [[nodiscard]] bool HeldLocked(SegmentId segment_id) const;
+  [[nodiscard]] std::shared_ptr<SegmentFile> FileLocked(SegmentId segment_id, bool create) const;
+  // Fetches a record, header included, from the append buffer or its segment file and checks it
+  // against the pointer and its CRC.
+  [[nodiscard]] bool ReadRecord(const SegmentPointer& pointer,
+                                std::vector<std::byte>& record) const;
+  void WriteRecordLocked(const SegmentPointer& pointer, std::span<const std::byte> header,
+                         std::span<const std::byte> payload);
+  // Claims the next record slot, rolling over first if it would not fit, and charges it to the
+  // segment's total bytes.
+  [[nodiscard]] SegmentPointer ReserveLocked(std::uint64_t length);
+  void FlushBufferLocked();
+  void SealActiveLocked();
+  void PreallocateActiveLocked() const;
 
   [[nodiscard]] std::filesystem::path SegmentPath(SegmentId segment_id) const;
 };
@@ -0,0 +1,63 @@
+#include "storage/vlog/value_log_appender.h"
+
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace jubilant::storage::vlog {
+
+ValueLogAppender::ValueLogAppender(ValueLog& value_log)
+    : value_log_(value_log), thread_([this]() { Run(); }) {}
+
+ValueLogAppender::~ValueLogAppender() {
+  Stop();
+}
+
+std::future<AppendResult> ValueLogAppender::Submit(std::span<const std::byte> data) {
+  Job job{.record = ValueLog::Encode(data), .promise = {}};
+  auto future = job.promise.get_future();
+  {
+    std::scoped_lock guard(mutex_);
+    if (stopping_) {
+      throw std::runtime_error("Value log appender is stopped");
+    }
+    queue_.push_back(std::move(job));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+void ValueLogAppender::Stop() {
+  {
+    std::scoped_lock guard(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void ValueLogAppender::Run() {
+  std::deque<Job> batch;
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      batch.swap(queue_);
+    }
+    for (auto& job : batch) {
+      try {
+        job.promise.set_value(value_log_.AppendEncoded(job.record));
+      } catch (...) {
+        job.promise.set_exception(std::current_exception());
+      }
+    }
+    batch.clear();
+  }
+}
+
+} // namespace jubilant::storage::vlog
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "storage/vlog/value_log.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <span>
+#include <thread>
+
+namespace jubilant::storage::vlog {
+
+// Owns the value log's write path so large appends never run on a worker thread. Callers encode
+// (compress and checksum) on their own thread, queue the record, and wait on the returned future
+// before taking any tree lock. A single thread drains the queue, so records land and futures
+// complete in submission order.
+class ValueLogAppender {
+public:
+  explicit ValueLogAppender(ValueLog& value_log);
+  ~ValueLogAppender();
+
+  ValueLogAppender(const ValueLogAppender&) = delete;
+  ValueLogAppender& operator=(const ValueLogAppender&) = delete;
+  ValueLogAppender(ValueLogAppender&&) = delete;
+  ValueLogAppender& operator=(ValueLogAppender&&) = delete;
+
+  // data must stay valid until the future is ready. A failed append surfaces from future.get();
+  // submitting after Stop() throws.
+  [[nodiscard]] std::future<AppendResult> Submit(std::span<const std::byte> data);
+  // Finishes every queued append, then joins the thread.
+  void Stop();
+
+private:
+  struct Job {
+    EncodedRecord record;
+    std::promise<AppendResult> promise;
+  };
+
+  void Run();
+
+  ValueLog& value_log_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+} // namespace jubilant::storage::vlog
@@ -0,0 +1,84 @@
+#include "storage/vlog/value_log_collector.h"
+
+#include <exception>
+#include <utility>
+
+namespace jubilant::storage::vlog {
+
+ValueLogCollector::~ValueLogCollector() {
+  Stop();
+}
+
+GcReport ValueLogCollector::RunPass(const GcOptions& options, const CollectFn& collect) {
+  std::scoped_lock run_guard(run_mutex_);
+  const auto started = std::chrono::steady_clock::now();
+  GcReport report{};
+  bool failed = false;
+  try {
+    report = collect(options);
+  } catch (const std::exception&) {
+    failed = true;
+  }
+
+  std::scoped_lock guard(mutex_);
+  ++stats_.passes;
+  if (failed) {
+    ++stats_.failures;
+  }
+  stats_.segments_retired += report.retired_segments.size();
+  stats_.records_relocated += report.records_relocated;
+  stats_.bytes_relocated += report.bytes_relocated;
+  stats_.last_pass_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started);
+  return report;
+}
+
+void ValueLogCollector::Start(CollectorOptions options, CollectFn collect) {
+  std::scoped_lock guard(mutex_);
+  if (running_) {
+    return;
+  }
+  options_ = options;
+  collect_ = std::move(collect);
+  running_ = true;
+  stop_ = false;
+  thread_ = std::thread([this]() { Loop(); });
+}
+
+void ValueLogCollector::Stop() {
+  {
+    std::scoped_lock guard(mutex_);
+    if (!running_) {
+      return;
+    }
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  std::scoped_lock guard(mutex_);
+  running_ = false;
+  stop_ = false;
+}
+
+CollectorStats ValueLogCollector::stats() const {
+  std::scoped_lock guard(mutex_);
+  return stats_;
+}
+
+void ValueLogCollector::Loop() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      wake_cv_.wait_for(lock, options_.interval, [this]() { return stop_; });
+      if (stop_) {
+        return;
+      }
+    }
+    (void)RunPass(options_.gc, collect_);
+  }
+}
+
+} // namespace jubilant::storage::vlog
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "storage/vlog/value_log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace jubilant::storage::vlog {
+
+// Every interval a pass looks for segments whose live ratio has fallen to gc.max_live_ratio and
+// compacts them, so reclaiming space is both periodic and triggered by the ratio threshold.
+struct CollectorOptions {
+  std::chrono::milliseconds interval{10000};
+  GcOptions gc{};
+};
+
+struct CollectorStats {
+  std::uint64_t passes{0};
+  std::uint64_t failures{0};
+  std::uint64_t segments_retired{0};
+  std::uint64_t records_relocated{0};
+  std::uint64_t bytes_relocated{0};
+  std::chrono::nanoseconds last_pass_duration{0};
+};
+
+// Background thread that runs value-log GC while the server does, instead of leaving dead values
+// on disk until an offline `jubectl gc`. The callback runs the pass, so the owner decides which
+// tree it walks; the retired segments are deleted by the next checkpoint, not here.
+class ValueLogCollector {
+public:
+  // Runs one GC pass and reports what it retired. Throws when a live record cannot be copied; the
+  // pass then leaves its victims in place and retries at the next interval.
+  using CollectFn = std::function<GcReport(const GcOptions& options)>;
+
+  ValueLogCollector() = default;
+  ~ValueLogCollector();
+
+  ValueLogCollector(const ValueLogCollector&) = delete;
+  ValueLogCollector& operator=(const ValueLogCollector&) = delete;
+  ValueLogCollector(ValueLogCollector&&) = delete;
+  ValueLogCollector& operator=(ValueLogCollector&&) = delete;
+
+  // One pass on the caller's thread, serialized with the background thread. A failed pass is
+  // counted in stats() and reports nothing retired.
+  GcReport RunPass(const GcOptions& options, const CollectFn& collect);
+
+  void Start(CollectorOptions options, CollectFn collect);
+  void Stop();
+
+  [[nodiscard]] CollectorStats stats() const;
+
+private:
+  void Loop();
+
+  std::mutex run_mutex_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  CollectorStats stats_{};
+
+  CollectorOptions options_{};
+  CollectFn collect_;
+  bool running_{false};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+} // namespace jubilant::storage::vlog
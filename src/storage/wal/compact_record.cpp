@@ -0,0 +1,288 @@
+#include "storage/wal/compact_record.h"
+
+#include "storage/checksum.h"
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace jubilant::storage::wal {
+
+namespace {
+
+// Body lengths are capped at u32, so the length varint never needs more than five bytes. The
+// encoder reserves that much up front and writes the header right-aligned against the body.
+constexpr std::size_t kMaxLengthVarintBytes = 5;
+constexpr std::size_t kMaxVarintBytes = 10;
+
+constexpr std::uint8_t kTypeMask = 0x0FU;
+constexpr std::uint8_t kHasValuePtr = 0x10U;
+constexpr std::uint8_t kHasTtl = 0x20U;
+constexpr unsigned kValueKindShift = 6U;
+
+std::size_t EncodeVarint(std::uint64_t value, std::byte* out) {
+  std::size_t written = 0;
+  while (value >= 0x80U) {
+    out[written++] = static_cast<std::byte>((value & 0x7FU) | 0x80U);
+    value >>= 7U;
+  }
+  out[written++] = static_cast<std::byte>(value);
+  return written;
+}
+
+class Cursor {
+public:
+  explicit Cursor(std::span<const std::byte> data) : data_(data) {}
+
+  [[nodiscard]] bool empty() const noexcept {
+    return position_ == data_.size();
+  }
+
+  [[nodiscard]] std::optional<std::uint8_t> Byte() {
+    if (empty()) {
+      return std::nullopt;
+    }
+    return static_cast<std::uint8_t>(data_[position_++]);
+  }
+
+  [[nodiscard]] std::optional<std::uint64_t> Varint() {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < kMaxVarintBytes; ++i) {
+      const auto next = Byte();
+      if (!next.has_value()) {
+        return std::nullopt;
+      }
+      value |= static_cast<std::uint64_t>(*next & 0x7FU) << (7U * i);
+      if ((*next & 0x80U) == 0U) {
+        return value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<std::span<const std::byte>> Sized() {
+    const auto size = Varint();
+    if (!size.has_value() || *size > data_.size() - position_) {
+      return std::nullopt;
+    }
+    const auto bytes = data_.subspan(position_, static_cast<std::size_t>(*size));
+    position_ += bytes.size();
+    return bytes;
+  }
+
+private:
+  std::span<const std::byte> data_;
+  std::size_t position_{0};
+};
+
+std::optional<std::vector<WalRecord>> DecodeBody(std::span<const std::byte> body) {
+  Cursor cursor{body};
+  const auto first_lsn = cursor.Varint();
+  const auto txn_id = cursor.Varint();
+  if (!first_lsn.has_value() || !txn_id.has_value()) {
+    return std::nullopt;
+  }
+
+  std::vector<WalRecord> records;
+  while (!cursor.empty()) {
+    const auto tag = cursor.Byte();
+    if (!tag.has_value()) {
+      return std::nullopt;
+    }
+    const auto type_bits = static_cast<std::uint8_t>(*tag & kTypeMask);
+    if (type_bits > static_cast<std::uint8_t>(RecordType::kCheckpoint)) {
+      return std::nullopt;
+    }
+
+    WalRecord record{};
+    record.type = static_cast<RecordType>(type_bits);
+    record.txn_id = *txn_id;
+    record.lsn = *first_lsn + records.size();
+
+    if (record.type == RecordType::kUpsert) {
+      const auto key = cursor.Sized();
+      const auto value = cursor.Sized();
+      if (!key.has_value() || !value.has_value()) {
+        return std::nullopt;
+      }
+      const auto value_kind = static_cast<std::uint8_t>(*tag >> kValueKindShift);
+      if (value_kind > static_cast<std::uint8_t>(ValueKind::kInt64)) {
+        return std::nullopt;
+      }
+      UpsertPayload payload{};
+      payload.value_kind = static_cast<ValueKind>(value_kind);
+      payload.key.assign(reinterpret_cast<const char*>(key->data()), key->size());
+      payload.value.assign(value->begin(), value->end());
+      if ((*tag & kHasValuePtr) != 0U) {
+        const auto segment_id = cursor.Varint();
+        const auto offset = cursor.Varint();
+        const auto length = cursor.Varint();
+        if (!segment_id.has_value() || !offset.has_value() || !length.has_value() ||
+            *segment_id > std::numeric_limits<SegmentId>::max()) {
+          return std::nullopt;
+        }
+        payload.value_ptr = SegmentPointer{.segment_id = static_cast<SegmentId>(*segment_id),
+                                           .offset = *offset,
+                                           .length = *length};
+      }
+      if ((*tag & kHasTtl) != 0U) {
+        const auto ttl = cursor.Varint();
+        if (!ttl.has_value()) {
+          return std::nullopt;
+        }
+        payload.ttl_epoch_seconds = *ttl;
+      }
+      record.upsert = std::move(payload);
+    } else if (record.type == RecordType::kTombstone) {
+      const auto key = cursor.Sized();
+      if (!key.has_value()) {
+        return std::nullopt;
+      }
+      record.tombstone_key = std::string(reinterpret_cast<const char*>(key->data()), key->size());
+    }
+
+    records.push_back(std::move(record));
+  }
+
+  if (records.empty()) {
+    return std::nullopt;
+  }
+  return records;
+}
+
+} // namespace
+
+CompactFrameEncoder::CompactFrameEncoder(std::size_t initial_bytes) {
+  buffer_.reserve(initial_bytes);
+}
+
+void CompactFrameEncoder::Reset(Lsn first_lsn, std::uint64_t txn_id) {
+  buffer_.resize(kMaxLengthVarintBytes);
+  op_count_ = 0;
+  PutVarint(first_lsn);
+  PutVarint(txn_id);
+}
+
+void CompactFrameEncoder::AddMarker(RecordType type) {
+  PutTag(type, 0);
+}
+
+void CompactFrameEncoder::AddUpsert(std::string_view key, std::span<const std::byte> value,
+                                    ValueKind value_kind, std::uint64_t ttl_epoch_seconds,
+                                    const std::optional<SegmentPointer>& value_ptr) {
+  auto flags = static_cast<std::uint8_t>(static_cast<std::uint8_t>(value_kind) << kValueKindShift);
+  if (value_ptr.has_value()) {
+    flags |= kHasValuePtr;
+  }
+  if (ttl_epoch_seconds != 0) {
+    flags |= kHasTtl;
+  }
+
+  PutTag(RecordType::kUpsert, flags);
+  PutVarint(key.size());
+  PutBytes(key.data(), key.size());
+  PutVarint(value.size());
+  PutBytes(value.data(), value.size());
+  if (value_ptr.has_value()) {
+    PutVarint(value_ptr->segment_id);
+    PutVarint(value_ptr->offset);
+    PutVarint(value_ptr->length);
+  }
+  if (ttl_epoch_seconds != 0) {
+    PutVarint(ttl_epoch_seconds);
+  }
+}
+
+void CompactFrameEncoder::AddTombstone(std::string_view key) {
+  PutTag(RecordType::kTombstone, 0);
+  PutVarint(key.size());
+  PutBytes(key.data(), key.size());
+}
+
+std::size_t CompactFrameEncoder::op_count() const noexcept {
+  return op_count_;
+}
+
+std::span<const std::byte> CompactFrameEncoder::Finish() {
+  const auto body_length = buffer_.size() - kMaxLengthVarintBytes;
+  if (body_length > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("Compact WAL frame exceeds 4 GiB");
+  }
+
+  std::array<std::byte, kMaxLengthVarintBytes> header{};
+  const auto header_size = EncodeVarint(body_length, header.data());
+  const auto start = kMaxLengthVarintBytes - header_size;
+  std::memcpy(buffer_.data() + start, header.data(), header_size);
+
+  const std::uint32_t crc =
+      ComputeCrc32(std::span<const std::byte>(buffer_.data() + start, buffer_.size() - start));
+  PutBytes(&crc, sizeof(crc));
+
+  return {buffer_.data() + start, buffer_.size() - start};
+}
+
+void CompactFrameEncoder::PutTag(RecordType type, std::uint8_t flags) {
+  const auto tag = static_cast<std::uint8_t>(static_cast<std::uint8_t>(type) | flags);
+  PutBytes(&tag, sizeof(tag));
+  ++op_count_;
+}
+
+void CompactFrameEncoder::PutVarint(std::uint64_t value) {
+  std::array<std::byte, kMaxVarintBytes> encoded{};
+  PutBytes(encoded.data(), EncodeVarint(value, encoded.data()));
+}
+
+void CompactFrameEncoder::PutBytes(const void* data, std::size_t size) {
+  const auto* bytes = static_cast<const std::byte*>(data);
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+}
+
+std::optional<std::vector<WalRecord>> ReadCompactFrame(std::istream& stream,
+                                                       std::uint64_t file_bytes) {
+  std::array<std::byte, kMaxLengthVarintBytes> header{};
+  std::size_t header_size = 0;
+  std::uint64_t body_length = 0;
+  while (true) {
+    if (header_size == header.size()) {
+      return std::nullopt;
+    }
+    const auto next = stream.get();
+    if (next == std::istream::traits_type::eof()) {
+      return std::nullopt;
+    }
+    const auto byte = static_cast<std::uint8_t>(next);
+    header[header_size] = static_cast<std::byte>(byte);
+    body_length |= static_cast<std::uint64_t>(byte & 0x7FU) << (7U * header_size);
+    ++header_size;
+    if ((byte & 0x80U) == 0U) {
+      break;
+    }
+  }
+
+  // A torn length header can claim gigabytes; reject it before allocating.
+  const auto body_offset = static_cast<std::uint64_t>(stream.tellg());
+  if (body_length == 0 || body_offset + body_length + sizeof(std::uint32_t) > file_bytes) {
+    return std::nullopt;
+  }
+
+  std::vector<std::byte> frame(header_size + body_length);
+  std::memcpy(frame.data(), header.data(), header_size);
+  stream.read(reinterpret_cast<char*>(frame.data() + header_size),
+              static_cast<std::streamsize>(body_length));
+  std::uint32_t stored_crc = 0;
+  stream.read(reinterpret_cast<char*>(&stored_crc), sizeof(stored_crc));
+  if (!stream) {
+    return std::nullopt;
+  }
+
+  if (ComputeCrc32(frame) != stored_crc) {
+    return std::nullopt;
+  }
+
+  return DecodeBody(std::span<const std::byte>(frame).subspan(header_size));
+}
+
+} // namespace jubilant::storage::wal
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "storage/wal/wal_record.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace jubilant::storage::wal {
+
+// Compact WAL framing ("wal-compact-v1"):
+//   {varint body_length}{body}{u32 crc32}
+// The CRC covers the length varint and the body. The body opens with varint first_lsn and varint
+// txn_id, followed by operations until the body ends. Each operation is a tag byte (record type in
+// the low nibble, kHasValuePtr/kHasTtl flags in bits 4-5, upsert ValueKind in bits 6-7) and then:
+//   upsert:    varint key_len, key, varint value_len, value,
+//              [varint segment_id, varint offset, varint length] when kHasValuePtr,
+//              [varint ttl_epoch_seconds] when kHasTtl
+//   tombstone: varint key_len, key
+//   markers:   nothing
+// Operation i of a frame carries LSN first_lsn + i and the frame's txn_id, so a whole transaction
+// costs one header and one CRC.
+class CompactFrameEncoder {
+public:
+  explicit CompactFrameEncoder(std::size_t initial_bytes);
+
+  void Reset(Lsn first_lsn, std::uint64_t txn_id);
+  void AddMarker(RecordType type);
+  void AddUpsert(std::string_view key, std::span<const std::byte> value, ValueKind value_kind,
+                 std::uint64_t ttl_epoch_seconds, const std::optional<SegmentPointer>& value_ptr);
+  void AddTombstone(std::string_view key);
+
+  [[nodiscard]] std::size_t op_count() const noexcept;
+
+  // Writes the length header and CRC trailer and returns the finished frame. The span stays valid
+  // until the next Reset.
+  [[nodiscard]] std::span<const std::byte> Finish();
+
+private:
+  void PutTag(RecordType type, std::uint8_t flags);
+  void PutVarint(std::uint64_t value);
+  void PutBytes(const void* data, std::size_t size);
+
+  std::vector<std::byte> buffer_;
+  std::size_t op_count_{0};
+};
+
+// Reads one compact frame. Returns nullopt when the frame is torn, claims more bytes than remain
+// before file_bytes, fails its CRC, or does not decode; the stream position is then unspecified.
+[[nodiscard]] std::optional<std::vector<WalRecord>> ReadCompactFrame(std::istream& stream,
+                                                                     std::uint64_t file_bytes);
+
+} // namespace jubilant::storage::wal
@@ -4,104 +4,610 @@
 #include "storage/storage_common.h"
 #include "wal_generated.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
 #include <flatbuffers/verifier.h>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
 #include <utility>
 
 namespace wal_fb = ::jubilant::wal;
 
+namespace jubilant::storage::wal {
+
 namespace {
 
-std::vector<std::byte> BuildCrcPayload(const jubilant::storage::wal::WalRecord& record) {
-  std::vector<std::byte> payload;
-  const auto append_bytes = [&payload](const void* data, std::size_t length) {
-    const auto* bytes = reinterpret_cast<const std::byte*>(data);
-    payload.insert(payload.end(), bytes, bytes + length);
-  };
+// Makes a newly created segment's directory entry durable along with its contents.
+void SyncDirectory(const std::filesystem::path& dir) {
+  const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0) {
+    throw std::runtime_error("Failed to open WAL directory for sync");
+  }
+  const bool synced = ::fsync(dir_fd) == 0;
+  ::close(dir_fd);
+  if (!synced) {
+    throw std::runtime_error("Failed to sync WAL directory");
+  }
+}
+
+} // namespace
+
+WalManager::WalManager(std::filesystem::path base_dir, WalEncoding encoding,
+                       WalPosition checkpoint)
+    : wal_dir_(std::move(base_dir)), encoding_(encoding) {
+  std::filesystem::create_directories(wal_dir_);
 
-  const auto type_byte = static_cast<std::uint8_t>(record.type);
-  append_bytes(&type_byte, sizeof(type_byte));
-  append_bytes(&record.lsn, sizeof(record.lsn));
-  append_bytes(&record.txn_id, sizeof(record.txn_id));
+  // Sealed segments were synced before their successor was opened, so only the highest one can
+  // end in a torn record. Each successor opens with a checkpoint marker numbered right after its
+  // predecessor's last record, which bounds the predecessor without scanning it.
+  const auto segments = ListSegments(wal_dir_);
+  Lsn last_lsn = checkpoint.lsn;
+  for (std::size_t i = 0; i + 1 < segments.size(); ++i) {
+    const auto successor_first = FirstLsn(WalSegmentPath(wal_dir_, segments[i + 1]), encoding_);
+    const auto sealed_last =
+        successor_first.value_or(0) > 0
+            ? *successor_first - 1
+            : ScanSegment(WalSegmentPath(wal_dir_, segments[i]), encoding_).last_replayed;
+    last_lsn = std::max(last_lsn, sealed_last);
+    sealed_segments_[segments[i]] = last_lsn;
+  }
+  active_segment_ = segments.empty() ? 0 : segments.back();
+  wal_path_ = WalSegmentPath(wal_dir_, active_segment_);
+
+  // Records before the checkpoint position were intact when the checkpoint was taken, so only the
+  // tail after it needs verifying.
+  const auto scan_from = checkpoint.segment == active_segment_ ? checkpoint.offset : 0;
+  const auto replay = ScanSegment(wal_path_, encoding_, scan_from);
+  last_repair_ = TruncateTorn(wal_path_, replay);
+  last_lsn = std::max(last_lsn, replay.last_replayed);
+  next_lsn_ = last_lsn + 1;
+  appended_lsn_.store(last_lsn);
+  durable_lsn_ = last_lsn;
+  active_bytes_.store(replay.valid_bytes);
+
+  wal_fd_ = ::open(wal_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (wal_fd_ < 0) {
+    throw std::runtime_error("Failed to open WAL segment for append");
+  }
+}
 
-  if (record.upsert.has_value()) {
-    const auto& upsert = record.upsert.value();
-    append_bytes(&upsert.ttl_epoch_seconds, sizeof(upsert.ttl_epoch_seconds));
+WalManager::~WalManager() {
+  StopGroupCommit();
+  if (wal_fd_ >= 0) {
+    ::close(wal_fd_);
+    wal_fd_ = -1;
+  }
+}
 
-    const auto key_size = static_cast<std::uint32_t>(upsert.key.size());
-    append_bytes(&key_size, sizeof(key_size));
-    append_bytes(upsert.key.data(), upsert.key.size());
+Lsn WalManager::Append(const WalRecord& record) {
+  std::scoped_lock guard(append_mutex_);
+  switch (record.type) {
+  case RecordType::kUpsert:
+    if (record.upsert.has_value()) {
+      const auto& upsert = record.upsert.value();
+      return AppendUpsertLocked(record.txn_id, upsert.key, upsert.value, upsert.ttl_epoch_seconds,
+                                upsert.value_ptr, upsert.value_kind);
+    }
+    break;
+  case RecordType::kTombstone:
+    if (record.tombstone_key.has_value()) {
+      return AppendTombstoneLocked(record.txn_id, *record.tombstone_key);
+    }
+    break;
+  case RecordType::kTxnBegin:
+  case RecordType::kTxnCommit:
+  case RecordType::kTxnAbort:
+  case RecordType::kCheckpoint:
+    return AppendMarkerLocked(record.type, record.txn_id);
+  }
 
-    const auto value_size = static_cast<std::uint32_t>(upsert.value.size());
-    append_bytes(&value_size, sizeof(value_size));
-    append_bytes(upsert.value.data(), upsert.value.size());
-  } else if (record.tombstone_key.has_value()) {
-    const auto key_size = static_cast<std::uint32_t>(record.tombstone_key->size());
-    append_bytes(&key_size, sizeof(key_size));
-    append_bytes(record.tombstone_key->data(), record.tombstone_key->size());
+  // Upserts/tombstones without a payload keep their type but carry no body.
+  if (encoding_ == WalEncoding::kCompact) {
+    compact_.Reset(next_lsn_, record.txn_id);
+    if (record.type == RecordType::kUpsert) {
+      compact_.AddUpsert({}, {}, ValueKind::kBytes, 0, std::nullopt);
+    } else {
+      compact_.AddTombstone({});
+    }
+    return WriteCompactFrame();
   }
+  builder_.Clear();
+  return FinishAndWrite(record.type, {}, {}, {});
+}
 
-  return payload;
+Lsn WalManager::AppendMarker(RecordType type, std::uint64_t txn_id) {
+  std::scoped_lock guard(append_mutex_);
+  return AppendMarkerLocked(type, txn_id);
 }
 
-} // namespace
+Lsn WalManager::AppendUpsert(std::uint64_t txn_id, std::string_view key,
+                             std::span<const std::byte> value, std::uint64_t ttl_epoch_seconds,
+                             const std::optional<SegmentPointer>& value_ptr,
+                             ValueKind value_kind) {
+  std::scoped_lock guard(append_mutex_);
+  return AppendUpsertLocked(txn_id, key, value, ttl_epoch_seconds, value_ptr, value_kind);
+}
 
-namespace jubilant::storage::wal {
+Lsn WalManager::AppendTombstone(std::uint64_t txn_id, std::string_view key) {
+  std::scoped_lock guard(append_mutex_);
+  return AppendTombstoneLocked(txn_id, key);
+}
 
-WalManager::WalManager(std::filesystem::path base_dir)
-    : wal_dir_(std::move(base_dir)), wal_path_(WalSegmentPath(wal_dir_, 0)) {
-  std::filesystem::create_directories(wal_dir_);
+Lsn WalManager::AppendTransaction(std::uint64_t txn_id, std::span<const WalOp> ops) {
+  for (const auto& op : ops) {
+    if (op.type != RecordType::kUpsert && op.type != RecordType::kTombstone) {
+      throw std::invalid_argument("WAL transaction batches accept only upserts and tombstones");
+    }
+  }
 
-  const auto replay = Replay();
-  buffered_records_ = replay.committed;
-  next_lsn_ = replay.last_replayed + 1;
+  std::scoped_lock guard(append_mutex_);
+  if (encoding_ == WalEncoding::kCompact) {
+    compact_.Reset(next_lsn_, txn_id);
+    compact_.AddMarker(RecordType::kTxnBegin);
+    for (const auto& op : ops) {
+      if (op.type == RecordType::kUpsert) {
+        compact_.AddUpsert(op.key, op.value, op.value_kind, op.ttl_epoch_seconds, op.value_ptr);
+      } else {
+        compact_.AddTombstone(op.key);
+      }
+    }
+    compact_.AddMarker(RecordType::kTxnCommit);
+    return WriteCompactFrame();
+  }
+
+  (void)AppendMarkerLocked(RecordType::kTxnBegin, txn_id);
+  for (const auto& op : ops) {
+    if (op.type == RecordType::kUpsert) {
+      (void)AppendUpsertLocked(txn_id, op.key, op.value, op.ttl_epoch_seconds, op.value_ptr,
+                               op.value_kind);
+    } else {
+      (void)AppendTombstoneLocked(txn_id, op.key);
+    }
+  }
+  return AppendMarkerLocked(RecordType::kTxnCommit, txn_id);
 }
 
-Lsn WalManager::Append(const WalRecord& record) {
-  WalRecord to_persist = record;
-  to_persist.lsn = next_lsn_++;
+Lsn WalManager::Rollover(Lsn checkpoint_lsn) {
+  std::unique_lock guard(append_mutex_);
+  const auto next_segment = active_segment_ + 1;
+  auto next_path = WalSegmentPath(wal_dir_, next_segment);
+  const int next_fd = ::open(next_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (next_fd < 0) {
+    throw std::runtime_error("Failed to open WAL segment for append");
+  }
 
-  buffered_records_.push_back(to_persist);
-  PersistRecord(to_persist);
+  const Lsn sealed_through = next_lsn_ - 1;
+  {
+    std::scoped_lock sync_guard(sync_mutex_);
+    // Sealing syncs everything appended so far; later Flush() calls only sync the new segment.
+    if (::fdatasync(wal_fd_) != 0) {
+      ::close(next_fd);
+      throw std::runtime_error("Failed to sync WAL segment");
+    }
+    ::close(wal_fd_);
+    wal_fd_ = next_fd;
+  }
+  sealed_segments_[active_segment_] = sealed_through;
+  active_segment_ = next_segment;
+  wal_path_ = std::move(next_path);
+  active_bytes_.store(0);
+  SyncDirectory(wal_dir_);
+
+  // The marker keeps the new segment non-empty, so a reopen resumes LSNs after it even once every
+  // sealed segment has been released.
+  const Lsn marker_lsn = AppendMarkerLocked(RecordType::kCheckpoint, checkpoint_lsn);
+  guard.unlock();
+  MarkDurable(sealed_through);
+  return marker_lsn;
+}
 
-  return to_persist.lsn;
+std::size_t WalManager::ReleaseSegmentsThrough(Lsn lsn) {
+  std::vector<SegmentId> released;
+  {
+    std::scoped_lock guard(append_mutex_);
+    // Segment ids and their last LSNs grow together, so the releasable ones form a prefix.
+    for (auto iter = sealed_segments_.begin();
+         iter != sealed_segments_.end() && iter->second <= lsn;) {
+      released.push_back(iter->first);
+      iter = sealed_segments_.erase(iter);
+    }
+  }
+
+  std::size_t removed = 0;
+  for (const auto segment_id : released) {
+    std::error_code error;
+    if (std::filesystem::remove(WalSegmentPath(wal_dir_, segment_id), error)) {
+      ++removed;
+    }
+  }
+  return removed;
+}
+
+Lsn WalManager::AppendMarkerLocked(RecordType type, std::uint64_t txn_id) {
+  if (encoding_ == WalEncoding::kCompact) {
+    compact_.Reset(next_lsn_, txn_id);
+    compact_.AddMarker(type);
+    return WriteCompactFrame();
+  }
+  builder_.Clear();
+  const auto marker = wal_fb::CreateTxnMarker(builder_, txn_id);
+  return FinishAndWrite(type, {}, {}, marker);
+}
+
+Lsn WalManager::AppendUpsertLocked(std::uint64_t txn_id, std::string_view key,
+                                   std::span<const std::byte> value,
+                                   std::uint64_t ttl_epoch_seconds,
+                                   const std::optional<SegmentPointer>& value_ptr,
+                                   ValueKind value_kind) {
+  if (encoding_ == WalEncoding::kCompact) {
+    compact_.Reset(next_lsn_, txn_id);
+    compact_.AddUpsert(key, value, value_kind, ttl_epoch_seconds, value_ptr);
+    return WriteCompactFrame();
+  }
+  builder_.Clear();
+  const auto key_vec =
+      builder_.CreateVector(reinterpret_cast<const std::uint8_t*>(key.data()), key.size());
+  const auto value_vec =
+      builder_.CreateVector(reinterpret_cast<const std::uint8_t*>(value.data()), value.size());
+  flatbuffers::Offset<wal_fb::ValuePointer> value_ptr_offset{};
+  if (value_ptr.has_value()) {
+    value_ptr_offset = wal_fb::CreateValuePointer(builder_, value_ptr->segment_id,
+                                                  value_ptr->offset, value_ptr->length);
+  }
+  const auto upsert =
+      wal_fb::CreateUpsert(builder_, txn_id, key_vec, static_cast<wal_fb::ValueKind>(value_kind),
+                           value_vec, value_ptr_offset, ttl_epoch_seconds);
+  return FinishAndWrite(RecordType::kUpsert, upsert, {}, {});
+}
+
+Lsn WalManager::AppendTombstoneLocked(std::uint64_t txn_id, std::string_view key) {
+  if (encoding_ == WalEncoding::kCompact) {
+    compact_.Reset(next_lsn_, txn_id);
+    compact_.AddTombstone(key);
+    return WriteCompactFrame();
+  }
+  builder_.Clear();
+  const auto key_vec =
+      builder_.CreateVector(reinterpret_cast<const std::uint8_t*>(key.data()), key.size());
+  const auto tombstone = wal_fb::CreateTombstone(builder_, txn_id, key_vec);
+  return FinishAndWrite(RecordType::kTombstone, {}, tombstone, {});
+}
+
+Lsn WalManager::FinishAndWrite(RecordType type, flatbuffers::Offset<wal_fb::Upsert> upsert,
+                               flatbuffers::Offset<wal_fb::Tombstone> tombstone,
+                               flatbuffers::Offset<wal_fb::TxnMarker> marker) {
+  const Lsn lsn = next_lsn_;
+  const auto root = wal_fb::CreateWalRecord(builder_, static_cast<wal_fb::RecordType>(type), lsn,
+                                            upsert, tombstone, marker);
+  builder_.FinishSizePrefixed(root, wal_fb::WalRecordIdentifier());
+
+  // The CRC covers the finished frame, size prefix included, so a torn prefix fails verification
+  // just like a torn payload.
+  auto* const frame = builder_.GetBufferPointer();
+  const auto frame_size = static_cast<std::size_t>(builder_.GetSize());
+  std::uint32_t crc = ComputeCrc32(
+      std::span<const std::byte>(reinterpret_cast<const std::byte*>(frame), frame_size));
+
+  std::array<iovec, 2> parts{{
+      {.iov_base = frame, .iov_len = frame_size},
+      {.iov_base = &crc, .iov_len = sizeof(crc)},
+  }};
+  const auto expected = static_cast<ssize_t>(frame_size + sizeof(crc));
+  if (::writev(wal_fd_, parts.data(), static_cast<int>(parts.size())) != expected) {
+    throw std::runtime_error("Failed to append WAL record");
+  }
+  active_bytes_.fetch_add(static_cast<std::uint64_t>(expected));
+  appended_bytes_.fetch_add(static_cast<std::uint64_t>(expected));
+
+  ++next_lsn_;
+  appended_lsn_.store(lsn);
+  return lsn;
+}
+
+Lsn WalManager::WriteCompactFrame() {
+  const auto frame = compact_.Finish();
+  if (::write(wal_fd_, frame.data(), frame.size()) != static_cast<ssize_t>(frame.size())) {
+    throw std::runtime_error("Failed to append WAL record");
+  }
+  active_bytes_.fetch_add(frame.size());
+  appended_bytes_.fetch_add(frame.size());
+
+  next_lsn_ += compact_.op_count();
+  appended_lsn_.store(next_lsn_ - 1);
+  return next_lsn_ - 1;
 }
 
 void WalManager::Flush() {
-  // Persistence happens during append; flush remains as the explicit fsync
-  // hook once segment management lands.
+  // Capture the target before syncing: anything appended while fdatasync runs is not covered.
+  const Lsn target = appended_lsn_.load();
+  // Records up to target may point at value-log bytes appended before them, so those go first.
+  if (pre_sync_hook_) {
+    pre_sync_hook_();
+  }
+  {
+    std::scoped_lock sync_guard(sync_mutex_);
+    if (::fdatasync(wal_fd_) != 0) {
+      throw std::runtime_error("Failed to sync WAL segment");
+    }
+  }
+  MarkDurable(target);
+}
+
+void WalManager::SetPreSyncHook(std::function<void()> hook) {
+  pre_sync_hook_ = std::move(hook);
+}
+
+void WalManager::StartGroupCommit(std::chrono::milliseconds max_latency) {
+  std::scoped_lock guard(durable_mutex_);
+  if (group_commit_running_) {
+    return;
+  }
+  group_commit_latency_ = max_latency;
+  group_commit_running_ = true;
+  stop_group_commit_ = false;
+  sync_failed_ = false;
+  group_commit_thread_ = std::thread([this]() { GroupCommitLoop(); });
+}
+
+void WalManager::StopGroupCommit() {
+  {
+    std::scoped_lock guard(durable_mutex_);
+    if (!group_commit_running_) {
+      return;
+    }
+    stop_group_commit_ = true;
+  }
+  flusher_cv_.notify_all();
+  if (group_commit_thread_.joinable()) {
+    group_commit_thread_.join();
+  }
+
+  std::scoped_lock guard(durable_mutex_);
+  group_commit_running_ = false;
+  durable_cv_.notify_all();
+}
+
+bool WalManager::WaitDurable(Lsn lsn) {
+  {
+    std::unique_lock lock(durable_mutex_);
+    if (durable_lsn_ >= lsn) {
+      return true;
+    }
+    if (group_commit_running_) {
+      durable_cv_.wait(lock, [&]() {
+        return durable_lsn_ >= lsn || sync_failed_ || !group_commit_running_;
+      });
+      return durable_lsn_ >= lsn;
+    }
+  }
+
+  Flush();
+  return true;
+}
+
+Lsn WalManager::durable_lsn() const {
+  std::scoped_lock guard(durable_mutex_);
+  return durable_lsn_;
+}
+
+void WalManager::MarkDurable(Lsn lsn) {
+  std::scoped_lock guard(durable_mutex_);
+  if (lsn > durable_lsn_) {
+    durable_lsn_ = lsn;
+  }
+  durable_cv_.notify_all();
 }
 
-ReplayResult WalManager::Replay() const {
+void WalManager::GroupCommitLoop() {
+  while (true) {
+    {
+      std::unique_lock lock(durable_mutex_);
+      // Sleep a full window so every commit that lands meanwhile shares the next fdatasync.
+      flusher_cv_.wait_for(lock, group_commit_latency_, [this]() { return stop_group_commit_; });
+      if (!stop_group_commit_ && appended_lsn_.load() <= durable_lsn_) {
+        continue;
+      }
+    }
+
+    try {
+      Flush();
+    } catch (const std::runtime_error&) {
+      std::scoped_lock guard(durable_mutex_);
+      sync_failed_ = true;
+      durable_cv_.notify_all();
+      return;
+    }
+
+    std::scoped_lock guard(durable_mutex_);
+    if (stop_group_commit_) {
+      return;
+    }
+  }
+}
+
+ReplayResult WalManager::Replay(WalPosition from) const {
+  std::vector<SegmentId> segments;
+  {
+    std::scoped_lock guard(append_mutex_);
+    for (auto iter = sealed_segments_.lower_bound(from.segment); iter != sealed_segments_.end();
+         ++iter) {
+      segments.push_back(iter->first);
+    }
+    segments.push_back(active_segment_);
+  }
+
   ReplayResult result{};
+  for (const auto segment_id : segments) {
+    const auto start_offset = segment_id == from.segment ? from.offset : 0;
+    auto scan = ScanSegment(WalSegmentPath(wal_dir_, segment_id), encoding_, start_offset);
+    result.last_replayed = std::max(result.last_replayed, scan.last_replayed);
+    result.committed.insert(result.committed.end(), std::make_move_iterator(scan.committed.begin()),
+                            std::make_move_iterator(scan.committed.end()));
+    result.valid_bytes = scan.valid_bytes;
+    result.file_bytes = scan.file_bytes;
+    if (scan.valid_bytes < scan.file_bytes) {
+      break;
+    }
+  }
+  return result;
+}
+
+Lsn WalManager::next_lsn() const {
+  std::scoped_lock guard(append_mutex_);
+  return next_lsn_;
+}
+
+WalPosition WalManager::end_position() const {
+  std::scoped_lock guard(append_mutex_);
+  return WalPosition{.segment = active_segment_, .offset = active_bytes_.load(),
+                     .lsn = next_lsn_ - 1};
+}
+
+SegmentId WalManager::active_segment() const {
+  std::scoped_lock guard(append_mutex_);
+  return active_segment_;
+}
 
-  std::ifstream stream(wal_path_, std::ios::binary);
+std::uint64_t WalManager::active_segment_bytes() const noexcept {
+  return active_bytes_.load();
+}
+
+std::uint64_t WalManager::appended_bytes() const noexcept {
+  return appended_bytes_.load();
+}
+
+const RepairReport& WalManager::last_repair() const noexcept {
+  return last_repair_;
+}
+
+WalEncoding WalManager::encoding() const noexcept {
+  return encoding_;
+}
+
+RepairReport WalManager::RepairTail(const std::filesystem::path& base_dir, WalEncoding encoding) {
+  const auto segments = ListSegments(base_dir);
+  const auto wal_path = WalSegmentPath(base_dir, segments.empty() ? 0 : segments.back());
+  return TruncateTorn(wal_path, ScanSegment(wal_path, encoding));
+}
+
+std::vector<SegmentId> WalManager::ListSegments(const std::filesystem::path& dir) {
+  std::vector<SegmentId> segments;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+    const auto segment_id = ParseWalSegmentName(entry.path().filename().string());
+    if (segment_id.has_value() && entry.is_regular_file()) {
+      segments.push_back(*segment_id);
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+ReplayResult WalManager::ScanSegment(const std::filesystem::path& wal_path, WalEncoding encoding,
+                                     std::uint64_t start_offset) {
+  ReplayResult result{};
+
+  std::error_code size_error;
+  const auto file_bytes = std::filesystem::file_size(wal_path, size_error);
+  if (size_error) {
+    return result;
+  }
+  result.file_bytes = file_bytes;
+
+  std::ifstream stream(wal_path, std::ios::binary);
   if (!stream) {
     return result;
   }
+  if (start_offset > file_bytes) {
+    start_offset = 0;
+  }
+  stream.seekg(static_cast<std::streamoff>(start_offset));
+  result.valid_bytes = start_offset;
 
+  // Stop at the first record that fails to decode or verify. Records behind a corrupt one are not
+  // trusted even if they happen to parse, matching the "stop at last valid record" recovery rule.
   while (true) {
-    auto record = ReadNext(stream);
-    if (!record.has_value()) {
-      if (!stream) {
+    if (encoding == WalEncoding::kCompact) {
+      auto records = ReadCompactFrame(stream, file_bytes);
+      if (!records.has_value()) {
         break;
       }
+      result.valid_bytes = static_cast<std::uint64_t>(stream.tellg());
+      result.last_replayed = records->back().lsn;
+      for (auto& record : *records) {
+        result.committed.push_back(std::move(record));
+      }
       continue;
     }
 
+    auto record = ReadNext(stream, file_bytes);
+    if (!record.has_value()) {
+      break;
+    }
+
+    result.valid_bytes = static_cast<std::uint64_t>(stream.tellg());
     result.last_replayed = record->lsn;
     result.committed.push_back(std::move(*record));
   }
 
+  // Nothing decoding right at the offset means it is not a record boundary we wrote, or the record
+  // there is torn; a scan from the start tells the two apart and never truncates less.
+  if (start_offset != 0 && result.committed.empty() && file_bytes > start_offset) {
+    return ScanSegment(wal_path, encoding);
+  }
   return result;
 }
 
-Lsn WalManager::next_lsn() const noexcept {
-  return next_lsn_;
+std::optional<Lsn> WalManager::FirstLsn(const std::filesystem::path& wal_path,
+                                        WalEncoding encoding) {
+  std::error_code size_error;
+  const auto file_bytes = std::filesystem::file_size(wal_path, size_error);
+  if (size_error) {
+    return std::nullopt;
+  }
+  std::ifstream stream(wal_path, std::ios::binary);
+  if (!stream) {
+    return std::nullopt;
+  }
+  if (encoding == WalEncoding::kCompact) {
+    const auto records = ReadCompactFrame(stream, file_bytes);
+    return records.has_value() ? std::optional<Lsn>(records->front().lsn) : std::nullopt;
+  }
+  const auto record = ReadNext(stream, file_bytes);
+  return record.has_value() ? std::optional<Lsn>(record->lsn) : std::nullopt;
 }
 
-std::uint32_t WalManager::ComputeRecordCrc(const WalRecord& record) {
-  const auto payload = BuildCrcPayload(record);
-  return storage::ComputeCrc32(payload);
+RepairReport WalManager::TruncateTorn(const std::filesystem::path& wal_path,
+                                      const ReplayResult& scan) {
+  RepairReport report{};
+  report.wal_path = wal_path;
+  report.last_valid_lsn = scan.last_replayed;
+  report.records_scanned = scan.committed.size();
+  report.valid_bytes = scan.valid_bytes;
+
+  if (scan.file_bytes <= scan.valid_bytes) {
+    return report;
+  }
+
+  const int file_descriptor = ::open(wal_path.c_str(), O_RDWR | O_CLOEXEC);
+  if (file_descriptor < 0) {
+    throw std::runtime_error("Failed to open WAL segment for tail repair");
+  }
+  const bool truncated = ::ftruncate(file_descriptor, static_cast<off_t>(scan.valid_bytes)) == 0 &&
+                         ::fsync(file_descriptor) == 0;
+  ::close(file_descriptor);
+  if (!truncated) {
+    throw std::runtime_error("Failed to truncate torn WAL tail");
+  }
+
+  report.truncated = true;
+  report.discarded_bytes = scan.file_bytes - scan.valid_bytes;
+  return report;
 }
 
 WalRecord WalManager::FromFlatBuffer(const wal_fb::WalRecord& fb_record) {
@@ -126,6 +632,12 @@ WalRecord WalManager::FromFlatBuffer(const wal_fb::WalRecord& fb_record) {
       payload.value.assign(reinterpret_cast<const std::byte*>(value->Data()),
                            reinterpret_cast<const std::byte*>(value->Data()) + value->size());
     }
+    if (const auto* value_ptr = upsert->value_ptr()) {
+      payload.value_ptr = SegmentPointer{.segment_id = value_ptr->segment_id(),
+                                         .offset = value_ptr->offset(),
+                                         .length = value_ptr->length()};
+    }
+    payload.value_kind = static_cast<ValueKind>(upsert->value_type());
     payload.ttl_epoch_seconds = upsert->ttl_epoch_seconds();
     record.upsert = std::move(payload);
   }
@@ -139,103 +651,44 @@ WalRecord WalManager::FromFlatBuffer(const wal_fb::WalRecord& fb_record) {
   return record;
 }
 
-std::optional<WalRecord> WalManager::ReadNext(std::ifstream& stream) {
+std::optional<WalRecord> WalManager::ReadNext(std::ifstream& stream, std::uint64_t file_bytes) {
   std::uint32_t size = 0;
   stream.read(reinterpret_cast<char*>(&size), sizeof(size));
   if (!stream) {
     return std::nullopt;
   }
 
-  std::vector<std::byte> buffer(size);
-  stream.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
-  if (!stream) {
+  // A torn size prefix can claim gigabytes; reject it before allocating.
+  const auto payload_offset = static_cast<std::uint64_t>(stream.tellg());
+  if (size == 0 || payload_offset + size + sizeof(std::uint32_t) > file_bytes) {
     return std::nullopt;
   }
 
-  flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
-  if (!wal_fb::VerifyWalRecordBuffer(verifier)) {
+  std::vector<std::byte> frame(sizeof(size) + size);
+  std::memcpy(frame.data(), &size, sizeof(size));
+  stream.read(reinterpret_cast<char*>(frame.data() + sizeof(size)),
+              static_cast<std::streamsize>(size));
+  std::uint32_t stored_crc = 0;
+  stream.read(reinterpret_cast<char*>(&stored_crc), sizeof(stored_crc));
+  if (!stream) {
     return std::nullopt;
   }
 
-  const auto* fb_record = wal_fb::GetWalRecord(buffer.data());
-  if (fb_record == nullptr) {
+  if (ComputeCrc32(frame) != stored_crc) {
     return std::nullopt;
   }
 
-  auto record = FromFlatBuffer(*fb_record);
-  const auto expected_crc = ComputeRecordCrc(record);
-  if (expected_crc != fb_record->crc()) {
+  flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(frame.data()), frame.size());
+  if (!wal_fb::VerifySizePrefixedWalRecordBuffer(verifier)) {
     return std::nullopt;
   }
 
-  return record;
-}
-
-bool WalManager::PersistRecord(const WalRecord& record) {
-  flatbuffers::FlatBufferBuilder builder;
-
-  flatbuffers::Offset<wal_fb::Upsert> upsert_offset;
-  flatbuffers::Offset<wal_fb::Tombstone> tombstone_offset;
-  flatbuffers::Offset<wal_fb::TxnMarker> marker_offset;
-
-  switch (record.type) {
-  case RecordType::kUpsert: {
-    if (record.upsert.has_value()) {
-      const auto& upsert = record.upsert.value();
-      const auto key_vec = builder.CreateVector(reinterpret_cast<const uint8_t*>(upsert.key.data()),
-                                                upsert.key.size());
-      const auto value_vec = builder.CreateVector(
-          reinterpret_cast<const uint8_t*>(upsert.value.data()), upsert.value.size());
-      flatbuffers::Offset<wal_fb::ValuePointer> value_ptr_offset{};
-      if (upsert.value_ptr.has_value()) {
-        const auto& ptr = upsert.value_ptr.value();
-        value_ptr_offset =
-            wal_fb::CreateValuePointer(builder, ptr.segment_id, ptr.offset, ptr.length);
-      }
-      upsert_offset =
-          wal_fb::CreateUpsert(builder, record.txn_id, key_vec, wal_fb::ValueKind::Bytes, value_vec,
-                               value_ptr_offset, upsert.ttl_epoch_seconds);
-    }
-    break;
-  }
-  case RecordType::kTombstone: {
-    if (record.tombstone_key.has_value()) {
-      const auto key_vec =
-          builder.CreateVector(reinterpret_cast<const uint8_t*>(record.tombstone_key->data()),
-                               record.tombstone_key->size());
-      tombstone_offset = wal_fb::CreateTombstone(builder, record.txn_id, key_vec);
-    }
-    break;
-  }
-  case RecordType::kTxnBegin:
-  case RecordType::kTxnCommit:
-  case RecordType::kTxnAbort:
-  case RecordType::kCheckpoint: {
-    marker_offset = wal_fb::CreateTxnMarker(builder, record.txn_id);
-    break;
-  }
-  }
-
-  const auto crc = ComputeRecordCrc(record);
-  const auto wal_offset =
-      wal_fb::CreateWalRecord(builder, static_cast<wal_fb::RecordType>(record.type), record.lsn,
-                              upsert_offset, tombstone_offset, marker_offset, crc);
-  builder.Finish(wal_offset, wal_fb::WalRecordIdentifier());
-
-  auto* const buffer_pointer = builder.GetBufferPointer();
-  const auto buffer_size = builder.GetSize();
-
-  std::ofstream out(wal_path_, std::ios::binary | std::ios::app);
-  if (!out) {
-    return false;
+  const auto* fb_record = wal_fb::GetSizePrefixedWalRecord(frame.data());
+  if (fb_record == nullptr) {
+    return std::nullopt;
   }
 
-  const auto size = static_cast<std::uint32_t>(buffer_size);
-  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
-  out.write(reinterpret_cast<const char*>(buffer_pointer),
-            static_cast<std::streamsize>(buffer_size));
-  out.flush();
-  return out.good();
+  return FromFlatBuffer(*fb_record);
 }
 
 } // namespace jubilant::storage::wal
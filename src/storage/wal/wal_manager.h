@@ -1,11 +1,23 @@
 #pragma once
 
+#include "storage/wal/compact_record.h"
 #include "storage/wal/wal_record.h"
 #include "wal_generated.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <filesystem>
+#include <flatbuffers/flatbuffers.h>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace jubilant::storage::wal {
@@ -13,27 +25,177 @@ namespace jubilant::storage::wal {
 struct ReplayResult {
   Lsn last_replayed{0};
   std::vector<WalRecord> committed;
+  // Byte offset, in the last segment scanned, just past the last record that decoded and passed
+  // its CRC. Anything between this offset and file_bytes is a torn or corrupt tail.
+  std::uint64_t valid_bytes{0};
+  std::uint64_t file_bytes{0};
 };
 
+// A record boundary in the log. lsn is the last LSN appended before it, so replaying from here
+// yields exactly the records numbered after lsn.
+struct WalPosition {
+  SegmentId segment{0};
+  std::uint64_t offset{0};
+  Lsn lsn{0};
+};
+
+// Outcome of scanning a WAL segment for its last valid record boundary. Open-time repair truncates
+// the segment to valid_bytes so later appends never land behind unreadable garbage.
+struct RepairReport {
+  std::filesystem::path wal_path;
+  bool truncated{false};
+  Lsn last_valid_lsn{0};
+  std::uint64_t records_scanned{0};
+  std::uint64_t valid_bytes{0};
+  std::uint64_t discarded_bytes{0};
+};
+
+// On-disk framing depends on the manifest's wal_schema. For kFlatBuffer each record is the
+// size-prefixed FlatBuffer exactly as FinishSizePrefixed lays it out ({u32 size}{payload}),
+// followed by a u32 CRC32 computed over those finished bytes. kCompact uses the varint frames
+// described in compact_record.h.
+//
+// The log is split into wal-NNNNNN.log segments. Appends go to the highest one; Rollover() seals it
+// and starts the next, and ReleaseSegmentsThrough() deletes sealed segments a checkpoint covers.
+//
+// Appends are serialized internally and may come from any thread. Durability is tracked as the
+// highest LSN known to be on stable storage: Flush() syncs inline, while the optional group-commit
+// flusher syncs once per latency window on behalf of every WaitDurable() caller in that window.
 class WalManager {
 public:
-  explicit WalManager(std::filesystem::path base_dir);
+  // checkpoint is the position the last checkpoint recorded. Open-time repair scans the active
+  // segment from there rather than from its start, and sealed segments are bounded by reading the
+  // first record of their successor, so opening costs the WAL written since that checkpoint.
+  explicit WalManager(std::filesystem::path base_dir,
+                      WalEncoding encoding = WalEncoding::kFlatBuffer, WalPosition checkpoint = {});
+  ~WalManager();
+
+  WalManager(const WalManager&) = delete;
+  WalManager& operator=(const WalManager&) = delete;
+  WalManager(WalManager&&) = delete;
+  WalManager& operator=(WalManager&&) = delete;
 
   [[nodiscard]] Lsn Append(const WalRecord& record);
+
+  // Encode straight from caller-owned views into the writer's reusable builder. Once the builder
+  // has grown to the working-set record size these paths perform no heap allocations.
+  [[nodiscard]] Lsn AppendMarker(RecordType type, std::uint64_t txn_id);
+  [[nodiscard]] Lsn AppendUpsert(std::uint64_t txn_id, std::string_view key,
+                                 std::span<const std::byte> value, std::uint64_t ttl_epoch_seconds,
+                                 const std::optional<SegmentPointer>& value_ptr = std::nullopt,
+                                 ValueKind value_kind = ValueKind::kBytes);
+  [[nodiscard]] Lsn AppendTombstone(std::uint64_t txn_id, std::string_view key);
+
+  // Logs TxnBegin, every op, and TxnCommit as consecutive LSNs and returns the commit LSN. Under
+  // kCompact the whole transaction shares a single frame, header, and CRC.
+  [[nodiscard]] Lsn AppendTransaction(std::uint64_t txn_id, std::span<const WalOp> ops);
+
+  // Syncs and seals the active segment, then opens the next one with a Checkpoint marker whose
+  // txn_id carries checkpoint_lsn. Returns the marker's LSN. Throws when the sync or open fails.
+  Lsn Rollover(Lsn checkpoint_lsn);
+  // Deletes sealed segments whose records all sit at or below lsn; returns how many it removed.
+  std::size_t ReleaseSegmentsThrough(Lsn lsn);
+
+  // Syncs everything appended so far and advances durable_lsn(). Throws when fdatasync fails.
   void Flush();
-  [[nodiscard]] ReplayResult Replay() const;
-  [[nodiscard]] Lsn next_lsn() const noexcept;
+
+  // Runs at the start of every Flush(), before the WAL itself is synced. The server uses it to sync
+  // the value log so a logged SegmentPointer is never durable ahead of its bytes. Set it before
+  // starting group commit; a throwing hook fails the Flush().
+  void SetPreSyncHook(std::function<void()> hook);
+
+  // The flusher wakes every max_latency, syncs once if anything new was appended, and releases
+  // every WaitDurable() caller that the sync covered. Stopping performs a final sync.
+  void StartGroupCommit(std::chrono::milliseconds max_latency);
+  void StopGroupCommit();
+
+  // Blocks until lsn is durable. Without a running flusher the caller syncs inline. Returns false
+  // when the flusher stopped or failed to sync before covering lsn.
+  [[nodiscard]] bool WaitDurable(Lsn lsn);
+  [[nodiscard]] Lsn durable_lsn() const;
+
+  // Scans the segments from `from` onward in order, stopping at the first record that fails
+  // verification. When from's segment was already released, everything in it preceded from, so
+  // replay starts at the next segment. The default replays the whole log.
+  [[nodiscard]] ReplayResult Replay(WalPosition from = {}) const;
+  [[nodiscard]] Lsn next_lsn() const;
+  // Where the next append will land.
+  [[nodiscard]] WalPosition end_position() const;
+  [[nodiscard]] SegmentId active_segment() const;
+  // Bytes appended to the active segment since it was opened.
+  [[nodiscard]] std::uint64_t active_segment_bytes() const noexcept;
+  // Bytes appended through this manager, across rollovers. The difference between two readings is
+  // the WAL volume written in between.
+  [[nodiscard]] std::uint64_t appended_bytes() const noexcept;
+  [[nodiscard]] const RepairReport& last_repair() const noexcept;
+  [[nodiscard]] WalEncoding encoding() const noexcept;
+
+  // Offline entry point for `jubectl repair`: scans the active WAL segment under base_dir and
+  // truncates any torn tail without constructing a writer.
+  [[nodiscard]] static RepairReport RepairTail(const std::filesystem::path& base_dir,
+                                               WalEncoding encoding = WalEncoding::kFlatBuffer);
 
 private:
-  [[nodiscard]] static std::uint32_t ComputeRecordCrc(const WalRecord& record);
+  static constexpr std::size_t kInitialBuilderBytes = 4096;
+
+  // Segment ids present under dir, ascending.
+  [[nodiscard]] static std::vector<SegmentId> ListSegments(const std::filesystem::path& dir);
+  // Scans from start_offset, or from the segment's start when start_offset does not land on a
+  // record.
+  [[nodiscard]] static ReplayResult ScanSegment(const std::filesystem::path& wal_path,
+                                                WalEncoding encoding,
+                                                std::uint64_t start_offset = 0);
+  // LSN of the segment's first record, read without scanning the rest.
+  [[nodiscard]] static std::optional<Lsn> FirstLsn(const std::filesystem::path& wal_path,
+                                                   WalEncoding encoding);
+  [[nodiscard]] static RepairReport TruncateTorn(const std::filesystem::path& wal_path,
+                                                 const ReplayResult& scan);
   [[nodiscard]] static WalRecord FromFlatBuffer(const ::jubilant::wal::WalRecord& fb_record);
-  [[nodiscard]] static std::optional<WalRecord> ReadNext(std::ifstream& stream);
-  bool PersistRecord(const WalRecord& record);
+  [[nodiscard]] static std::optional<WalRecord> ReadNext(std::ifstream& stream,
+                                                          std::uint64_t file_bytes);
+  Lsn AppendMarkerLocked(RecordType type, std::uint64_t txn_id);
+  Lsn AppendUpsertLocked(std::uint64_t txn_id, std::string_view key,
+                         std::span<const std::byte> value, std::uint64_t ttl_epoch_seconds,
+                         const std::optional<SegmentPointer>& value_ptr, ValueKind value_kind);
+  Lsn AppendTombstoneLocked(std::uint64_t txn_id, std::string_view key);
+  Lsn FinishAndWrite(RecordType type, flatbuffers::Offset<::jubilant::wal::Upsert> upsert,
+                     flatbuffers::Offset<::jubilant::wal::Tombstone> tombstone,
+                     flatbuffers::Offset<::jubilant::wal::TxnMarker> marker);
+  Lsn WriteCompactFrame();
+  void MarkDurable(Lsn lsn);
+  void GroupCommitLoop();
 
   std::filesystem::path wal_dir_;
   std::filesystem::path wal_path_;
+  RepairReport last_repair_{};
+  WalEncoding encoding_{WalEncoding::kFlatBuffer};
+  int wal_fd_{-1};
+
+  // Guards the encoders, next_lsn_, the segment bookkeeping, and the append descriptor's write
+  // position.
+  mutable std::mutex append_mutex_;
   Lsn next_lsn_{1};
-  std::vector<WalRecord> buffered_records_;
+  SegmentId active_segment_{0};
+  // Sealed segment id -> last LSN it holds.
+  std::map<SegmentId, Lsn> sealed_segments_;
+  std::atomic<std::uint64_t> active_bytes_{0};
+  std::atomic<std::uint64_t> appended_bytes_{0};
+  // Held around fdatasync so Rollover() cannot close the descriptor a Flush() is syncing.
+  std::mutex sync_mutex_;
+  std::atomic<Lsn> appended_lsn_{0};
+  flatbuffers::FlatBufferBuilder builder_{kInitialBuilderBytes};
+  CompactFrameEncoder compact_{kInitialBuilderBytes};
+
+  mutable std::mutex durable_mutex_;
+  std::condition_variable durable_cv_;
+  std::condition_variable flusher_cv_;
+  Lsn durable_lsn_{0};
+  bool group_commit_running_{false};
+  bool stop_group_commit_{false};
+  bool sync_failed_{false};
+  std::chrono::milliseconds group_commit_latency_{0};
+  std::thread group_commit_thread_;
+  std::function<void()> pre_sync_hook_;
 };
 
 } // namespace jubilant::storage::wal
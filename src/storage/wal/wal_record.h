@@ -5,7 +5,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace jubilant::storage::wal {
@@ -22,15 +24,36 @@ enum class RecordType : std::uint8_t {
   kCheckpoint = 5,
 };
 
+// Logical type of an upsert's bytes so replay can rebuild the stored record. Values mirror the
+// FlatBuffer ValueKind enum in wal.fbs.
+enum class ValueKind : std::uint8_t {
+  kBytes = 0,
+  kString = 1,
+  kInt64 = 2,
+};
+
 struct UpsertPayload {
   std::string key;
   std::vector<std::byte> value;
-  // External value pointer when the payload exceeds manifest.inline_threshold. The pointer layout
+  ValueKind value_kind{ValueKind::kBytes};
+  // External value pointer when the payload exceeds the manifest's inline threshold for the key
+  // (inline_threshold, or the longest matching inline_rules prefix). The pointer layout
   // matches storage::SegmentPointer {segment_id, offset, length}.
   std::optional<SegmentPointer> value_ptr;
   std::uint64_t ttl_epoch_seconds{0};
 };
 
+// Borrowed view of one mutation inside a transaction batch. Only kUpsert and kTombstone are valid
+// here; AppendTransaction supplies the begin/commit markers itself.
+struct WalOp {
+  RecordType type{RecordType::kUpsert};
+  std::string_view key;
+  std::span<const std::byte> value;
+  ValueKind value_kind{ValueKind::kBytes};
+  std::optional<SegmentPointer> value_ptr;
+  std::uint64_t ttl_epoch_seconds{0};
+};
+
 struct WalRecord {
   RecordType type{RecordType::kTxnBegin};
   std::uint64_t txn_id{0};
@@ -39,4 +62,40 @@ struct WalRecord {
   Lsn lsn{0};
 };
 
+// On-disk WAL encodings, selected per database through ManifestRecord::wal_schema.
+// kFlatBuffer ("wal-v2") frames every record as its own size-prefixed FlatBuffer followed by a CRC
+// trailer.
+// kCompact ("wal-compact-v1") packs varint-encoded operations, batching a whole transaction under
+// one length header and one CRC.
+enum class WalEncoding : std::uint8_t {
+  kFlatBuffer = 0,
+  kCompact = 1,
+};
+
+inline constexpr std::string_view kWalSchemaFlatBuffer = "wal-v2";
+inline constexpr std::string_view kWalSchemaCompact = "wal-compact-v1";
+// The original FlatBuffer framing, with the CRC inside the table and no trailer. Its frames would
+// look torn to kFlatBuffer's open-time repair, which would truncate committed records, so a
+// database that names it is refused instead of opened. Manifests naming it still load, so callers
+// can report why rather than mistake the database for a new one.
+inline constexpr std::string_view kWalSchemaEmbeddedCrc = "wal-v1";
+
+[[nodiscard]] inline bool IsRetiredWalSchema(std::string_view schema) {
+  return schema == kWalSchemaEmbeddedCrc;
+}
+
+[[nodiscard]] inline std::optional<WalEncoding> ParseWalSchema(std::string_view schema) {
+  if (schema == kWalSchemaFlatBuffer) {
+    return WalEncoding::kFlatBuffer;
+  }
+  if (schema == kWalSchemaCompact) {
+    return WalEncoding::kCompact;
+  }
+  return std::nullopt;
+}
+
+[[nodiscard]] inline std::string_view WalSchemaName(WalEncoding encoding) {
+  return encoding == WalEncoding::kCompact ? kWalSchemaCompact : kWalSchemaFlatBuffer;
+}
+
 } // namespace jubilant::storage::wal
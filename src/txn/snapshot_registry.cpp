@@ -0,0 +1,61 @@
+#include "txn/snapshot_registry.h"
+
+#include <algorithm>
+
+namespace jubilant::txn {
+
+std::uint64_t SnapshotRegistry::BeginCommit() {
+  std::scoped_lock guard(mutex_);
+  // Nothing past published_ was logged when the commit registered, so its LSN lies above it.
+  const auto ticket = next_ticket_++;
+  in_flight_.emplace(ticket, published_ + 1);
+  return ticket;
+}
+
+void SnapshotRegistry::EndCommit(std::uint64_t ticket, std::optional<storage::Lsn> lsn) {
+  std::scoped_lock guard(mutex_);
+  in_flight_.erase(ticket);
+  if (lsn.has_value()) {
+    published_ = std::max(published_, *lsn);
+  }
+  AdvanceLocked();
+}
+
+storage::Lsn SnapshotRegistry::Open() {
+  std::scoped_lock guard(mutex_);
+  snapshots_.insert(visible_);
+  return visible_;
+}
+
+void SnapshotRegistry::Close(storage::Lsn snapshot) {
+  std::scoped_lock guard(mutex_);
+  if (const auto iter = snapshots_.find(snapshot); iter != snapshots_.end()) {
+    snapshots_.erase(iter);
+  }
+}
+
+storage::Lsn SnapshotRegistry::visible_lsn() const {
+  std::scoped_lock guard(mutex_);
+  return visible_;
+}
+
+storage::Lsn SnapshotRegistry::horizon() const {
+  std::scoped_lock guard(mutex_);
+  return snapshots_.empty() ? visible_ : *snapshots_.begin();
+}
+
+std::size_t SnapshotRegistry::open_snapshots() const {
+  std::scoped_lock guard(mutex_);
+  return snapshots_.size();
+}
+
+void SnapshotRegistry::AdvanceLocked() {
+  auto candidate = published_;
+  if (!in_flight_.empty()) {
+    candidate = std::min(candidate, in_flight_.begin()->second - 1);
+  }
+  // Snapshots already opened at visible_ rely on it, so it never moves backwards.
+  visible_ = std::max(visible_, candidate);
+}
+
+} // namespace jubilant::txn
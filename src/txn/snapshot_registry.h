@@ -0,0 +1,47 @@
+#pragma once
+
+#include "storage/storage_common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+
+namespace jubilant::txn {
+
+// Decides which commit LSNs snapshot reads may see. A commit registers before its WAL append and
+// finishes once its versions carry the commit LSN; the visible LSN only moves past commits that
+// have finished, so a snapshot never sees a commit while missing an earlier one.
+class SnapshotRegistry {
+public:
+  // Returns the ticket EndCommit takes. Call before the commit's WAL append.
+  [[nodiscard]] std::uint64_t BeginCommit();
+  // lsn is the commit's LSN once its versions are stamped, or nullopt when it was never logged.
+  void EndCommit(std::uint64_t ticket, std::optional<storage::Lsn> lsn);
+
+  // Opens a snapshot at the visible LSN. Every Open needs a matching Close.
+  [[nodiscard]] storage::Lsn Open();
+  void Close(storage::Lsn snapshot);
+
+  // Every commit at or below it has been stamped.
+  [[nodiscard]] storage::Lsn visible_lsn() const;
+  // The oldest LSN an open or future snapshot reads at; older replaced images are garbage.
+  [[nodiscard]] storage::Lsn horizon() const;
+  [[nodiscard]] std::size_t open_snapshots() const;
+
+private:
+  void AdvanceLocked();
+
+  mutable std::mutex mutex_;
+  std::uint64_t next_ticket_{0};
+  // Ticket -> the lowest LSN the commit can be assigned. Tickets and floors rise together, so the
+  // first entry holds the lowest floor.
+  std::map<std::uint64_t, storage::Lsn> in_flight_;
+  storage::Lsn published_{0};
+  storage::Lsn visible_{0};
+  std::multiset<storage::Lsn> snapshots_;
+};
+
+} // namespace jubilant::txn
@@ -10,7 +10,9 @@
 
 namespace jubilant::txn {
 
-enum class TransactionState : std::uint8_t { kPending, kCommitted, kAborted };
+// kDurabilityFailed: the writes were applied, and possibly logged, but the WAL could not confirm
+// them durable. They are not rolled back, so the outcome after a crash is unknown.
+enum class TransactionState : std::uint8_t { kPending, kCommitted, kAborted, kDurabilityFailed };
 
 class TransactionContext {
 public:
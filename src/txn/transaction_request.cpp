@@ -8,6 +8,11 @@ bool TransactionRequest::Valid() const {
   if (operations.empty()) {
     return false;
   }
+  if (snapshot && !std::ranges::all_of(operations, [](const Operation& operation) {
+        return operation.type == OperationType::kGet;
+      })) {
+    return false;
+  }
 
   return std::ranges::all_of(operations, [](const Operation& operation) {
     if (operation.key.empty()) {
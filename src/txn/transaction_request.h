@@ -3,6 +3,7 @@
 #include "storage/btree/btree.h"
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -17,9 +18,29 @@ struct Operation {
   std::optional<storage::btree::Record> value;
 };
 
+// How long a committing transaction waits on the WAL before it is acknowledged.
+enum class DurabilityClass : std::uint8_t {
+  // Acknowledged once enqueued; its WAL records reach disk with the next group-commit sync.
+  kAsync,
+  // Acknowledged after the group-commit sync that covers its commit record.
+  kGroup,
+  // Acknowledged after a dedicated fdatasync issued on its behalf.
+  kSync,
+};
+
 struct TransactionRequest {
   std::uint64_t id{0};
   std::vector<Operation> operations;
+  DurabilityClass durability{DurabilityClass::kGroup};
+  // Reads leave value-log backed values as ValueLogRefs so the network layer can stream them from
+  // the segment file instead of materializing them.
+  bool raw_values{false};
+  // Reads at a consistent snapshot without taking key locks, so writers never stall them. Only
+  // read-only transactions may ask for it.
+  bool snapshot{false};
+  // Holds on the chunked uploads already streamed into the value log, so GC leaves their segments
+  // alone until the request has been applied or dropped.
+  std::vector<std::shared_ptr<const void>> value_holds;
 
   [[nodiscard]] bool Valid() const;
 };
@@ -3,11 +3,17 @@
 #include "storage/ttl/ttl_clock.h"
 #include "storage/vlog/value_log.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <gtest/gtest.h>
+#include <limits>
 #include <string>
+#include <thread>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -145,6 +151,136 @@ TEST(BTreeTest, NonExpiredRecordsRemainVisible) {
   }
 }
 
+TEST(BTreeTest, ListsAndErasesOnlyExpiredKeysAcrossReload) {
+  const auto dir = TempDir("jubilant-btree-ttl-index");
+  const jubilant::storage::ttl::TtlClock clock{jubilant::storage::ttl::TtlClock::CalibrateNow()};
+  const auto now = clock.WallNowSeconds();
+  {
+    Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+    ValueLog vlog(dir / "vlog");
+    BTree tree(BTree::Config{.pager = &pager,
+                             .value_log = &vlog,
+                             .inline_threshold = 128U,
+                             .root_hint = 0,
+                             .ttl_clock = &clock});
+    const std::vector<std::pair<std::string, std::uint64_t>> ttls{
+        {"late", now - 1}, {"early", now - 5}, {"live", now + 60}, {"forever", 0},
+        {"renewed", now - 3}};
+    for (const auto& [key, ttl] : ttls) {
+      Record record{};
+      record.value = std::string{"value"};
+      record.metadata.ttl_epoch_seconds = ttl;
+      tree.Insert(key, record);
+    }
+    Record renewed{};
+    renewed.value = std::string{"value"};
+    renewed.metadata.ttl_epoch_seconds = now + 60;
+    tree.Insert("renewed", renewed);
+
+    EXPECT_EQ(tree.expiring_count(), 4U);
+    EXPECT_EQ(tree.ExpiredKeys(1), std::vector<std::string>{"early"});
+  }
+
+  // The index is rebuilt from the leaves' TTLs.
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree reloaded(BTree::Config{.pager = &pager,
+                               .value_log = &vlog,
+                               .inline_threshold = 128U,
+                               .root_hint = 0,
+                               .ttl_clock = &clock});
+  EXPECT_EQ(reloaded.ExpiredKeys(10), (std::vector<std::string>{"early", "late"}));
+  const std::vector<std::string> candidates{"live", "forever", "early", "late", "missing"};
+  EXPECT_EQ(reloaded.EraseExpired(candidates), (std::vector<std::string>{"early", "late"}));
+  EXPECT_TRUE(reloaded.ExpiredKeys(10).empty());
+  EXPECT_EQ(reloaded.expiring_count(), 2U);
+  EXPECT_EQ(reloaded.size(), 3U);
+}
+
+TEST(BTreeTest, LeavesStoreTtlsOnlyForExpiringKeys) {
+  const auto dir = TempDir("jubilant-btree-ttl-layout");
+  const std::uint64_t soon = 1'700'000'000;
+  const std::uint64_t far = soon + (1ULL << 40U);
+  std::size_t plain_page_count = 0;
+  {
+    Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+    ValueLog vlog(dir / "vlog");
+    BTree tree(BTree::Config{
+        .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+    Record record{};
+    record.value = std::int64_t{7};
+    for (int i = 0; i < 400; ++i) {
+      tree.Insert("plain-" + std::to_string(1000 + i), record);
+    }
+    plain_page_count = pager.page_count();
+
+    record.metadata.ttl_epoch_seconds = far;
+    tree.Insert("zz-far", record);
+    record.metadata.ttl_epoch_seconds = soon;
+    tree.Insert("zz-soon", record);
+  }
+
+  // 400 entries of 29 bytes fit on three 4 KiB pages; with a 64-bit TTL each they took four.
+  EXPECT_EQ(plain_page_count, 3U);
+
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree reloaded(BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  EXPECT_EQ(reloaded.size(), 402U);
+  EXPECT_EQ(reloaded.expiring_count(), 2U);
+  const auto plain = reloaded.Find("plain-1000");
+  ASSERT_TRUE(plain.has_value());
+  EXPECT_EQ(plain->metadata.ttl_epoch_seconds, 0U);
+  // The two TTLs lie too far apart for 32-bit deltas, so their page falls back to 64-bit ones.
+  const auto far_record = reloaded.Find("zz-far");
+  const auto soon_record = reloaded.Find("zz-soon");
+  ASSERT_TRUE(far_record.has_value() && soon_record.has_value());
+  EXPECT_EQ(far_record->metadata.ttl_epoch_seconds, far);
+  EXPECT_EQ(soon_record->metadata.ttl_epoch_seconds, soon);
+}
+
+TEST(BTreeTest, ReadsLegacyLeavesWithFullWidthTtls) {
+  const auto dir = TempDir("jubilant-btree-legacy-leaf");
+  {
+    Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+    jubilant::storage::Page page{};
+    page.id = pager.Allocate(jubilant::storage::PageType::kLeaf);
+    page.type = jubilant::storage::PageType::kLeaf;
+    page.payload.assign(pager.payload_size(), std::byte{0});
+    // Header: is_leaf, padding, entry_count, format 0 (legacy), padding, next_leaf.
+    page.payload[0] = std::byte{1};
+    const std::uint16_t entry_count = 1;
+    std::memcpy(page.payload.data() + 2, &entry_count, sizeof(entry_count));
+    const auto no_next = std::numeric_limits<std::uint64_t>::max();
+    std::memcpy(page.payload.data() + 8, &no_next, sizeof(no_next));
+    // Entry: key_size, tag (inline string), u64 TTL, u64 value_len, key, value.
+    std::size_t offset = 16;
+    const std::uint16_t key_size = 3;
+    const std::uint64_t ttl = 4'000'000'000ULL;
+    const std::uint64_t value_len = 2;
+    std::memcpy(page.payload.data() + offset, &key_size, sizeof(key_size));
+    offset += sizeof(key_size);
+    page.payload[offset++] = std::byte{1};
+    std::memcpy(page.payload.data() + offset, &ttl, sizeof(ttl));
+    offset += sizeof(ttl);
+    std::memcpy(page.payload.data() + offset, &value_len, sizeof(value_len));
+    offset += sizeof(value_len);
+    std::memcpy(page.payload.data() + offset, "oldhi", 5);
+    pager.Write(page);
+  }
+
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree tree(BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  const auto found = tree.Find("old");
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(std::get<std::string>(found->value), "hi");
+  EXPECT_EQ(found->metadata.ttl_epoch_seconds, 4'000'000'000ULL);
+  EXPECT_EQ(tree.expiring_count(), 1U);
+}
+
 TEST(BTreeTest, PersistsAcrossReload) {
   const auto dir = TempDir("jubilant-btree-reload");
   {
@@ -185,3 +321,450 @@ TEST(BTreeTest, EraseRemovesKeysAndReportsResult) {
   EXPECT_FALSE(tree.Find("key").has_value());
   EXPECT_FALSE(tree.Erase("key"));
 }
+
+TEST(BTreeTest, GcRelocatesLiveValuesAndRetiresSparseSegments) {
+  const auto dir = TempDir("jubilant-btree-vlog-gc");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree tree(
+      BTree::Config{.pager = &pager, .value_log = &vlog, .inline_threshold = 32U, .root_hint = 0});
+
+  Record keep{};
+  keep.value = std::string(200, 'k');
+  tree.Insert("keep", keep);
+  for (char fill = 'a'; fill <= 'e'; ++fill) {
+    Record churn{};
+    churn.value = std::string(200, fill);
+    tree.Insert("churn", churn);
+  }
+  EXPECT_TRUE(tree.Erase("churn"));
+
+  const auto before = vlog.usage();
+  ASSERT_EQ(before.size(), 1U);
+  EXPECT_LT(before.front().live_ratio(), 0.5);
+
+  const auto report = tree.CollectValueLogGarbage({.max_live_ratio = 0.5, .max_segments = 4});
+  ASSERT_EQ(report.retired_segments.size(), 1U);
+  EXPECT_EQ(report.retired_segments.front(), 0U);
+  EXPECT_EQ(report.records_relocated, 1U);
+
+  // The victim survives until a checkpoint releases it; the relocated copy is readable either way.
+  const auto old_segment = jubilant::storage::ValueLogSegmentPath(dir / "vlog", 0);
+  EXPECT_TRUE(std::filesystem::exists(old_segment));
+  EXPECT_EQ(vlog.ReleaseRetiredSegments(), 1U);
+  EXPECT_FALSE(std::filesystem::exists(old_segment));
+
+  const auto found = tree.Find("keep");
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(std::get<std::string>(found->value), std::string(200, 'k'));
+
+  const auto after = vlog.usage();
+  ASSERT_EQ(after.size(), 1U);
+  EXPECT_EQ(after.front().segment_id, 1U);
+  EXPECT_DOUBLE_EQ(after.front().live_ratio(), 1.0);
+}
+
+TEST(BTreeTest, GcKeepsValuesWrittenWhileItCopies) {
+  const auto dir = TempDir("jubilant-btree-vlog-gc-race");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog", 64U * 1024U);
+  BTree tree(
+      BTree::Config{.pager = &pager, .value_log = &vlog, .inline_threshold = 32U, .root_hint = 0});
+
+  constexpr int kWriters = 4;
+  constexpr int kKeysPerWriter = 8;
+  constexpr int kRounds = 40;
+  const auto key_for = [](int writer, int key) {
+    return "w" + std::to_string(writer) + ":" + std::to_string(key);
+  };
+  const auto value_for = [](int round) {
+    return std::string(512, static_cast<char>('a' + (round % 26)));
+  };
+
+  // Writers overwrite their keys while passes copy and repoint; a write that lands between a
+  // pass's copy and its repoint must not be replaced by the stale copy.
+  std::atomic<bool> done{false};
+  std::thread collector([&]() {
+    while (!done.load()) {
+      (void)tree.CollectValueLogGarbage({.max_live_ratio = 0.9, .max_segments = 4});
+      (void)vlog.ReleaseRetiredSegments();
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int writer = 0; writer < kWriters; ++writer) {
+    writers.emplace_back([&, writer]() {
+      for (int round = 0; round < kRounds; ++round) {
+        for (int key = 0; key < kKeysPerWriter; ++key) {
+          Record record{};
+          record.value = value_for(round);
+          tree.Insert(key_for(writer, key), record);
+        }
+      }
+    });
+  }
+  for (auto& thread : writers) {
+    thread.join();
+  }
+  done = true;
+  collector.join();
+
+  (void)tree.CollectValueLogGarbage({.max_live_ratio = 0.9, .max_segments = 64});
+  (void)vlog.ReleaseRetiredSegments();
+  for (int writer = 0; writer < kWriters; ++writer) {
+    for (int key = 0; key < kKeysPerWriter; ++key) {
+      const auto found = tree.Find(key_for(writer, key));
+      ASSERT_TRUE(found.has_value());
+      if (!found.has_value()) {
+        return;
+      }
+      EXPECT_EQ(std::get<std::string>(found->value), value_for(kRounds - 1));
+    }
+  }
+}
+
+TEST(BTreeTest, InlineRulesOverrideThresholdPerPrefix) {
+  const auto dir = TempDir("jubilant-btree-inline-rules");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree tree(BTree::Config{.pager = &pager,
+                           .value_log = &vlog,
+                           .inline_threshold = 128U,
+                           .inline_rules = {{.prefix = "blob:", .threshold = 16U},
+                                            {.prefix = "blob:meta:", .threshold = 256U}},
+                           .root_hint = 0});
+  EXPECT_EQ(tree.InlineThresholdFor("user:1"), 128U);
+  EXPECT_EQ(tree.InlineThresholdFor("blob:1"), 16U);
+  EXPECT_EQ(tree.InlineThresholdFor("blob:meta:1"), 256U);
+
+  Record medium{};
+  medium.value = std::string(64, 'm');
+  EXPECT_FALSE(tree.SpillPayloadFor("user:1", medium).has_value());
+  EXPECT_FALSE(tree.SpillPayloadFor("blob:meta:1", medium).has_value());
+  EXPECT_TRUE(tree.SpillPayloadFor("blob:1", medium).has_value());
+
+  tree.Insert("blob:1", medium);
+  tree.Insert("user:1", medium);
+  const auto stored = tree.FindStored("blob:1");
+  ASSERT_TRUE(stored.has_value());
+  EXPECT_TRUE(std::holds_alternative<jubilant::storage::btree::ValueLogRef>(stored->value));
+  const auto inline_stored = tree.FindStored("user:1");
+  ASSERT_TRUE(inline_stored.has_value());
+  EXPECT_TRUE(std::holds_alternative<std::string>(inline_stored->value));
+}
+
+TEST(BTreeTest, RecommendsInlineThresholdFromReadHeavyPrefixes) {
+  const auto dir = TempDir("jubilant-btree-inline-report");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree tree(
+      BTree::Config{.pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+
+  // "user:" values are read far more often than written; "log:" values are written and forgotten.
+  Record profile{};
+  profile.value = std::string(400, 'p');
+  Record entry{};
+  entry.value = std::string(400, 'l');
+  for (int i = 0; i < 4; ++i) {
+    tree.Insert("user:" + std::to_string(i), profile);
+    tree.Insert("log:" + std::to_string(i), entry);
+    for (int read = 0; read < 3; ++read) {
+      EXPECT_TRUE(tree.Find("user:" + std::to_string(i)).has_value());
+    }
+  }
+  tree.Insert("plain", entry);
+
+  const auto report = tree.InlineThresholdReport();
+  ASSERT_EQ(report.size(), 3U);
+  EXPECT_EQ(report[0].prefix, "");
+  EXPECT_EQ(report[1].prefix, "log:");
+  EXPECT_EQ(report[1].writes, 4U);
+  EXPECT_EQ(report[1].reads, 0U);
+  EXPECT_EQ(report[1].recommended_threshold,
+            jubilant::storage::btree::ValueSizeStats::kMinRecommendedThreshold);
+  EXPECT_EQ(report[2].prefix, "user:");
+  EXPECT_EQ(report[2].writes, 4U);
+  EXPECT_EQ(report[2].reads, 12U);
+  EXPECT_EQ(report[2].recommended_threshold, 512U);
+  EXPECT_EQ(report[2].histogram.writes[jubilant::storage::btree::ValueSizeStats::BucketFor(400)],
+            4U);
+}
+
+TEST(BTreeTest, ValueSizeStatsCountEveryConcurrentRecordAndFoldExtraPrefixes) {
+  using jubilant::storage::btree::ValueSizeStats;
+  ValueSizeStats stats;
+
+  // Every thread hits the same prefix, the case a per-prefix lock would serialize.
+  constexpr int kThreads = 4;
+  constexpr int kRecordsPerThread = 5000;
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([&stats, thread]() {
+      for (int i = 0; i < kRecordsPerThread; ++i) {
+        stats.RecordRead("user:" + std::to_string(thread), 300);
+        if (i % 10 == 0) {
+          stats.RecordWrite("user:" + std::to_string(i), 300);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Past the cap, new prefixes count under "".
+  for (std::size_t i = 0; i < ValueSizeStats::kMaxPrefixes + 10; ++i) {
+    stats.RecordWrite("p" + std::to_string(i) + ":key", 8);
+  }
+
+  const auto report = stats.Report(1024);
+  ASSERT_EQ(report.size(), ValueSizeStats::kMaxPrefixes + 1);
+  EXPECT_EQ(report.front().prefix, "");
+  EXPECT_EQ(report.front().writes, 11U);
+  const auto user = std::find_if(report.begin(), report.end(),
+                                 [](const auto& entry) { return entry.prefix == "user:"; });
+  ASSERT_NE(user, report.end());
+  EXPECT_EQ(user->reads, static_cast<std::uint64_t>(kThreads * kRecordsPerThread));
+  EXPECT_EQ(user->writes, static_cast<std::uint64_t>(kThreads * kRecordsPerThread / 10));
+  EXPECT_EQ(user->histogram.reads[ValueSizeStats::BucketFor(300)], user->reads);
+}
+
+TEST(BTreeTest, CaptureLetsWritesResumeOnceLeavesAreLaidOut) {
+  const auto dir = TempDir("jubilant-btree-capture-resume");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  BTree tree(BTree::Config{.pager = &pager,
+                           .value_log = &vlog,
+                           .inline_threshold = 128U,
+                           .defer_page_writes = true});
+  for (int i = 0; i < 60; ++i) {
+    Record record{};
+    record.value = std::string(100, 'e');
+    tree.Insert("key-" + std::to_string(1000 + i), record);
+  }
+
+  // Writing from the callback would deadlock if the shards were still latched for encoding.
+  bool resumed = false;
+  const auto dirty = tree.CaptureDirtyPages(1, [&]() {
+    Record late{};
+    late.value = std::string("late");
+    tree.Insert("late", late);
+    resumed = true;
+  });
+  EXPECT_TRUE(resumed);
+  EXPECT_GE(dirty.pages.size(), 2U);
+
+  // The write landed after the layout, so it waits for the next capture.
+  tree.MarkFlushed(dirty);
+  EXPECT_TRUE(tree.has_unflushed_changes());
+  EXPECT_TRUE(tree.Find("late").has_value());
+}
+
+TEST(BTreeTest, ShadowPagingNeverOverwritesThePublishedTree) {
+  const auto dir = TempDir("jubilant-btree-shadow");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  const auto config = [&](jubilant::storage::PageId root) {
+    return BTree::Config{.pager = &pager,
+                         .value_log = &vlog,
+                         .inline_threshold = 128U,
+                         .root_hint = root,
+                         .defer_page_writes = true};
+  };
+  const auto checkpoint = [&](BTree& tree, bool publish) {
+    auto dirty = tree.CaptureDirtyPages(1);
+    for (const auto& page : dirty.pages) {
+      pager.Write(page);
+    }
+    if (publish) {
+      tree.MarkFlushed(dirty);
+    }
+    return dirty;
+  };
+  const auto value_of = [](BTree& tree, const std::string& key) {
+    const auto found = tree.Find(key);
+    return found.has_value() ? std::get<std::string>(found->value) : std::string{};
+  };
+
+  BTree tree(config(0));
+  for (int i = 0; i < 120; ++i) {
+    Record record{};
+    record.value = std::string(100, 'a');
+    tree.Insert("key-" + std::to_string(1000 + i), record);
+  }
+  const auto first = checkpoint(tree, true);
+  ASSERT_GE(first.pages.size(), 3U);
+
+  // Changing the last leaf moves every leaf before it; none lands on a page the first tree uses.
+  Record updated{};
+  updated.value = std::string(100, 'b');
+  tree.Insert("key-1119", updated);
+  const auto second = checkpoint(tree, false);
+  EXPECT_NE(second.root_page_id, first.root_page_id);
+  std::vector<jubilant::storage::PageId> first_ids;
+  for (const auto& page : first.pages) {
+    first_ids.push_back(page.id);
+  }
+  EXPECT_EQ(second.released, first_ids);
+  for (const auto& page : second.pages) {
+    EXPECT_EQ(std::count(first_ids.begin(), first_ids.end(), page.id), 0);
+  }
+
+  // A crash before the new root is published recovers the first tree intact.
+  BTree recovered(config(first.root_page_id));
+  EXPECT_EQ(recovered.size(), 120U);
+  EXPECT_EQ(value_of(recovered, "key-1119"), std::string(100, 'a'));
+  BTree published(config(second.root_page_id));
+  EXPECT_EQ(value_of(published, "key-1119"), std::string(100, 'b'));
+
+  // Once published, the first tree's pages are reused, lowest first.
+  tree.MarkFlushed(second);
+  tree.Insert("key-1119", Record{.value = std::string(100, 'c'), .metadata = {}});
+  const auto third = checkpoint(tree, true);
+  ASSERT_FALSE(third.pages.empty());
+  EXPECT_EQ(third.pages.front().id, first_ids.front());
+}
+
+TEST(BTreeTest, CrashBetweenCheckpointPageWritesKeepsEveryKey) {
+  const auto dir = TempDir("jubilant-btree-torn-checkpoint");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  const auto config = [&](jubilant::storage::PageId root) {
+    return BTree::Config{.pager = &pager,
+                         .value_log = nullptr,
+                         .inline_threshold = 512U,
+                         .root_hint = root,
+                         .defer_page_writes = true};
+  };
+  const auto key_of = [](int i) { return "key-" + std::to_string(1000 + i); };
+
+  BTree tree(config(0));
+  constexpr int kKeys = 120;
+  for (int i = 0; i < kKeys; ++i) {
+    tree.Insert(key_of(i), Record{.value = std::string(100, 'a'), .metadata = {}});
+  }
+  auto published = tree.CaptureDirtyPages(1);
+  for (const auto& page : published.pages) {
+    pager.Write(page);
+  }
+  tree.MarkFlushed(published);
+
+  // A key sorting first pushes one record from every leaf onto the next. The crash comes after
+  // the first page write, before the rest and before the superblock names the new root.
+  tree.Insert("key-0999", Record{.value = std::string(100, 'b'), .metadata = {}});
+  const auto torn = tree.CaptureDirtyPages(2);
+  ASSERT_GE(torn.pages.size(), 2U);
+  pager.Write(torn.pages.front());
+  pager.Sync();
+
+  BTree recovered(config(published.root_page_id));
+  EXPECT_EQ(recovered.size(), static_cast<std::size_t>(kKeys));
+  for (int i = 0; i < kKeys; ++i) {
+    EXPECT_TRUE(recovered.Find(key_of(i)).has_value()) << key_of(i);
+  }
+}
+
+TEST(BTreeTest, ConcurrentWritersAndCheckpointsKeepEveryRecord) {
+  const auto dir = TempDir("jubilant-btree-concurrent");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  const auto config = [&](jubilant::storage::PageId root) {
+    return BTree::Config{.pager = &pager,
+                         .value_log = nullptr,
+                         .inline_threshold = 512U,
+                         .root_hint = root,
+                         .defer_page_writes = true};
+  };
+  BTree tree(config(0));
+
+  constexpr int kWriters = 4;
+  constexpr int kKeysPerWriter = 300;
+  std::vector<std::thread> writers;
+  for (int writer = 0; writer < kWriters; ++writer) {
+    writers.emplace_back([&tree, writer]() {
+      for (int i = 0; i < kKeysPerWriter; ++i) {
+        const auto key = "w" + std::to_string(writer) + "-" + std::to_string(1000 + i);
+        tree.Insert(key, Record{.value = key, .metadata = {}});
+        ASSERT_TRUE(tree.Find(key).has_value());
+        if (i % 3 == 0) {
+          ASSERT_TRUE(tree.Erase(key));
+        }
+      }
+    });
+  }
+  // Checkpoints capture while the writers run, as the server's do between commits.
+  BTree::DirtyPages last{};
+  for (int round = 0; round < 20; ++round) {
+    last = tree.CaptureDirtyPages(1);
+    for (const auto& page : last.pages) {
+      pager.Write(page);
+    }
+    tree.MarkFlushed(last);
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  last = tree.CaptureDirtyPages(2);
+  for (const auto& page : last.pages) {
+    pager.Write(page);
+  }
+  tree.MarkFlushed(last);
+  EXPECT_FALSE(tree.has_unflushed_changes());
+
+  constexpr std::size_t kKept = kWriters * (kKeysPerWriter - (kKeysPerWriter / 3));
+  EXPECT_EQ(tree.size(), kKept);
+  BTree reloaded(config(last.root_page_id));
+  EXPECT_EQ(reloaded.size(), kKept);
+  const auto found = reloaded.Find("w3-1299");
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(std::get<std::string>(found->value), "w3-1299");
+  EXPECT_FALSE(reloaded.Find("w3-1297").has_value());
+}
+
+TEST(BTreeTest, SnapshotReadsSeeOnlyCommittedVersionsUntilCollected) {
+  const auto dir = TempDir("jubilant-btree-versions");
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  BTree tree(BTree::Config{.pager = &pager,
+                           .value_log = nullptr,
+                           .inline_threshold = 512U,
+                           .root_hint = 0,
+                           .defer_page_writes = true});
+  using jubilant::storage::btree::Visibility;
+  const auto value_at = [&tree](const std::string& key, jubilant::storage::Lsn snapshot) {
+    const auto found = tree.FindAt(key, snapshot);
+    return found.has_value() ? std::get<std::string>(found->value) : std::string{"<missing>"};
+  };
+  const std::vector<std::string> keys{"k"};
+
+  tree.Insert("k", Record{.value = std::string{"v1"}, .metadata = {}});
+  EXPECT_EQ(value_at("k", 0), "v1");
+
+  // Pending until stamped: locking reads see it, snapshots do not.
+  tree.Insert("k", Record{.value = std::string{"v2"}, .metadata = {}}, Visibility::kAtCommit);
+  EXPECT_EQ(std::get<std::string>(tree.Find("k")->value), "v2");
+  EXPECT_EQ(value_at("k", 100), "v1");
+  tree.CommitVersions(keys, 10);
+  EXPECT_EQ(value_at("k", 9), "v1");
+  EXPECT_EQ(value_at("k", 10), "v2");
+
+  ASSERT_TRUE(tree.Erase("k", Visibility::kAtCommit));
+  tree.CommitVersions(keys, 20);
+  EXPECT_EQ(value_at("k", 15), "v2");
+  EXPECT_EQ(value_at("k", 20), "<missing>");
+  EXPECT_EQ(tree.retained_versions(), 2U);
+
+  // A snapshot at 15 still needs v2 but nothing older; once none predates 20, nothing is kept.
+  EXPECT_EQ(tree.CollectVersions(15), 1U);
+  EXPECT_EQ(value_at("k", 15), "v2");
+  EXPECT_EQ(tree.CollectVersions(20), 1U);
+  EXPECT_EQ(tree.retained_versions(), 0U);
+  EXPECT_EQ(value_at("k", 15), "<missing>");
+
+  // An aborted transaction's writes are undone, including a key it created.
+  tree.Insert("a", Record{.value = std::string{"x1"}, .metadata = {}});
+  tree.Insert("a", Record{.value = std::string{"x2"}, .metadata = {}}, Visibility::kAtCommit);
+  tree.Insert("a", Record{.value = std::string{"x3"}, .metadata = {}}, Visibility::kAtCommit);
+  tree.Insert("b", Record{.value = std::string{"y1"}, .metadata = {}}, Visibility::kAtCommit);
+  const std::vector<std::string> aborted{"a", "b"};
+  tree.AbortVersions(aborted);
+  EXPECT_EQ(std::get<std::string>(tree.Find("a")->value), "x1");
+  EXPECT_FALSE(tree.Find("b").has_value());
+  EXPECT_EQ(tree.retained_versions(), 0U);
+}
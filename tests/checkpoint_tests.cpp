@@ -1,17 +1,29 @@
 #include "storage/checkpoint/checkpointer.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <gtest/gtest.h>
 #include <optional>
+#include <stdexcept>
+#include <thread>
 
 using jubilant::storage::Lsn;
 using jubilant::storage::checkpoint::Checkpointer;
 using jubilant::storage::checkpoint::CheckpointSnapshot;
+using jubilant::storage::checkpoint::CheckpointTriggers;
+using jubilant::storage::checkpoint::FlushResult;
+using jubilant::storage::checkpoint::IoBudget;
+using jubilant::storage::checkpoint::IoLimits;
 
 TEST(CheckpointerTest, SkipsWhenNoCheckpointRequested) {
   Checkpointer checkpointer;
   bool flushed = false;
 
-  const auto snapshot = checkpointer.RunOnce([&](Lsn) { flushed = true; });
+  const auto snapshot = checkpointer.RunOnce([&](Lsn) -> FlushResult {
+    flushed = true;
+    return {};
+  });
 
   EXPECT_FALSE(snapshot.has_value());
   EXPECT_FALSE(flushed);
@@ -22,9 +34,10 @@ TEST(CheckpointerTest, RunsFlushCallbackAndResetsRequest) {
   checkpointer.RequestCheckpoint(5);
 
   bool flushed = false;
-  auto snapshot = checkpointer.RunOnce([&](Lsn lsn) {
+  auto snapshot = checkpointer.RunOnce([&](Lsn lsn) -> FlushResult {
     flushed = true;
     EXPECT_EQ(lsn, 5U);
+    return {.pages = 3, .bytes = 3 * 4096};
   });
 
   ASSERT_TRUE(snapshot.has_value());
@@ -33,11 +46,133 @@ TEST(CheckpointerTest, RunsFlushCallbackAndResetsRequest) {
   }
   const auto& snapshot_value = snapshot.value();
   EXPECT_EQ(snapshot_value.lsn, 5U);
-  EXPECT_EQ(snapshot_value.pages_flushed, 0U);
+  EXPECT_EQ(snapshot_value.pages_flushed, 3U);
   EXPECT_TRUE(flushed);
 
   flushed = false;
-  snapshot = checkpointer.RunOnce([&](Lsn) { flushed = true; });
+  snapshot = checkpointer.RunOnce([&](Lsn) -> FlushResult {
+    flushed = true;
+    return {};
+  });
   EXPECT_FALSE(snapshot.has_value());
   EXPECT_FALSE(flushed);
+
+  const auto stats = checkpointer.stats();
+  EXPECT_EQ(stats.checkpoints, 1U);
+  EXPECT_EQ(stats.pages_flushed, 3U);
+  EXPECT_EQ(stats.bytes_flushed, 3U * 4096U);
+  ASSERT_TRUE(stats.last.has_value());
+  EXPECT_EQ(stats.last->lsn, 5U);
+}
+
+TEST(CheckpointerTest, CountsFailuresAndRetriesFromNextBoundary) {
+  Checkpointer checkpointer;
+  bool fail = true;
+  const auto boundary = []() -> std::optional<Lsn> { return 9; };
+  const auto flush = [&](Lsn) -> FlushResult {
+    if (fail) {
+      throw std::runtime_error("disk full");
+    }
+    return {.pages = 1};
+  };
+
+  EXPECT_THROW((void)checkpointer.Run(boundary, flush), std::runtime_error);
+  fail = false;
+  const auto snapshot = checkpointer.Run(boundary, flush);
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->lsn, 9U);
+
+  const auto stats = checkpointer.stats();
+  EXPECT_EQ(stats.failures, 1U);
+  EXPECT_EQ(stats.checkpoints, 1U);
+}
+
+TEST(CheckpointerTest, BackgroundThreadRunsOnWalVolumeTrigger) {
+  Checkpointer checkpointer;
+  std::atomic<std::uint64_t> wal_bytes{0};
+  std::atomic<Lsn> next_lsn{1};
+  std::atomic<int> flushes{0};
+
+  // The interval alone would never fire during the test.
+  checkpointer.Start(
+      CheckpointTriggers{.interval = std::chrono::hours(1), .wal_bytes = 1024},
+      [&]() -> std::optional<Lsn> { return next_lsn.load(); },
+      [&](Lsn) -> FlushResult {
+        wal_bytes = 0;
+        ++flushes;
+        return {.pages = 2};
+      },
+      [&]() { return wal_bytes.load(); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(120));
+  EXPECT_EQ(flushes.load(), 0);
+
+  next_lsn = 42;
+  wal_bytes = 4096;
+  for (int i = 0; i < 100 && flushes.load() == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  checkpointer.Stop();
+
+  EXPECT_EQ(flushes.load(), 1);
+  const auto stats = checkpointer.stats();
+  ASSERT_TRUE(stats.last.has_value());
+  EXPECT_EQ(stats.last->lsn, 42U);
+  EXPECT_EQ(stats.last->pages_flushed, 2U);
+}
+
+TEST(IoBudgetTest, PacesWritesToTheConfiguredRates) {
+  using std::chrono::milliseconds;
+  IoBudget budget{IoLimits{.bytes_per_second = 40960, .iops = 0}};
+  const auto start = IoBudget::Clock::now();
+
+  // The initial 100 ms burst covers one 4 KiB page; the next must wait for 100 ms of refill.
+  EXPECT_EQ(budget.Reserve(4096, start), std::chrono::nanoseconds::zero());
+  EXPECT_EQ(std::chrono::duration_cast<milliseconds>(budget.Reserve(4096, start)).count(), 100);
+  // A caller that slept as told finds the budget exactly used up again.
+  EXPECT_EQ(std::chrono::duration_cast<milliseconds>(
+                budget.Reserve(4096, start + milliseconds(100)))
+                .count(),
+            100);
+
+  // The tighter of the two limits decides, and the scale raises both.
+  budget.SetLimits(IoLimits{.bytes_per_second = 1ULL << 30U, .iops = 10});
+  EXPECT_EQ(budget.Reserve(4096, start), std::chrono::nanoseconds::zero());
+  EXPECT_EQ(std::chrono::duration_cast<milliseconds>(budget.Reserve(4096, start)).count(), 100);
+  budget.SetScale(4.0);
+  EXPECT_DOUBLE_EQ(budget.scale(), 4.0);
+  EXPECT_FALSE(budget.unlimited());
+
+  IoBudget unlimited;
+  EXPECT_TRUE(unlimited.unlimited());
+  EXPECT_EQ(unlimited.Acquire(1ULL << 30U), std::chrono::nanoseconds::zero());
+}
+
+TEST(CheckpointerTest, ScalesBudgetWithWalBacklogAndReportsFlushRate) {
+  EXPECT_DOUBLE_EQ(Checkpointer::BudgetScaleFor(512, 1024), 1.0);
+  EXPECT_DOUBLE_EQ(Checkpointer::BudgetScaleFor(2048, 1024), 2.0);
+  EXPECT_DOUBLE_EQ(Checkpointer::BudgetScaleFor(1ULL << 40U, 1024), Checkpointer::kMaxBudgetScale);
+
+  Checkpointer checkpointer;
+  checkpointer.io_budget().SetLimits(IoLimits{.bytes_per_second = 0, .iops = 50});
+  const auto flush = [&](Lsn) {
+    FlushResult result{};
+    // Eight one-page writes; a 50 IOPS budget bursts only five.
+    for (int i = 0; i < 8; ++i) {
+      result.throttled += checkpointer.io_budget().Acquire(4096);
+      ++result.pages;
+      result.bytes += 4096;
+    }
+    return result;
+  };
+  const auto snapshot = checkpointer.Run([]() -> std::optional<Lsn> { return 3; }, flush);
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->bytes_flushed, 8U * 4096U);
+  EXPECT_GT(snapshot->throttled, std::chrono::nanoseconds::zero());
+  EXPECT_GE(snapshot->duration, snapshot->throttled);
+  EXPECT_GT(snapshot->FlushBytesPerSecond(), 0.0);
+
+  const auto stats = checkpointer.stats();
+  EXPECT_EQ(stats.throttled, snapshot->throttled);
+  EXPECT_DOUBLE_EQ(stats.budget_scale, 1.0);
 }
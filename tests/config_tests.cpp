@@ -33,6 +33,17 @@ page_size = 8192
 inline_threshold = 2048
 group_commit_max_latency_ms = 12
 cache_bytes = 134217728
+checkpoint_interval_ms = 250
+checkpoint_wal_bytes = 8388608
+checkpoint_max_bytes_per_second = 52428800
+checkpoint_max_iops = 2000
+wal_segment_bytes = 4194304
+ttl_sweep_interval_ms = 500
+ttl_sweep_batch = 64
+ttl_sweep_max_per_second = 1000
+vlog_segment_bytes = 1048576
+vlog_gc_interval_ms = 2000
+vlog_gc_max_live_ratio = 0.25
 listen_address = "0.0.0.0"
 listen_port = 7777
 )");
@@ -50,6 +61,17 @@ listen_port = 7777
   EXPECT_EQ(loaded.inline_threshold, 2048U);
   EXPECT_EQ(loaded.group_commit_max_latency_ms, 12U);
   EXPECT_EQ(loaded.cache_bytes, 134217728ULL);
+  EXPECT_EQ(loaded.checkpoint_interval_ms, 250U);
+  EXPECT_EQ(loaded.checkpoint_wal_bytes, 8388608ULL);
+  EXPECT_EQ(loaded.checkpoint_max_bytes_per_second, 52428800ULL);
+  EXPECT_EQ(loaded.checkpoint_max_iops, 2000U);
+  EXPECT_EQ(loaded.wal_segment_bytes, 4194304ULL);
+  EXPECT_EQ(loaded.ttl_sweep_interval_ms, 500U);
+  EXPECT_EQ(loaded.ttl_sweep_batch, 64U);
+  EXPECT_EQ(loaded.ttl_sweep_max_per_second, 1000ULL);
+  EXPECT_EQ(loaded.vlog_segment_bytes, 1048576ULL);
+  EXPECT_EQ(loaded.vlog_gc_interval_ms, 2000U);
+  EXPECT_DOUBLE_EQ(loaded.vlog_gc_max_live_ratio, 0.25);
   EXPECT_EQ(loaded.listen_address, "0.0.0.0");
   EXPECT_EQ(loaded.listen_port, 7777);
 }
@@ -72,6 +94,7 @@ TEST(ConfigLoaderTest, FallsBackToDefaults) {
   EXPECT_EQ(loaded.cache_bytes, 64U * 1024U * 1024U);
   EXPECT_EQ(loaded.listen_address, "127.0.0.1");
   EXPECT_EQ(loaded.listen_port, 6767);
+  EXPECT_EQ(loaded.wal_schema, "wal-v2");
 }
 
 TEST(ConfigLoaderTest, RejectsInvalidInlineThreshold) {
@@ -81,6 +104,15 @@ TEST(ConfigLoaderTest, RejectsInvalidInlineThreshold) {
   EXPECT_FALSE(cfg.has_value());
 }
 
+TEST(ConfigLoaderTest, RejectsValueLogGcRatioOfOne) {
+  // At 1.0 every segment qualifies, so each pass would copy the whole value log.
+  const auto path =
+      WriteTempConfig("gc_ratio.toml", "db_path = \"./data\"\nvlog_gc_max_live_ratio = 1.0\n");
+
+  const auto cfg = ConfigLoader::LoadFromFile(path);
+  EXPECT_FALSE(cfg.has_value());
+}
+
 TEST(ConfigLoaderTest, AllowsEphemeralPort) {
   const auto path = WriteTempConfig(
       "ephemeral.toml",
@@ -98,4 +130,52 @@ TEST(ConfigLoaderTest, AllowsEphemeralPort) {
   EXPECT_EQ(loaded.listen_port, 0);
 }
 
+TEST(ConfigLoaderTest, AcceptsOnlyKnownWalSchemas) {
+  const auto compact = ConfigLoader::LoadFromFile(
+      WriteTempConfig("compact.toml", "db_path = \"./data\"\nwal_schema = \"wal-compact-v1\"\n"));
+  ASSERT_TRUE(compact.has_value());
+  if (compact.has_value()) {
+    EXPECT_EQ(compact->wal_schema, "wal-compact-v1");
+  }
+
+  const auto unknown = ConfigLoader::LoadFromFile(
+      WriteTempConfig("unknown-wal.toml", "db_path = \"./data\"\nwal_schema = \"wal-v9\"\n"));
+  EXPECT_FALSE(unknown.has_value());
+}
+
+TEST(ConfigLoaderTest, LoadsAndValidatesInlineRules) {
+  const auto path = WriteTempConfig("inline-rules.toml",
+                                    R"(db_path = "./data"
+[[inline_rules]]
+prefix = "blob:"
+threshold = 64
+
+[[inline_rules]]
+prefix = "session:"
+threshold = 2048
+)");
+
+  const auto cfg = ConfigLoader::LoadFromFile(path);
+  ASSERT_TRUE(cfg.has_value());
+  if (!cfg.has_value()) {
+    return;
+  }
+  ASSERT_EQ(cfg->inline_rules.size(), 2U);
+  EXPECT_EQ(cfg->inline_rules[0].prefix, "blob:");
+  EXPECT_EQ(cfg->inline_rules[0].threshold, 64U);
+  EXPECT_EQ(cfg->inline_rules[1].prefix, "session:");
+  EXPECT_EQ(cfg->inline_rules[1].threshold, 2048U);
+
+  const auto duplicate = ConfigLoader::LoadFromFile(WriteTempConfig(
+      "duplicate-rules.toml", "db_path = \"./data\"\n"
+                              "[[inline_rules]]\nprefix = \"a:\"\nthreshold = 8\n"
+                              "[[inline_rules]]\nprefix = \"a:\"\nthreshold = 16\n"));
+  EXPECT_FALSE(duplicate.has_value());
+
+  const auto oversized = ConfigLoader::LoadFromFile(WriteTempConfig(
+      "oversized-rule.toml", "db_path = \"./data\"\n"
+                             "[[inline_rules]]\nprefix = \"a:\"\nthreshold = 4096\n"));
+  EXPECT_FALSE(oversized.has_value());
+}
+
 } // namespace jubilant::config
@@ -9,12 +9,14 @@
 #include <filesystem>
 #include <future>
 #include <gtest/gtest.h>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
 using jubilant::lock::LockManager;
 using jubilant::lock::LockMode;
+using jubilant::lock::LockSet;
 using jubilant::storage::Pager;
 using jubilant::storage::btree::BTree;
 using jubilant::storage::btree::Record;
@@ -100,6 +102,74 @@ TEST(LockManagerTest, ExclusiveBlocksSharedAccess) {
   EXPECT_GE(elapsed.count(), 45);
 }
 
+TEST(LockManagerTest, FreesEntriesOnceNoCallerHoldsOrAwaitsTheKey) {
+  // One stripe, so every key shares a table and a mutex.
+  LockManager manager{1};
+  for (int i = 0; i < 100; ++i) {
+    manager.Acquire("key-" + std::to_string(i), LockMode::kShared);
+  }
+  EXPECT_EQ(manager.active_keys(), 100U);
+  for (int i = 0; i < 100; ++i) {
+    manager.Release("key-" + std::to_string(i), LockMode::kShared);
+  }
+  EXPECT_EQ(manager.active_keys(), 0U);
+
+  // A blocked waiter keeps the entry alive across the holder's release.
+  manager.Acquire("contended", LockMode::kExclusive);
+  std::promise<void> waiting;
+  std::thread waiter([&]() {
+    waiting.set_value();
+    manager.Acquire("contended", LockMode::kExclusive);
+    manager.Release("contended", LockMode::kExclusive);
+  });
+  waiting.get_future().wait();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(manager.active_keys(), 1U);
+  manager.Release("contended", LockMode::kExclusive);
+  waiter.join();
+  EXPECT_EQ(manager.active_keys(), 0U);
+}
+
+TEST(LockSetTest, TakesTheStrongestDeclaredModeAndReleasesEverything) {
+  LockManager manager;
+  {
+    LockSet locks{manager};
+    locks.Declare("b", LockMode::kShared);
+    locks.Declare("a", LockMode::kShared);
+    locks.Declare("b", LockMode::kExclusive);
+    locks.Declare("a", LockMode::kShared);
+    EXPECT_EQ(locks.size(), 2U);
+    EXPECT_EQ(locks.mode("a"), LockMode::kShared);
+    EXPECT_EQ(locks.mode("b"), LockMode::kExclusive);
+    locks.AcquireAll();
+    EXPECT_EQ(manager.active_keys(), 2U);
+    EXPECT_THROW(locks.Declare("c", LockMode::kShared), std::logic_error);
+  }
+  EXPECT_EQ(manager.active_keys(), 0U);
+}
+
+TEST(LockSetTest, OpposingDeclarationOrdersDoNotDeadlock) {
+  LockManager manager;
+  constexpr int kIterations = 2000;
+  std::barrier sync_point{2};
+
+  auto transfer = [&](const std::string& from, const std::string& to) {
+    sync_point.arrive_and_wait();
+    for (int i = 0; i < kIterations; ++i) {
+      LockSet locks{manager};
+      locks.Declare(from, LockMode::kExclusive);
+      locks.Declare(to, LockMode::kExclusive);
+      locks.AcquireAll();
+    }
+  };
+
+  std::thread forward(transfer, "alice", "bob");
+  std::thread backward(transfer, "bob", "alice");
+  forward.join();
+  backward.join();
+  EXPECT_EQ(manager.active_keys(), 0U);
+}
+
 TEST(LockManagerTest, SerializesConcurrentUpdatesAcrossRequests) {
   LockManager manager;
   const auto dir = TempDir("jubilant-lock-manager");
@@ -30,6 +30,7 @@ TEST(ManifestStoreTest, PersistsAndLoadsValidManifest) {
   auto manifest = jubilant::meta::ManifestStore::NewDefault("uuid-123");
   manifest.page_size = 8192;
   manifest.inline_threshold = 512;
+  manifest.inline_rules = {{.prefix = "blob:", .threshold = 64}};
 
   ASSERT_TRUE(store.Persist(manifest));
 
@@ -43,6 +44,9 @@ TEST(ManifestStoreTest, PersistsAndLoadsValidManifest) {
   EXPECT_EQ(loaded_manifest.db_uuid, "uuid-123");
   EXPECT_EQ(loaded_manifest.page_size, 8192U);
   EXPECT_EQ(loaded_manifest.inline_threshold, 512U);
+  ASSERT_EQ(loaded_manifest.inline_rules.size(), 1U);
+  EXPECT_EQ(loaded_manifest.inline_rules.front().prefix, "blob:");
+  EXPECT_EQ(loaded_manifest.inline_rules.front().threshold, 64U);
   EXPECT_EQ(loaded_manifest.hash_algorithm, manifest.hash_algorithm);
 }
 
@@ -59,10 +63,39 @@ TEST(ManifestStoreTest, RejectsInvalidManifestValues) {
   EXPECT_FALSE(store.Persist(manifest));
 
   manifest.inline_threshold = 1024;
+  manifest.inline_rules = {{.prefix = "", .threshold = 64}};
+  EXPECT_FALSE(store.Persist(manifest));
+
+  manifest.inline_rules = {{.prefix = "blob:", .threshold = manifest.page_size}};
+  EXPECT_FALSE(store.Persist(manifest));
+
+  manifest.inline_rules.clear();
   manifest.hash_algorithm.clear();
   EXPECT_FALSE(store.Persist(manifest));
 }
 
+TEST(ManifestStoreTest, LoadsRetiredWalSchemaSoOpenCanRefuseIt) {
+  const auto dir = TempDir("jubilant-manifest-retired-wal");
+  ManifestStore store{dir};
+
+  // A database from before the WAL CRC trailer must not look like a missing manifest, or the
+  // server would write a fresh one and open the old log with the new framing.
+  auto manifest = jubilant::meta::ManifestStore::NewDefault("uuid-789");
+  EXPECT_EQ(manifest.wal_schema, "wal-v2");
+  manifest.wal_schema = "wal-v1";
+  ASSERT_TRUE(store.Persist(manifest));
+
+  const auto loaded = store.Load();
+  ASSERT_TRUE(loaded.has_value());
+  if (!loaded.has_value()) {
+    return;
+  }
+  EXPECT_EQ(loaded->wal_schema, "wal-v1");
+
+  manifest.wal_schema = "wal-v0";
+  EXPECT_FALSE(store.Persist(manifest));
+}
+
 TEST(ManifestStoreTest, BumpsGenerationOnRewrite) {
   const auto dir = TempDir("jubilant-manifest-generations");
   ManifestStore store{dir};
@@ -3,6 +3,7 @@
 
 #include <arpa/inet.h>
 #include <array>
+#include <csignal>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -18,6 +19,7 @@
 #include <sys/time.h>
 #include <system_error>
 #include <unistd.h>
+#include <vector>
 
 using jubilant::server::NetworkServer;
 using jubilant::server::Server;
@@ -44,6 +46,13 @@ bool SendAll(int socket_fd, const std::byte* buffer, std::size_t length) {
   return true;
 }
 
+bool WriteChunkFrame(int socket_fd, std::string_view chunk) {
+  const auto network_length = htonl(static_cast<std::uint32_t>(chunk.size()));
+  return SendAll(socket_fd, reinterpret_cast<const std::byte*>(&network_length),
+                 sizeof(network_length)) &&
+         SendAll(socket_fd, reinterpret_cast<const std::byte*>(chunk.data()), chunk.size());
+}
+
 bool WriteFrame(int socket_fd, const nlohmann::json& json) {
   const auto payload = json.dump();
   const auto length = static_cast<std::uint32_t>(payload.size());
@@ -101,6 +110,29 @@ std::optional<nlohmann::json> ReadJsonFrame(int socket_fd) {
   return json;
 }
 
+// Connects to the server on loopback with a two-second receive timeout, or returns -1.
+int ConnectLoopback(std::uint16_t port) {
+  const int socket_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    return -1;
+  }
+
+  timeval timeout{};
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  ::setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr) != 1 ||
+      ::connect(socket_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ::close(socket_fd);
+    return -1;
+  }
+  return socket_fd;
+}
+
 struct TempDirGuard {
   explicit TempDirGuard(std::string_view prefix)
       : path(std::filesystem::temp_directory_path() /
@@ -258,3 +290,331 @@ TEST(NetworkServerTest, ClosesConnectionWhenResponseExceedsCap) {
 
   ::close(socket_fd);
 }
+
+TEST(NetworkServerTest, StreamsRawValueLogReadsAfterJsonFrame) {
+  TempDirGuard dir{"jubilant-network-server-raw"};
+
+  Server core_server{dir.path, 2};
+  core_server.Start();
+
+  // Larger than the frame cap, so it can only come back through the raw path. Random over the full
+  // byte range so the value log stores it uncompressed.
+  std::string large_value(1'100'000, 'r');
+  std::uint32_t state = 0x9E3779B9U;
+  for (auto& character : large_value) {
+    state ^= state << 13U;
+    state ^= state >> 17U;
+    state ^= state << 5U;
+    character = static_cast<char>(state >> 24U);
+  }
+  jubilant::storage::btree::Record large_record{};
+  large_record.value = large_value;
+
+  jubilant::txn::Operation set_operation{
+      .type = jubilant::txn::OperationType::kSet, .key = "blob", .value = large_record};
+  jubilant::txn::TransactionRequest seed_request{.id = 21, .operations = {set_operation}};
+  ASSERT_TRUE(core_server.SubmitTransaction(seed_request));
+
+  bool seeded = false;
+  for (int attempt = 0; attempt < 50 && !seeded; ++attempt) {
+    core_server.WaitForResults(std::chrono::milliseconds(10));
+    seeded = !core_server.DrainCompleted().empty();
+  }
+  ASSERT_TRUE(seeded);
+
+  NetworkServer::Config config{};
+  config.host = "127.0.0.1";
+  config.port = 0;
+  NetworkServer network{core_server, config};
+  const ServerGuard guard{.core = core_server, .network = network};
+  ASSERT_TRUE(network.Start());
+
+  const int socket_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(socket_fd, 0);
+
+  timeval timeout{};
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  ::setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(network.port());
+  ASSERT_EQ(::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr), 1);
+  ASSERT_EQ(::connect(socket_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+  nlohmann::json get_request;
+  get_request["txn_id"] = 22;
+  get_request["raw_values"] = true;
+  get_request["operations"] = nlohmann::json::array();
+  get_request["operations"].push_back({{"type", "get"}, {"key", "blob"}});
+
+  ASSERT_TRUE(WriteFrame(socket_fd, get_request));
+  const auto get_response = ReadJsonFrame(socket_fd);
+  ASSERT_TRUE(get_response.has_value());
+  if (!get_response.has_value()) {
+    return;
+  }
+  const auto& operation_json = get_response->at("operations")[0];
+  EXPECT_TRUE(operation_json.at("success").get<bool>());
+  const auto& value_json = operation_json.at("value");
+  EXPECT_EQ(value_json.at("kind"), "string");
+  EXPECT_EQ(value_json.at("encoding"), "raw");
+  EXPECT_FALSE(value_json.contains("codec"));
+  ASSERT_EQ(value_json.at("length").get<std::size_t>(), large_value.size());
+
+  std::string streamed(large_value.size(), '\0');
+  std::size_t offset = 0;
+  while (offset < streamed.size()) {
+    const auto bytes = ::recv(socket_fd, streamed.data() + offset, streamed.size() - offset, 0);
+    ASSERT_GT(bytes, 0);
+    offset += static_cast<std::size_t>(bytes);
+  }
+  EXPECT_EQ(streamed, large_value);
+
+  ::close(socket_fd);
+}
+
+TEST(NetworkServerTest, AcceptsChunkedUploadLargerThanFrameCap) {
+  TempDirGuard dir{"jubilant-network-server-chunked"};
+
+  Server core_server{dir.path, 2};
+  core_server.Start();
+
+  NetworkServer::Config config{};
+  config.host = "127.0.0.1";
+  config.port = 0;
+  NetworkServer network{core_server, config};
+  const ServerGuard guard{.core = core_server, .network = network};
+  ASSERT_TRUE(network.Start());
+
+  const int socket_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(socket_fd, 0);
+
+  timeval timeout{};
+  timeout.tv_sec = 2;
+  timeout.tv_usec = 0;
+  ::setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(network.port());
+  ASSERT_EQ(::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr), 1);
+  ASSERT_EQ(::connect(socket_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+  std::string large_value(1'500'000, 'c');
+  for (std::size_t i = 0; i < large_value.size(); i += 4096) {
+    large_value[i] = static_cast<char>('a' + (i / 4096) % 26);
+  }
+
+  nlohmann::json set_request;
+  set_request["txn_id"] = 31;
+  set_request["operations"] = nlohmann::json::array();
+  set_request["operations"].push_back(
+      {{"type", "set"},
+       {"key", "upload"},
+       {"value", {{"kind", "string"}, {"encoding", "chunked"}, {"length", large_value.size()}}}});
+  ASSERT_TRUE(WriteFrame(socket_fd, set_request));
+
+  constexpr std::size_t kChunkBytes = 256U * 1024U;
+  for (std::size_t offset = 0; offset < large_value.size(); offset += kChunkBytes) {
+    const auto chunk = std::string_view(large_value).substr(offset, kChunkBytes);
+    ASSERT_TRUE(WriteChunkFrame(socket_fd, chunk));
+  }
+  const auto set_response = ReadJsonFrame(socket_fd);
+  ASSERT_TRUE(set_response.has_value());
+  if (!set_response.has_value()) {
+    return;
+  }
+  EXPECT_EQ(set_response->at("state"), "committed");
+
+  nlohmann::json get_request;
+  get_request["txn_id"] = 32;
+  get_request["raw_values"] = true;
+  get_request["operations"] = nlohmann::json::array();
+  get_request["operations"].push_back({{"type", "get"}, {"key", "upload"}});
+  ASSERT_TRUE(WriteFrame(socket_fd, get_request));
+  const auto get_response = ReadJsonFrame(socket_fd);
+  ASSERT_TRUE(get_response.has_value());
+  if (!get_response.has_value()) {
+    return;
+  }
+  const auto& value_json = get_response->at("operations")[0].at("value");
+  EXPECT_EQ(value_json.at("kind"), "string");
+  ASSERT_EQ(value_json.at("length").get<std::size_t>(), large_value.size());
+
+  std::string streamed(large_value.size(), '\0');
+  std::size_t offset = 0;
+  while (offset < streamed.size()) {
+    const auto bytes = ::recv(socket_fd, streamed.data() + offset, streamed.size() - offset, 0);
+    ASSERT_GT(bytes, 0);
+    offset += static_cast<std::size_t>(bytes);
+  }
+  EXPECT_EQ(streamed, large_value);
+
+  ::close(socket_fd);
+}
+
+TEST(NetworkServerTest, StalledRawReaderDoesNotBlockOtherConnections) {
+  // Ignored as jubildb's main does: the stalled client hangs up in the middle of a sendfile.
+  std::signal(SIGPIPE, SIG_IGN);
+  TempDirGuard dir{"jubilant-network-server-stalled"};
+
+  Server core_server{dir.path, 2};
+  core_server.Start();
+
+  // Far more than the loopback socket buffers absorb, so its transfer cannot finish while the
+  // client is not reading.
+  std::string large_value(24U * 1024U * 1024U, '\0');
+  std::uint32_t state = 0x2545F491U;
+  for (auto& character : large_value) {
+    state ^= state << 13U;
+    state ^= state >> 17U;
+    state ^= state << 5U;
+    character = static_cast<char>(state >> 24U);
+  }
+  jubilant::storage::btree::Record large_record{};
+  large_record.value = std::move(large_value);
+
+  jubilant::txn::Operation set_operation{
+      .type = jubilant::txn::OperationType::kSet, .key = "huge", .value = large_record};
+  jubilant::txn::TransactionRequest seed_request{.id = 41, .operations = {set_operation}};
+  ASSERT_TRUE(core_server.SubmitTransaction(seed_request));
+
+  bool seeded = false;
+  for (int attempt = 0; attempt < 200 && !seeded; ++attempt) {
+    core_server.WaitForResults(std::chrono::milliseconds(10));
+    seeded = !core_server.DrainCompleted().empty();
+  }
+  ASSERT_TRUE(seeded);
+
+  NetworkServer::Config config{};
+  config.host = "127.0.0.1";
+  config.port = 0;
+  NetworkServer network{core_server, config};
+  const ServerGuard guard{.core = core_server, .network = network};
+  ASSERT_TRUE(network.Start());
+
+  // Reads only the JSON frame of its raw download, so the value's bytes are in flight, then stops.
+  const int stalled_fd = ConnectLoopback(network.port());
+  ASSERT_GE(stalled_fd, 0);
+  nlohmann::json raw_request;
+  raw_request["txn_id"] = 42;
+  raw_request["raw_values"] = true;
+  raw_request["operations"] = nlohmann::json::array();
+  raw_request["operations"].push_back({{"type", "get"}, {"key", "huge"}});
+  ASSERT_TRUE(WriteFrame(stalled_fd, raw_request));
+  ASSERT_TRUE(ReadJsonFrame(stalled_fd).has_value());
+
+  const int other_fd = ConnectLoopback(network.port());
+  ASSERT_GE(other_fd, 0);
+  nlohmann::json set_request;
+  set_request["txn_id"] = 43;
+  set_request["operations"] = nlohmann::json::array();
+  set_request["operations"].push_back(
+      {{"type", "set"}, {"key", "small"}, {"value", {{"kind", "string"}, {"data", "ok"}}}});
+  ASSERT_TRUE(WriteFrame(other_fd, set_request));
+  const auto set_response = ReadJsonFrame(other_fd);
+  ASSERT_TRUE(set_response.has_value());
+  if (!set_response.has_value()) {
+    return;
+  }
+  EXPECT_EQ(set_response->at("state"), "committed");
+
+  // Hanging up mid-transfer fails that send; it must not raise SIGPIPE in the server.
+  ::close(stalled_fd);
+
+  nlohmann::json get_request;
+  get_request["txn_id"] = 44;
+  get_request["operations"] = nlohmann::json::array();
+  get_request["operations"].push_back({{"type", "get"}, {"key", "small"}});
+  ASSERT_TRUE(WriteFrame(other_fd, get_request));
+  const auto get_response = ReadJsonFrame(other_fd);
+  ASSERT_TRUE(get_response.has_value());
+  if (!get_response.has_value()) {
+    return;
+  }
+  EXPECT_EQ(get_response->at("operations")[0].at("value").at("data"), "ok");
+
+  ::close(other_fd);
+}
+
+TEST(NetworkServerTest, ReusedAsyncIdNeverReceivesTheAsyncCompletion) {
+  TempDirGuard dir{"jubilant-network-async-reuse"};
+
+  // One worker, so an async set queued behind a large batch is still in flight when its id is
+  // reused.
+  Server core_server{dir.path, 1};
+  core_server.Start();
+
+  NetworkServer::Config config{};
+  config.host = "127.0.0.1";
+  config.port = 0;
+  NetworkServer network{core_server, config};
+  const ServerGuard guard{.core = core_server, .network = network};
+  ASSERT_TRUE(network.Start());
+
+  const int socket_fd = ConnectLoopback(network.port());
+  ASSERT_GE(socket_fd, 0);
+
+  for (int txn_id = 1; txn_id <= 10; ++txn_id) {
+    nlohmann::json batch;
+    batch["txn_id"] = 1000 + txn_id;
+    batch["durability"] = "sync";
+    batch["operations"] = nlohmann::json::array();
+    for (int index = 0; index < 5000; ++index) {
+      batch["operations"].push_back({{"type", "set"},
+                                     {"key", "batch-" + std::to_string(index)},
+                                     {"value", {{"kind", "int"}, {"data", index}}}});
+    }
+    nlohmann::json async_request;
+    async_request["txn_id"] = txn_id;
+    async_request["durability"] = "async";
+    async_request["operations"] = nlohmann::json::array();
+    async_request["operations"].push_back(
+        {{"type", "set"}, {"key", "async"}, {"value", {{"kind", "int"}, {"data", txn_id}}}});
+    nlohmann::json get_request;
+    get_request["txn_id"] = txn_id;
+    get_request["operations"] = nlohmann::json::array();
+    get_request["operations"].push_back({{"type", "get"}, {"key", "probe"}});
+    ASSERT_TRUE(WriteFrame(socket_fd, batch));
+    ASSERT_TRUE(WriteFrame(socket_fd, async_request));
+    ASSERT_TRUE(WriteFrame(socket_fd, get_request));
+
+    // Two answers carry the reused id: the set's acknowledgement and the get's own result, or its
+    // refusal while the set is still in flight. The set's completion must never be among them.
+    bool batch_done = false;
+    std::vector<nlohmann::json> reused;
+    while (!batch_done || reused.size() < 2) {
+      const auto response = ReadJsonFrame(socket_fd);
+      ASSERT_TRUE(response.has_value());
+      if (!response.has_value()) {
+        return;
+      }
+      if (response->at("txn_id") == 1000 + txn_id) {
+        batch_done = true;
+      } else {
+        reused.push_back(*response);
+      }
+    }
+    EXPECT_EQ(reused[0].at("state"), "pending");
+    ASSERT_EQ(reused[1].at("operations").size(), 1);
+    EXPECT_EQ(reused[1].at("operations")[0].at("type"), "get");
+  }
+
+  // Nothing else arrives: the next answer on the socket belongs to the next request.
+  nlohmann::json final_request;
+  final_request["txn_id"] = 99;
+  final_request["durability"] = "sync";
+  final_request["operations"] = nlohmann::json::array();
+  final_request["operations"].push_back({{"type", "get"}, {"key", "async"}});
+  ASSERT_TRUE(WriteFrame(socket_fd, final_request));
+  const auto final_response = ReadJsonFrame(socket_fd);
+  ASSERT_TRUE(final_response.has_value());
+  if (!final_response.has_value()) {
+    return;
+  }
+  EXPECT_EQ(final_response->at("txn_id"), 99);
+
+  ::close(socket_fd);
+}
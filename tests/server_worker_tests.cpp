@@ -1,30 +1,44 @@
+#include "config/config.h"
 #include "lock/lock_manager.h"
+#include "meta/manifest.h"
 #include "server/server.h"
 #include "server/transaction_receiver.h"
 #include "server/worker.h"
+#include "txn/snapshot_registry.h"
 #include "txn/transaction_request.h"
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <filesystem>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <variant>
 
 using jubilant::lock::LockManager;
+using jubilant::lock::LockMode;
 using jubilant::server::Server;
 using jubilant::server::TransactionReceiver;
 using jubilant::server::TransactionResult;
 using jubilant::server::Worker;
 using jubilant::storage::Pager;
 using jubilant::storage::btree::Record;
+using jubilant::storage::wal::RecordType;
+using jubilant::storage::wal::WalManager;
 using jubilant::storage::vlog::ValueLog;
+using jubilant::txn::DurabilityClass;
 using jubilant::txn::Operation;
 using jubilant::txn::OperationType;
+using jubilant::txn::SnapshotRegistry;
 using jubilant::txn::TransactionRequest;
 using jubilant::txn::TransactionState;
 
@@ -55,14 +69,13 @@ TEST(WorkerTest, ProcessesOperationsAndEmitsResults) {
   ValueLog vlog(dir / "vlog");
   jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
       .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
-  std::shared_mutex btree_mutex;
 
   std::mutex results_mutex;
   std::condition_variable results_cv;
   std::vector<TransactionResult> results;
 
   Worker worker{
-      "worker-0", receiver, lock_manager, btree, btree_mutex, [&](TransactionResult result) {
+      "worker-0", receiver, lock_manager, btree, [&](TransactionResult result) {
         std::lock_guard guard(results_mutex);
         results.push_back(std::move(result));
         results_cv.notify_all();
@@ -104,6 +117,311 @@ TEST(WorkerTest, ProcessesOperationsAndEmitsResults) {
   EXPECT_FALSE(btree.Find("alpha").has_value());
 }
 
+TEST(WorkerTest, LogsCommittedWritesToWalBeforeAcknowledging) {
+  TransactionReceiver receiver{};
+  LockManager lock_manager{};
+  const auto dir = std::filesystem::temp_directory_path() / "jubilant-worker-wal";
+  std::filesystem::remove_all(dir);
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  WalManager wal{dir};
+
+  std::mutex results_mutex;
+  std::condition_variable results_cv;
+  std::vector<TransactionResult> results;
+
+  Worker worker{"worker-0", receiver, lock_manager, btree,
+                [&](TransactionResult result) {
+                  std::lock_guard guard(results_mutex);
+                  results.push_back(std::move(result));
+                  results_cv.notify_all();
+                },
+                &wal};
+  worker.Start();
+
+  Record record{};
+  record.value = static_cast<std::int64_t>(42);
+  Operation set_op{.type = OperationType::kSet, .key = "billing", .value = record};
+  Operation get_op{.type = OperationType::kGet, .key = "billing", .value = std::nullopt};
+  TransactionRequest request{.id = 5, .operations = {set_op, get_op}};
+  request.durability = DurabilityClass::kSync;
+  ASSERT_TRUE(receiver.Enqueue(request));
+
+  std::unique_lock results_lock{results_mutex};
+  ASSERT_TRUE(results_cv.wait_for(results_lock, std::chrono::milliseconds(200),
+                                  [&results]() { return !results.empty(); }));
+  results_lock.unlock();
+
+  receiver.Stop();
+  worker.Stop();
+
+  EXPECT_EQ(results.front().state, TransactionState::kCommitted);
+
+  // Begin, one upsert (the get is not logged), and commit, all synced before the ack.
+  const auto replay = wal.Replay();
+  ASSERT_EQ(replay.committed.size(), 3U);
+  EXPECT_EQ(replay.committed[0].type, RecordType::kTxnBegin);
+  ASSERT_TRUE(replay.committed[1].upsert.has_value());
+  EXPECT_EQ(replay.committed[1].upsert->key, "billing");
+  EXPECT_EQ(replay.committed[1].upsert->value_kind, jubilant::storage::wal::ValueKind::kInt64);
+  EXPECT_EQ(replay.committed[2].type, RecordType::kTxnCommit);
+  EXPECT_EQ(wal.durable_lsn(), replay.committed[2].lsn);
+}
+
+TEST(WorkerTest, ReportsAFailedSyncAsADurabilityFailureNotAnAbort) {
+  TransactionReceiver receiver{};
+  LockManager lock_manager{};
+  const auto dir = std::filesystem::temp_directory_path() / "jubilant-worker-sync-failure";
+  std::filesystem::remove_all(dir);
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  WalManager wal{dir};
+  wal.SetPreSyncHook([]() { throw std::runtime_error("Failed to sync value log segment"); });
+
+  std::mutex results_mutex;
+  std::condition_variable results_cv;
+  std::vector<TransactionResult> results;
+
+  Worker worker{"worker-0", receiver, lock_manager, btree,
+                [&](TransactionResult result) {
+                  std::lock_guard guard(results_mutex);
+                  results.push_back(std::move(result));
+                  results_cv.notify_all();
+                },
+                &wal};
+  worker.Start();
+
+  Record record{};
+  record.value = static_cast<std::int64_t>(42);
+  Operation set_op{.type = OperationType::kSet, .key = "billing", .value = record};
+  TransactionRequest request{.id = 6, .operations = {set_op}};
+  request.durability = DurabilityClass::kSync;
+  ASSERT_TRUE(receiver.Enqueue(request));
+
+  std::unique_lock results_lock{results_mutex};
+  ASSERT_TRUE(results_cv.wait_for(results_lock, std::chrono::milliseconds(200),
+                                  [&results]() { return !results.empty(); }));
+  results_lock.unlock();
+
+  receiver.Stop();
+  worker.Stop();
+
+  // The write is applied and logged; only the sync failed, so it was not rolled back.
+  EXPECT_EQ(results.front().state, TransactionState::kDurabilityFailed);
+  EXPECT_TRUE(btree.Find("billing").has_value());
+  EXPECT_EQ(wal.Replay().committed.size(), 3U);
+}
+
+TEST(WorkerTest, ConflictingWritesReachTheWalInTheOrderTheyApplied) {
+  TransactionReceiver receiver{};
+  LockManager lock_manager{};
+  const auto dir = std::filesystem::temp_directory_path() / "jubilant-worker-wal-order";
+  std::filesystem::remove_all(dir);
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  WalManager wal{dir};
+
+  std::mutex results_mutex;
+  std::condition_variable results_cv;
+  std::size_t completed = 0;
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < 4; ++i) {
+    workers.push_back(std::make_unique<Worker>(
+        "worker-" + std::to_string(i), receiver, lock_manager, btree,
+        [&](TransactionResult /*result*/) {
+          std::lock_guard guard(results_mutex);
+          ++completed;
+          results_cv.notify_all();
+        },
+        &wal));
+    workers.back()->Start();
+  }
+
+  constexpr std::size_t kTransactions = 400;
+  for (std::size_t id = 1; id <= kTransactions; ++id) {
+    Record record{};
+    record.value = std::to_string(id);
+    Operation set_op{.type = OperationType::kSet, .key = "hot", .value = record};
+    TransactionRequest request{.id = id, .operations = {set_op}};
+    request.durability = DurabilityClass::kAsync;
+    ASSERT_TRUE(receiver.Enqueue(request));
+  }
+
+  std::unique_lock results_lock{results_mutex};
+  ASSERT_TRUE(results_cv.wait_for(results_lock, std::chrono::seconds(5),
+                                  [&completed]() { return completed == kTransactions; }));
+  results_lock.unlock();
+  receiver.Stop();
+  for (auto& worker : workers) {
+    worker->Stop();
+  }
+
+  // Replay applies commits in log order, so the last one logged must be the value the tree holds.
+  // With a key's lock dropped before its commit was appended, two writers could apply in one order
+  // and log in the other, and recovery would bring back a value that had been overwritten.
+  std::unordered_map<std::uint64_t, std::string> pending;
+  std::string replayed;
+  for (const auto& record : wal.Replay().committed) {
+    if (record.upsert.has_value()) {
+      const auto& value = record.upsert->value;
+      pending[record.txn_id] =
+          std::string(reinterpret_cast<const char*>(value.data()), value.size());
+    } else if (record.type == RecordType::kTxnCommit && pending.contains(record.txn_id)) {
+      replayed = pending[record.txn_id];
+    }
+  }
+  const auto stored = btree.Find("hot");
+  ASSERT_TRUE(stored.has_value());
+  EXPECT_EQ(replayed, std::get<std::string>(stored->value));
+}
+
+TEST(WorkerTest, LogsOnlyValueLogPointerForSpilledValues) {
+  TransactionReceiver receiver{};
+  LockManager lock_manager{};
+  const auto dir = std::filesystem::temp_directory_path() / "jubilant-worker-wal-spill";
+  std::filesystem::remove_all(dir);
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 16U, .root_hint = 0});
+  WalManager wal{dir};
+  bool value_log_synced = false;
+  wal.SetPreSyncHook([&]() {
+    vlog.Sync();
+    value_log_synced = true;
+  });
+
+  std::mutex results_mutex;
+  std::condition_variable results_cv;
+  std::vector<TransactionResult> results;
+
+  Worker worker{"worker-0", receiver, lock_manager, btree,
+                [&](TransactionResult result) {
+                  std::lock_guard guard(results_mutex);
+                  results.push_back(std::move(result));
+                  results_cv.notify_all();
+                },
+                &wal};
+  worker.Start();
+
+  const std::string large(4096, 'z');
+  Record record{};
+  record.value = large;
+  Operation set_op{.type = OperationType::kSet, .key = "blob", .value = record};
+  TransactionRequest request{.id = 9, .operations = {set_op}};
+  request.durability = DurabilityClass::kSync;
+  ASSERT_TRUE(receiver.Enqueue(request));
+
+  std::unique_lock results_lock{results_mutex};
+  ASSERT_TRUE(results_cv.wait_for(results_lock, std::chrono::milliseconds(200),
+                                  [&results]() { return !results.empty(); }));
+  results_lock.unlock();
+
+  receiver.Stop();
+  worker.Stop();
+
+  ASSERT_EQ(results.front().state, TransactionState::kCommitted);
+  EXPECT_TRUE(value_log_synced);
+
+  const auto replay = wal.Replay();
+  ASSERT_EQ(replay.committed.size(), 3U);
+  const auto& upsert = replay.committed[1].upsert;
+  ASSERT_TRUE(upsert.has_value());
+  EXPECT_TRUE(upsert->value.empty());
+  EXPECT_EQ(upsert->value_kind, jubilant::storage::wal::ValueKind::kString);
+  ASSERT_TRUE(upsert->value_ptr.has_value());
+
+  const auto stored = vlog.Read(*upsert->value_ptr);
+  ASSERT_TRUE(stored.has_value());
+  EXPECT_EQ(stored->size(), large.size());
+
+  const auto found = btree.Find("blob");
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(std::get<std::string>(found->value), large);
+}
+
+TEST(WorkerTest, SnapshotReadsTakeNoKeyLocksAndSeeOnlyCommittedWrites) {
+  TransactionReceiver receiver{};
+  LockManager lock_manager{};
+  const auto dir = std::filesystem::temp_directory_path() / "jubilant-worker-snapshot";
+  std::filesystem::remove_all(dir);
+  Pager pager = Pager::Open(dir / "data.pages", jubilant::storage::kDefaultPageSize);
+  ValueLog vlog(dir / "vlog");
+  jubilant::storage::btree::BTree btree(jubilant::storage::btree::BTree::Config{
+      .pager = &pager, .value_log = &vlog, .inline_threshold = 128U, .root_hint = 0});
+  WalManager wal{dir};
+  SnapshotRegistry snapshots;
+
+  std::mutex results_mutex;
+  std::condition_variable results_cv;
+  std::vector<TransactionResult> results;
+
+  Worker worker{"worker-0",
+                receiver,
+                lock_manager,
+                btree,
+                [&](TransactionResult result) {
+                  std::lock_guard guard(results_mutex);
+                  results.push_back(std::move(result));
+                  results_cv.notify_all();
+                },
+                &wal,
+                nullptr,
+                nullptr,
+                &snapshots};
+  worker.Start();
+  const auto wait_for = [&](std::size_t count) {
+    std::unique_lock results_lock{results_mutex};
+    return results_cv.wait_for(results_lock, std::chrono::milliseconds(200),
+                               [&]() { return results.size() >= count; });
+  };
+
+  Record record{};
+  record.value = static_cast<std::int64_t>(7);
+  Operation set_op{.type = OperationType::kSet, .key = "ledger", .value = record};
+  Operation get_op{.type = OperationType::kGet, .key = "ledger", .value = std::nullopt};
+  TransactionRequest write{.id = 1, .operations = {set_op}};
+  write.durability = DurabilityClass::kSync;
+  ASSERT_TRUE(receiver.Enqueue(write));
+  ASSERT_TRUE(wait_for(1));
+  EXPECT_GT(snapshots.visible_lsn(), 0U);
+
+  // A writer holding the key would block a locking read; the snapshot read goes around it.
+  lock_manager.Acquire("ledger", LockMode::kExclusive);
+  TransactionRequest read{.id = 2, .operations = {get_op}};
+  read.snapshot = true;
+  ASSERT_TRUE(receiver.Enqueue(read));
+  const bool served = wait_for(2);
+  lock_manager.Release("ledger", LockMode::kExclusive);
+  ASSERT_TRUE(served);
+
+  // Snapshot transactions may only read.
+  TransactionRequest mixed = write;
+  mixed.id = 3;
+  mixed.snapshot = true;
+  ASSERT_TRUE(receiver.Enqueue(mixed));
+  ASSERT_TRUE(wait_for(3));
+
+  receiver.Stop();
+  worker.Stop();
+
+  ASSERT_EQ(results.size(), 3U);
+  EXPECT_EQ(results[1].state, TransactionState::kCommitted);
+  ASSERT_EQ(results[1].operations.size(), 1U);
+  ASSERT_TRUE(results[1].operations[0].value.has_value());
+  EXPECT_EQ(std::get<std::int64_t>(results[1].operations[0].value->value), 7);
+  EXPECT_EQ(results[2].state, TransactionState::kAborted);
+  EXPECT_EQ(snapshots.open_snapshots(), 0U);
+  // The commit pruned its own history once it was visible.
+  EXPECT_EQ(btree.retained_versions(), 0U);
+}
+
 TEST(ServerTest, SubmitsAndDrainsTransactions) {
   const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-scaffold";
   std::filesystem::remove_all(temp_dir);
@@ -136,3 +454,335 @@ TEST(ServerTest, SubmitsAndDrainsTransactions) {
   EXPECT_EQ(result.id, 7U);
   EXPECT_EQ(result.state, TransactionState::kCommitted);
 }
+
+TEST(ServerTest, MultiKeyTransactionsAreIsolatedFromEachOther) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-2pl";
+  std::filesystem::remove_all(temp_dir);
+
+  Server server{temp_dir, 4};
+  server.Start();
+
+  // Writers set both balances to the same value; readers must never see them disagree, which
+  // per-operation locking allowed whenever a writer landed between a reader's two gets.
+  constexpr std::uint64_t kTransactions = 400;
+  for (std::uint64_t id = 1; id <= kTransactions; ++id) {
+    TransactionRequest request{};
+    request.id = id;
+    request.durability = DurabilityClass::kAsync;
+    if (id % 2 == 0) {
+      Record record{};
+      record.value = static_cast<std::int64_t>(id);
+      request.operations = {
+          Operation{.type = OperationType::kSet, .key = "alice", .value = record},
+          Operation{.type = OperationType::kSet, .key = "bob", .value = record}};
+    } else {
+      request.operations = {
+          Operation{.type = OperationType::kGet, .key = "bob", .value = std::nullopt},
+          Operation{.type = OperationType::kGet, .key = "alice", .value = std::nullopt}};
+    }
+    ASSERT_TRUE(server.SubmitTransaction(request));
+  }
+
+  std::vector<TransactionResult> drained;
+  for (int i = 0; i < 500 && drained.size() < kTransactions; ++i) {
+    server.WaitForResults(std::chrono::milliseconds(10));
+    auto chunk = server.DrainCompleted();
+    drained.insert(drained.end(), std::make_move_iterator(chunk.begin()),
+                   std::make_move_iterator(chunk.end()));
+  }
+  server.Stop();
+
+  ASSERT_EQ(drained.size(), kTransactions);
+  for (const auto& result : drained) {
+    EXPECT_EQ(result.state, TransactionState::kCommitted);
+    if (result.id % 2 == 0 || result.operations.size() != 2) {
+      continue;
+    }
+    const auto& bob = result.operations[0].value;
+    const auto& alice = result.operations[1].value;
+    ASSERT_EQ(bob.has_value(), alice.has_value());
+    if (bob.has_value() && alice.has_value()) {
+      EXPECT_EQ(std::get<std::int64_t>(bob->value), std::get<std::int64_t>(alice->value));
+    }
+  }
+}
+
+TEST(ServerTest, SnapshotReadsSeeWholeCommits) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-snapshot";
+  std::filesystem::remove_all(temp_dir);
+
+  Server server{temp_dir, 4};
+  server.Start();
+
+  // As above, but the readers take no locks: they must still see both balances from one commit.
+  constexpr std::uint64_t kTransactions = 400;
+  for (std::uint64_t id = 1; id <= kTransactions; ++id) {
+    TransactionRequest request{};
+    request.id = id;
+    request.durability = DurabilityClass::kAsync;
+    if (id % 2 == 0) {
+      Record record{};
+      record.value = static_cast<std::int64_t>(id);
+      request.operations = {
+          Operation{.type = OperationType::kSet, .key = "alice", .value = record},
+          Operation{.type = OperationType::kSet, .key = "bob", .value = record}};
+    } else {
+      request.snapshot = true;
+      request.operations = {
+          Operation{.type = OperationType::kGet, .key = "bob", .value = std::nullopt},
+          Operation{.type = OperationType::kGet, .key = "alice", .value = std::nullopt}};
+    }
+    ASSERT_TRUE(server.SubmitTransaction(request));
+  }
+
+  std::vector<TransactionResult> drained;
+  for (int i = 0; i < 500 && drained.size() < kTransactions; ++i) {
+    server.WaitForResults(std::chrono::milliseconds(10));
+    auto chunk = server.DrainCompleted();
+    drained.insert(drained.end(), std::make_move_iterator(chunk.begin()),
+                   std::make_move_iterator(chunk.end()));
+  }
+  server.Stop();
+
+  ASSERT_EQ(drained.size(), kTransactions);
+  for (const auto& result : drained) {
+    EXPECT_EQ(result.state, TransactionState::kCommitted);
+    if (result.id % 2 == 0 || result.operations.size() != 2) {
+      continue;
+    }
+    const auto& bob = result.operations[0].value;
+    const auto& alice = result.operations[1].value;
+    ASSERT_EQ(bob.has_value(), alice.has_value());
+    if (bob.has_value() && alice.has_value()) {
+      EXPECT_EQ(std::get<std::int64_t>(bob->value), std::get<std::int64_t>(alice->value));
+    }
+  }
+}
+
+TEST(ServerTest, RecoversWalTailAndCheckpointsDirtyLeaves) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-checkpoint";
+  std::filesystem::remove_all(temp_dir);
+
+  // A commit that only ever reached the WAL, as after a crash before any checkpoint.
+  const std::string value = "from-wal";
+  {
+    WalManager wal{temp_dir};
+    std::array<jubilant::storage::wal::WalOp, 1> ops{};
+    ops[0].type = RecordType::kUpsert;
+    ops[0].key = "recovered";
+    ops[0].value = std::as_bytes(std::span<const char>(value));
+    ops[0].value_kind = jubilant::storage::wal::ValueKind::kString;
+    EXPECT_EQ(wal.AppendTransaction(1, ops), 3U);
+    wal.Flush();
+  }
+
+  // Seal the segment at the first checkpoint so releasing it is observable.
+  auto config = jubilant::config::ConfigLoader::Default(temp_dir);
+  config.wal_segment_bytes = 1;
+  Server server{config, 1};
+  server.Start();
+
+  Operation get_op{.type = OperationType::kGet, .key = "recovered", .value = std::nullopt};
+  ASSERT_TRUE(server.SubmitTransaction(TransactionRequest{.id = 2, .operations = {get_op}}));
+  std::vector<TransactionResult> drained;
+  for (int i = 0; i < 50 && drained.empty(); ++i) {
+    server.WaitForResults(std::chrono::milliseconds(20));
+    drained = server.DrainCompleted();
+  }
+  ASSERT_EQ(drained.size(), 1U);
+  ASSERT_EQ(drained.front().operations.size(), 1U);
+  ASSERT_TRUE(drained.front().operations.front().value.has_value());
+  EXPECT_EQ(std::get<std::string>(drained.front().operations.front().value->value), value);
+
+  const auto snapshot = server.Checkpoint();
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->lsn, 3U);
+  EXPECT_GE(snapshot->pages_flushed, 1U);
+  EXPECT_FALSE(server.Checkpoint().has_value());
+
+  const auto superblock = jubilant::meta::SuperBlockStore{temp_dir}.LoadActive();
+  ASSERT_TRUE(superblock.has_value());
+  EXPECT_EQ(superblock->last_checkpoint_lsn, 3U);
+  EXPECT_EQ(superblock->checkpoint_wal_segment, 0U);
+  EXPECT_GT(superblock->checkpoint_wal_offset, 0U);
+  EXPECT_FALSE(std::filesystem::exists(jubilant::storage::WalSegmentPath(temp_dir, 0)));
+  const auto stats = server.checkpoint_stats();
+  EXPECT_EQ(stats.checkpoints, 1U);
+  EXPECT_EQ(stats.bytes_flushed, snapshot->bytes_flushed);
+  EXPECT_EQ(stats.lag_lsns, 0U);
+  server.Stop();
+
+  // A commit logged after the checkpoint is recovered from the tail alone, even though the segment
+  // the checkpoint position names is gone.
+  const std::string tail_value = "from-tail";
+  {
+    WalManager wal{temp_dir, jubilant::storage::wal::WalEncoding::kFlatBuffer,
+                   jubilant::storage::wal::WalPosition{.segment = 0, .offset = 0, .lsn = 3}};
+    EXPECT_EQ(wal.next_lsn(), 5U);
+    std::array<jubilant::storage::wal::WalOp, 1> ops{};
+    ops[0].type = RecordType::kUpsert;
+    ops[0].key = "tail";
+    ops[0].value = std::as_bytes(std::span<const char>(tail_value));
+    ops[0].value_kind = jubilant::storage::wal::ValueKind::kString;
+    (void)wal.AppendTransaction(3, ops);
+    wal.Flush();
+  }
+
+  Server reopened{config, 1};
+  reopened.Start();
+  Operation tail_get{.type = OperationType::kGet, .key = "tail", .value = std::nullopt};
+  ASSERT_TRUE(reopened.SubmitTransaction(TransactionRequest{.id = 4, .operations = {tail_get}}));
+  drained.clear();
+  for (int i = 0; i < 50 && drained.empty(); ++i) {
+    reopened.WaitForResults(std::chrono::milliseconds(20));
+    drained = reopened.DrainCompleted();
+  }
+  ASSERT_EQ(drained.size(), 1U);
+  ASSERT_TRUE(drained.front().operations.front().value.has_value());
+  EXPECT_EQ(std::get<std::string>(drained.front().operations.front().value->value), tail_value);
+  reopened.Stop();
+}
+
+TEST(ServerTest, RefusesARetiredWalSchemaWithoutTouchingTheLog) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-retired-wal";
+  std::filesystem::remove_all(temp_dir);
+
+  {
+    WalManager wal{temp_dir};
+    (void)wal.Append(jubilant::storage::wal::WalRecord{.type = RecordType::kTxnBegin,
+                                                       .txn_id = 1,
+                                                       .upsert = std::nullopt,
+                                                       .tombstone_key = std::nullopt});
+    wal.Flush();
+  }
+  jubilant::meta::ManifestStore manifest_store{temp_dir};
+  auto manifest = jubilant::meta::ManifestStore::NewDefault("retired-wal");
+  manifest.wal_schema = "wal-v1";
+  ASSERT_TRUE(manifest_store.Persist(manifest));
+  const auto segment = jubilant::storage::WalSegmentPath(temp_dir, 0);
+  const auto size_before = std::filesystem::file_size(segment);
+
+  // Read with the trailer framing, the old log would look torn and be truncated.
+  const auto config = jubilant::config::ConfigLoader::Default(temp_dir);
+  EXPECT_THROW(Server(config, 1), std::runtime_error);
+  EXPECT_EQ(std::filesystem::file_size(segment), size_before);
+  const auto kept = manifest_store.Load();
+  ASSERT_TRUE(kept.has_value());
+  EXPECT_EQ(kept->wal_schema, "wal-v1");
+}
+
+TEST(ServerTest, SweepsExpiredRecordsThroughTheWal) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-ttl-sweep";
+  std::filesystem::remove_all(temp_dir);
+
+  // One record long expired and one that never expires, recovered from the WAL at startup.
+  const std::string value = "value";
+  {
+    WalManager wal{temp_dir};
+    std::array<jubilant::storage::wal::WalOp, 2> ops{};
+    ops[0].type = RecordType::kUpsert;
+    ops[0].key = "expired";
+    ops[0].value = std::as_bytes(std::span<const char>(value));
+    ops[0].value_kind = jubilant::storage::wal::ValueKind::kString;
+    ops[0].ttl_epoch_seconds = 1;
+    ops[1] = ops[0];
+    ops[1].key = "forever";
+    ops[1].ttl_epoch_seconds = 0;
+    (void)wal.AppendTransaction(1, ops);
+    wal.Flush();
+  }
+
+  // Keep the background sweeper out of the way so the pass below does the work.
+  auto config = jubilant::config::ConfigLoader::Default(temp_dir);
+  config.ttl_sweep_interval_ms = 60'000;
+  Server server{config, 1};
+  server.Start();
+  EXPECT_EQ(server.ttl_sweep_stats().tracked, 1U);
+  EXPECT_EQ(server.SweepExpired(), 1U);
+  EXPECT_EQ(server.SweepExpired(), 0U);
+
+  const auto stats = server.ttl_sweep_stats();
+  EXPECT_EQ(stats.passes, 2U);
+  EXPECT_EQ(stats.records_expired, 1U);
+  EXPECT_EQ(stats.tracked, 0U);
+  server.Stop();
+
+  const WalManager wal{temp_dir};
+  bool tombstoned = false;
+  for (const auto& record : wal.Replay().committed) {
+    if (record.type == RecordType::kTombstone && record.tombstone_key == "expired") {
+      tombstoned = true;
+    }
+  }
+  EXPECT_TRUE(tombstoned);
+}
+
+TEST(ServerTest, CollectsValueLogGarbageInTheBackground) {
+  const auto temp_dir = std::filesystem::temp_directory_path() / "jubilant-server-vlog-gc";
+  std::filesystem::remove_all(temp_dir);
+
+  // Four spilled values fill a segment, so overwriting one key leaves sealed segments all but dead.
+  auto config = jubilant::config::ConfigLoader::Default(temp_dir);
+  config.vlog_segment_bytes = 16 * 1024;
+  config.vlog_gc_interval_ms = 5;
+  // Checkpoints only when the test asks, so the retired segments are still on disk until then.
+  config.checkpoint_interval_ms = 60'000;
+  Server server{config, 1};
+  server.Start();
+
+  std::uint32_t state = 0x9E3779B9U;
+  std::string last;
+  for (std::uint64_t id = 1; id <= 24; ++id) {
+    last.assign(3000, '\0');
+    for (auto& character : last) {
+      state = state * 1664525U + 1013904223U;
+      character = static_cast<char>(state >> 24U);
+    }
+    Record record{};
+    record.value = last;
+    Operation set_op{.type = OperationType::kSet, .key = "big", .value = record};
+    ASSERT_TRUE(server.SubmitTransaction(TransactionRequest{
+        .id = id, .operations = {set_op}, .durability = DurabilityClass::kSync}));
+    std::vector<TransactionResult> drained;
+    for (int i = 0; i < 50 && drained.empty(); ++i) {
+      server.WaitForResults(std::chrono::milliseconds(20));
+      drained = server.DrainCompleted();
+    }
+    ASSERT_EQ(drained.size(), 1U);
+    ASSERT_EQ(drained.front().state, TransactionState::kCommitted);
+  }
+
+  for (int i = 0; i < 200 && server.value_log_gc_stats().segments_retired == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_GT(server.value_log_gc_stats().segments_retired, 0U);
+  EXPECT_EQ(server.value_log_gc_stats().failures, 0U);
+
+  // The background pass only retires segments; a checkpoint covering the repointed leaf deletes
+  // them.
+  const auto segment_files = [&temp_dir]() {
+    std::size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(temp_dir / "vlog")) {
+      count += entry.path().extension() == ".seg" ? 1U : 0U;
+    }
+    return count;
+  };
+  const auto before = segment_files();
+  ASSERT_TRUE(server.Checkpoint().has_value());
+  EXPECT_LT(segment_files(), before);
+  server.Stop();
+
+  Server reopened{config, 1};
+  reopened.Start();
+  Operation get_op{.type = OperationType::kGet, .key = "big", .value = std::nullopt};
+  ASSERT_TRUE(reopened.SubmitTransaction(TransactionRequest{.id = 100, .operations = {get_op}}));
+  std::vector<TransactionResult> drained;
+  for (int i = 0; i < 50 && drained.empty(); ++i) {
+    reopened.WaitForResults(std::chrono::milliseconds(20));
+    drained = reopened.DrainCompleted();
+  }
+  ASSERT_EQ(drained.size(), 1U);
+  ASSERT_TRUE(drained.front().operations.front().value.has_value());
+  EXPECT_EQ(std::get<std::string>(drained.front().operations.front().value->value), last);
+  reopened.Stop();
+}
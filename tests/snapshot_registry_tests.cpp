@@ -0,0 +1,46 @@
+#include "txn/snapshot_registry.h"
+
+#include <gtest/gtest.h>
+#include <optional>
+
+using jubilant::txn::SnapshotRegistry;
+
+TEST(SnapshotRegistryTest, VisibleLsnWaitsForCommitsThatBeganEarlier) {
+  SnapshotRegistry registry;
+  EXPECT_EQ(registry.visible_lsn(), 0U);
+
+  const auto first = registry.BeginCommit();
+  const auto second = registry.BeginCommit();
+  // The later commit finishes first; the earlier one may still get a lower LSN.
+  registry.EndCommit(second, 12);
+  EXPECT_EQ(registry.visible_lsn(), 0U);
+  registry.EndCommit(first, 10);
+  EXPECT_EQ(registry.visible_lsn(), 12U);
+
+  // A commit that began after LSN 12 was published cannot land at or below it.
+  const auto third = registry.BeginCommit();
+  const auto fourth = registry.BeginCommit();
+  registry.EndCommit(fourth, 20);
+  EXPECT_EQ(registry.visible_lsn(), 12U);
+  registry.EndCommit(third, std::nullopt);
+  EXPECT_EQ(registry.visible_lsn(), 20U);
+}
+
+TEST(SnapshotRegistryTest, HorizonFollowsTheOldestOpenSnapshot) {
+  SnapshotRegistry registry;
+  registry.EndCommit(registry.BeginCommit(), 5);
+  const auto older = registry.Open();
+  EXPECT_EQ(older, 5U);
+
+  registry.EndCommit(registry.BeginCommit(), 9);
+  const auto newer = registry.Open();
+  EXPECT_EQ(newer, 9U);
+  EXPECT_EQ(registry.open_snapshots(), 2U);
+  EXPECT_EQ(registry.horizon(), 5U);
+
+  registry.Close(older);
+  EXPECT_EQ(registry.horizon(), 9U);
+  registry.Close(newer);
+  EXPECT_EQ(registry.open_snapshots(), 0U);
+  EXPECT_EQ(registry.horizon(), registry.visible_lsn());
+}
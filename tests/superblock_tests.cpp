@@ -1,9 +1,13 @@
 #include "meta/superblock.h"
+#include "storage/checksum.h"
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <span>
 
 using jubilant::meta::SuperBlock;
 using jubilant::meta::SuperBlockStore;
@@ -95,3 +99,38 @@ TEST(SuperBlockStoreTest, FallsBackWhenNewerCrcCorrupted) {
   EXPECT_EQ(active->generation, 1U);
   EXPECT_EQ(active->root_page_id, 10U);
 }
+
+TEST(SuperBlockStoreTest, RecordsCheckpointWalPositionAndReadsOlderLayout) {
+  const auto dir = TempDir("jubilant-superblock-wal-position");
+  SuperBlockStore store{dir};
+
+  SuperBlock block{};
+  block.root_page_id = 7;
+  block.last_checkpoint_lsn = 41;
+  block.checkpoint_wal_segment = 3;
+  block.checkpoint_wal_offset = 8192;
+  ASSERT_TRUE(store.WriteNext(block));
+
+  const auto active = store.LoadActive();
+  ASSERT_TRUE(active.has_value());
+  EXPECT_EQ(active->last_checkpoint_lsn, 41U);
+  EXPECT_EQ(active->checkpoint_wal_segment, 3U);
+  EXPECT_EQ(active->checkpoint_wal_offset, 8192U);
+
+  // A superblock from before WAL positions were recorded still opens, replaying from the start.
+  std::array<std::uint64_t, 6> legacy{2, 9, 55, 0, 0, 0};
+  legacy[5] = jubilant::storage::ComputeCrc32(std::span<const std::byte>(
+      reinterpret_cast<const std::byte*>(legacy.data()), 5 * sizeof(std::uint64_t)));
+  {
+    std::ofstream out(dir / "SUPERBLOCK_B", std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(legacy.data()),
+              static_cast<std::streamsize>(legacy.size() * sizeof(std::uint64_t)));
+  }
+  const auto upgraded = store.LoadActive();
+  ASSERT_TRUE(upgraded.has_value());
+  EXPECT_EQ(upgraded->generation, 2U);
+  EXPECT_EQ(upgraded->root_page_id, 9U);
+  EXPECT_EQ(upgraded->last_checkpoint_lsn, 55U);
+  EXPECT_EQ(upgraded->checkpoint_wal_segment, 0U);
+  EXPECT_EQ(upgraded->checkpoint_wal_offset, 0U);
+}
@@ -0,0 +1,43 @@
+#include "storage/ttl/ttl_clock.h"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <utility>
+
+using jubilant::storage::ttl::Calibration;
+using jubilant::storage::ttl::TtlClock;
+
+TEST(TtlClockTest, JudgesExpiryAgainstOneReading) {
+  EXPECT_FALSE(TtlClock::IsExpiredAt(0, 100));
+  EXPECT_TRUE(TtlClock::IsExpiredAt(99, 100));
+  EXPECT_TRUE(TtlClock::IsExpiredAt(100, 100));
+  EXPECT_FALSE(TtlClock::IsExpiredAt(101, 100));
+}
+
+TEST(TtlClockTest, TickerPublishesTheWallEstimate) {
+  TtlClock clock{TtlClock::CalibrateNow()};
+  clock.StartTicker();
+  const auto published = clock.NowSeconds();
+  const auto precise = clock.WallNowSeconds();
+  EXPECT_LE(published, precise);
+  EXPECT_LE(precise - published, 1U);
+  EXPECT_TRUE(clock.IsExpired(published));
+  EXPECT_FALSE(clock.IsExpired(published + 60));
+  EXPECT_FALSE(clock.IsExpired(0));
+
+  // The ticker lives behind the clock, so it keeps running after a move.
+  TtlClock moved{std::move(clock)};
+  EXPECT_GE(moved.NowSeconds(), published);
+  moved.StopTicker();
+}
+
+TEST(TtlClockTest, ReadsTheClockWithoutATicker) {
+  // Without a ticker every read goes to the monotonic clock, offset from the calibration.
+  const auto calibration = TtlClock::CalibrateNow();
+  const TtlClock clock{Calibration{.wall_clock_unix_seconds = 1000,
+                                   .monotonic_time_nanos = calibration.monotonic_time_nanos}};
+  EXPECT_GE(clock.NowSeconds(), 1000U);
+  EXPECT_LE(clock.NowSeconds(), 1001U);
+  EXPECT_TRUE(clock.IsExpired(1000));
+  EXPECT_FALSE(clock.IsExpired(2000));
+}
@@ -0,0 +1,77 @@
+#include "storage/ttl/ttl_sweeper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using jubilant::storage::ttl::SweepOptions;
+using jubilant::storage::ttl::TtlSweeper;
+
+TEST(TtlSweeperTest, SweepsInBatchesUntilOneComesBackShort) {
+  TtlSweeper sweeper;
+  std::size_t expired = 10;
+  std::vector<std::size_t> limits;
+
+  const auto removed = sweeper.RunPass(SweepOptions{.batch_size = 4},
+                                       [&](std::size_t limit) {
+                                         limits.push_back(limit);
+                                         const auto batch = std::min(limit, expired);
+                                         expired -= batch;
+                                         return batch;
+                                       });
+
+  EXPECT_EQ(removed, 10U);
+  EXPECT_EQ(limits, (std::vector<std::size_t>{4, 4, 4}));
+  const auto stats = sweeper.stats();
+  EXPECT_EQ(stats.passes, 1U);
+  EXPECT_EQ(stats.batches, 3U);
+  EXPECT_EQ(stats.records_expired, 10U);
+  EXPECT_EQ(stats.failures, 0U);
+}
+
+TEST(TtlSweeperTest, PacesBatchesToTheConfiguredRate) {
+  TtlSweeper sweeper;
+  std::size_t expired = 40;
+  const auto started = std::chrono::steady_clock::now();
+
+  // 40 records at 400/s, 10 per batch: the three full batches each wait out 25ms.
+  (void)sweeper.RunPass(SweepOptions{.batch_size = 10, .max_per_second = 400},
+                        [&](std::size_t limit) {
+                          const auto batch = std::min(limit, expired);
+                          expired -= batch;
+                          return batch;
+                        });
+
+  const auto elapsed = std::chrono::steady_clock::now() - started;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(70));
+  EXPECT_GT(sweeper.stats().throttled, std::chrono::nanoseconds::zero());
+}
+
+TEST(TtlSweeperTest, CountsFailedBatchesAndKeepsRunningInTheBackground) {
+  TtlSweeper sweeper;
+  std::atomic<int> calls{0};
+  sweeper.Start(SweepOptions{.interval = std::chrono::milliseconds(5), .batch_size = 8},
+                [&](std::size_t) -> std::size_t {
+                  if (calls.fetch_add(1) == 0) {
+                    throw std::runtime_error("WAL append failed");
+                  }
+                  return 1;
+                });
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (sweeper.stats().records_expired < 2 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  sweeper.Stop();
+
+  const auto stats = sweeper.stats();
+  EXPECT_EQ(stats.failures, 1U);
+  EXPECT_GE(stats.records_expired, 2U);
+  EXPECT_GE(stats.passes, 3U);
+}
@@ -0,0 +1,57 @@
+#include "storage/vlog/value_log_collector.h"
+
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+
+using jubilant::storage::vlog::CollectorOptions;
+using jubilant::storage::vlog::GcOptions;
+using jubilant::storage::vlog::GcReport;
+using jubilant::storage::vlog::ValueLogCollector;
+
+TEST(ValueLogCollectorTest, PassesTheLiveRatioAndTotalsWhatWasRetired) {
+  ValueLogCollector collector;
+  double seen_ratio = 0.0;
+
+  const auto report = collector.RunPass(GcOptions{.max_live_ratio = 0.25},
+                                        [&](const GcOptions& options) {
+                                          seen_ratio = options.max_live_ratio;
+                                          return GcReport{.retired_segments = {3, 5},
+                                                          .records_relocated = 7,
+                                                          .bytes_relocated = 700};
+                                        });
+
+  EXPECT_DOUBLE_EQ(seen_ratio, 0.25);
+  EXPECT_EQ(report.retired_segments.size(), 2U);
+  const auto stats = collector.stats();
+  EXPECT_EQ(stats.passes, 1U);
+  EXPECT_EQ(stats.segments_retired, 2U);
+  EXPECT_EQ(stats.records_relocated, 7U);
+  EXPECT_EQ(stats.bytes_relocated, 700U);
+  EXPECT_EQ(stats.failures, 0U);
+}
+
+TEST(ValueLogCollectorTest, CountsFailedPassesAndKeepsRunningInTheBackground) {
+  ValueLogCollector collector;
+  std::atomic<int> calls{0};
+  collector.Start(CollectorOptions{.interval = std::chrono::milliseconds(5)},
+                  [&](const GcOptions&) {
+                    if (calls.fetch_add(1) == 0) {
+                      throw std::runtime_error("Failed to read live value log record");
+                    }
+                    return GcReport{.retired_segments = {1}};
+                  });
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (collector.stats().segments_retired < 2 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  collector.Stop();
+
+  const auto stats = collector.stats();
+  EXPECT_EQ(stats.failures, 1U);
+  EXPECT_GE(stats.segments_retired, 2U);
+  EXPECT_GE(stats.passes, 3U);
+}
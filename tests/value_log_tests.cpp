@@ -1,11 +1,16 @@
 #include "storage/vlog/value_log.h"
+#include "storage/vlog/value_log_appender.h"
 
 #include <cstddef>
 #include <filesystem>
+#include <future>
 #include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 using jubilant::storage::vlog::AppendResult;
+using jubilant::storage::vlog::GcOptions;
 using jubilant::storage::vlog::SegmentPointer;
 using jubilant::storage::vlog::ValueLog;
 
@@ -19,6 +24,19 @@ fs::path TempDir(const std::string& name) {
   return dir;
 }
 
+// Pseudo-random bytes that zstd cannot shrink, so they are stored as-is.
+std::vector<std::byte> Incompressible(std::size_t size) {
+  std::vector<std::byte> data(size);
+  std::uint32_t state = 0x9E3779B9U;
+  for (auto& byte : data) {
+    state ^= state << 13U;
+    state ^= state >> 17U;
+    state ^= state << 5U;
+    byte = static_cast<std::byte>(state);
+  }
+  return data;
+}
+
 } // namespace
 
 TEST(ValueLogTest, AppendsReturnMonotonicPointers) {
@@ -55,3 +73,256 @@ TEST(ValueLogTest, PersistsAndReadsValues) {
   EXPECT_EQ(read_back->size(), payload.size());
   EXPECT_EQ(read_back->at(0), std::byte{0xCC});
 }
+
+TEST(ValueLogTest, RetiredSegmentThatRegainsLiveDataIsKept) {
+  const auto dir = TempDir("value-log-retire-live");
+  ValueLog vlog{dir};
+
+  const auto dead = vlog.Append(std::vector<std::byte>(16, std::byte{0x0D})).pointer;
+  const auto late = vlog.Append(std::vector<std::byte>(16, std::byte{0x0E})).pointer;
+
+  const auto victims = vlog.SelectGcVictims({.max_live_ratio = 0.5, .max_segments = 1});
+  ASSERT_EQ(victims.size(), 1U);
+  vlog.RetireSegments(victims);
+
+  // A reference inserted after the GC pass pins the segment.
+  vlog.MarkLive(late);
+  EXPECT_EQ(vlog.ReleaseRetiredSegments(), 0U);
+  EXPECT_TRUE(vlog.Read(dead).has_value());
+
+  const auto next = vlog.Append(std::vector<std::byte>(4, std::byte{0x01}));
+  EXPECT_EQ(next.pointer.segment_id, 1U);
+  EXPECT_EQ(next.pointer.offset, 0U);
+}
+
+TEST(ValueLogTest, ReleasesOnlyTheSegmentsItIsGiven) {
+  const auto dir = TempDir("value-log-release-some");
+  constexpr std::uint64_t kSegmentBytes = 64;
+  ValueLog vlog{dir, kSegmentBytes};
+
+  const auto first = vlog.Append(std::vector<std::byte>(40, std::byte{0x01})).pointer;
+  const auto second = vlog.Append(std::vector<std::byte>(40, std::byte{0x02})).pointer;
+  ASSERT_NE(first.segment_id, second.segment_id);
+  vlog.RetireSegments(std::vector{first.segment_id});
+  const auto covered = vlog.retired_segments();
+  // Retired after a checkpoint captured its leaves, which may still point into it.
+  vlog.RetireSegments(std::vector{second.segment_id});
+
+  EXPECT_EQ(vlog.ReleaseRetiredSegments(covered), 1U);
+  EXPECT_FALSE(vlog.Read(first).has_value());
+  EXPECT_TRUE(vlog.Read(second).has_value());
+  EXPECT_EQ(vlog.retired_segments(), std::vector{second.segment_id});
+}
+
+TEST(ValueLogTest, HeldAppendsStayOutOfGc) {
+  const auto dir = TempDir("value-log-held");
+  constexpr std::uint64_t kSegmentBytes = 64;
+  ValueLog vlog{dir, kSegmentBytes};
+
+  // Neither record has been reported live yet, as when a writer is still waiting for its locks.
+  auto spilled = vlog.Append(std::vector<std::byte>(40, std::byte{0x01}));
+  auto stream = vlog.BeginAppend(40);
+  const GcOptions everything{.max_live_ratio = 0.5, .max_segments = 8};
+  EXPECT_TRUE(vlog.SelectGcVictims(everything).empty());
+
+  stream.Write(std::vector<std::byte>(40, std::byte{0x02}));
+  auto streamed = stream.Finish();
+  EXPECT_TRUE(vlog.SelectGcVictims(everything).empty());
+
+  // The writer inserted the first and abandoned the second.
+  vlog.MarkLive(spilled.pointer);
+  spilled.hold.reset();
+  streamed.hold.reset();
+  const auto victims = vlog.SelectGcVictims(everything);
+  ASSERT_NE(spilled.pointer.segment_id, streamed.pointer.segment_id);
+  ASSERT_EQ(victims.size(), 1U);
+  EXPECT_EQ(victims.front(), streamed.pointer.segment_id);
+}
+
+TEST(ValueLogTest, RollsOverAtSegmentCapAndResumesAfterReopen) {
+  const auto dir = TempDir("value-log-rollover");
+  constexpr std::uint64_t kSegmentBytes = 64;
+  const std::vector<std::byte> payload(40, std::byte{0x5A});
+
+  SegmentPointer last{};
+  {
+    ValueLog vlog{dir, kSegmentBytes};
+    const auto first = vlog.Append(payload);
+    const auto second = vlog.Append(payload);
+    const auto oversized = vlog.Append(std::vector<std::byte>(100, std::byte{0x01}));
+    EXPECT_EQ(first.pointer.segment_id, 0U);
+    EXPECT_EQ(second.pointer.segment_id, 1U);
+    EXPECT_EQ(second.pointer.offset, 0U);
+    EXPECT_EQ(oversized.pointer.segment_id, 2U);
+    last = oversized.pointer;
+    EXPECT_TRUE(vlog.Read(first.pointer).has_value());
+  }
+
+  // Preallocation must not be mistaken for data when the segment is reopened.
+  EXPECT_EQ(fs::file_size(jubilant::storage::ValueLogSegmentPath(dir, 0)),
+            payload.size() + (sizeof(std::uint32_t) * 2));
+
+  ValueLog reopened{dir, kSegmentBytes};
+  EXPECT_EQ(reopened.usage().size(), 3U);
+  EXPECT_TRUE(reopened.Read(last).has_value());
+  const auto next = reopened.Append(std::vector<std::byte>(4, std::byte{0x02}));
+  EXPECT_EQ(next.pointer.segment_id, 3U);
+}
+
+TEST(ValueLogTest, BuffersSmallAppendsUntilSync) {
+  const auto dir = TempDir("value-log-buffered");
+  ValueLog vlog{dir};
+  const auto segment_path = jubilant::storage::ValueLogSegmentPath(dir, 0);
+
+  const auto small = vlog.Append(std::vector<std::byte>(32, std::byte{0x11}));
+  EXPECT_EQ(fs::file_size(segment_path), 0U);
+  const auto buffered = vlog.Read(small.pointer);
+  ASSERT_TRUE(buffered.has_value());
+  EXPECT_EQ(buffered->size(), 32U);
+  // A pointer without a length takes it from the buffered header, not from the records after it.
+  const auto next = vlog.Append(std::vector<std::byte>(16, std::byte{0x22}));
+  auto unsized = small.pointer;
+  unsized.length = 0;
+  const auto header_sized = vlog.Read(unsized);
+  ASSERT_TRUE(header_sized.has_value());
+  EXPECT_EQ(header_sized->size(), 32U);
+  EXPECT_EQ(vlog.Read(next.pointer)->front(), std::byte{0x22});
+
+  // Values at least as large as the buffer go straight to the file, behind the buffered tail.
+  const auto large = vlog.Append(Incompressible(ValueLog::kAppendBufferBytes));
+  const auto record_overhead = sizeof(std::uint32_t) * 2;
+  EXPECT_EQ(fs::file_size(segment_path),
+            large.pointer.offset + large.pointer.length + record_overhead);
+
+  const auto tail = vlog.Append(std::vector<std::byte>(8, std::byte{0x33}));
+  vlog.Sync();
+  EXPECT_EQ(fs::file_size(segment_path),
+            tail.pointer.offset + tail.pointer.length + record_overhead);
+  const auto from_file = vlog.Read(small.pointer);
+  ASSERT_TRUE(from_file.has_value());
+  EXPECT_EQ(from_file->front(), std::byte{0x11});
+}
+
+TEST(ValueLogTest, StreamsChunkedAppendIntoReservedRecord) {
+  const auto dir = TempDir("value-log-stream");
+  ValueLog vlog{dir};
+
+  const auto before = vlog.Append(std::vector<std::byte>(16, std::byte{0x01}));
+  auto stream = vlog.BeginAppend(10);
+  // Appends made while the stream is open land behind its reservation.
+  const auto during = vlog.Append(std::vector<std::byte>(4, std::byte{0x02}));
+  EXPECT_GT(during.pointer.offset, before.pointer.offset);
+
+  const std::vector<std::byte> first(6, std::byte{0x0A});
+  const std::vector<std::byte> second(4, std::byte{0x0B});
+  stream.Write(first);
+  EXPECT_EQ(stream.remaining(), 4U);
+  EXPECT_THROW(stream.Write(std::vector<std::byte>(5, std::byte{0x0C})), std::invalid_argument);
+  stream.Write(second);
+  const auto streamed = stream.Finish();
+  EXPECT_EQ(streamed.pointer.length, 10U);
+  EXPECT_LT(streamed.pointer.offset, during.pointer.offset);
+
+  vlog.Sync();
+  const auto value = vlog.Read(streamed.pointer);
+  ASSERT_TRUE(value.has_value());
+  std::vector<std::byte> expected = first;
+  expected.insert(expected.end(), second.begin(), second.end());
+  EXPECT_EQ(*value, expected);
+  ASSERT_TRUE(vlog.Read(during.pointer).has_value());
+
+  auto abandoned = vlog.BeginAppend(8);
+  abandoned.Write(std::vector<std::byte>(4, std::byte{0x0D}));
+  EXPECT_THROW((void)abandoned.Finish(), std::logic_error);
+}
+
+TEST(ValueLogTest, CompressesOnlyWhenItPaysOff) {
+  const auto dir = TempDir("value-log-compress");
+  ValueLog vlog{dir};
+
+  std::string document;
+  while (document.size() < 200'000) {
+    document += R"({"user":"jubilant","flags":["a","b"],"score":)" +
+                std::to_string(document.size() % 97) + "}";
+  }
+  const std::vector<std::byte> compressible(
+      reinterpret_cast<const std::byte*>(document.data()),
+      reinterpret_cast<const std::byte*>(document.data() + document.size()));
+  const auto packed = vlog.Append(compressible);
+  EXPECT_LT(packed.pointer.length, compressible.size() / 4);
+
+  const auto noise = Incompressible(200'000);
+  const auto raw = vlog.Append(noise);
+  EXPECT_EQ(raw.pointer.length, noise.size());
+
+  vlog.Sync();
+  std::vector<std::byte> out;
+  ASSERT_TRUE(vlog.ReadInto(packed.pointer, out));
+  EXPECT_EQ(out, compressible);
+  ASSERT_TRUE(vlog.ReadInto(raw.pointer, out));
+  EXPECT_EQ(out, noise);
+
+  // GC copies records still encoded.
+  const auto moved = vlog.Relocate(packed.pointer);
+  EXPECT_EQ(moved.pointer.length, packed.pointer.length);
+  EXPECT_EQ(vlog.Read(moved.pointer), std::optional<std::vector<std::byte>>(compressible));
+}
+
+TEST(ValueLogTest, CachesDecodedReadsWithinBudget) {
+  const auto dir = TempDir("value-log-cache");
+  constexpr std::size_t kCacheBytes = 64U * 1024U;
+  ValueLog vlog{dir, ValueLog::kDefaultSegmentBytes, kCacheBytes};
+
+  const auto hot = vlog.Append(Incompressible(1024));
+  vlog.Sync();
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(vlog.Read(hot.pointer).has_value());
+  }
+  auto stats = vlog.cache_stats();
+  EXPECT_EQ(stats.misses, 1U);
+  EXPECT_EQ(stats.hits, 2U);
+  EXPECT_EQ(stats.bytes, 1024U);
+
+  // Too large to admit: an eighth of the budget is the cap.
+  const auto large = vlog.Append(Incompressible((kCacheBytes / 8) + 1));
+  ASSERT_TRUE(vlog.Read(large.pointer).has_value());
+  EXPECT_EQ(vlog.cache_stats().entries, 1U);
+
+  // Filling the budget evicts the least recently used value first.
+  for (int i = 0; i < 9; ++i) {
+    ASSERT_TRUE(vlog.Read(vlog.Append(Incompressible(8000)).pointer).has_value());
+  }
+  stats = vlog.cache_stats();
+  EXPECT_LE(stats.bytes, kCacheBytes);
+  EXPECT_GT(stats.evictions, 0U);
+  const auto misses = stats.misses;
+  ASSERT_TRUE(vlog.Read(hot.pointer).has_value());
+  EXPECT_EQ(vlog.cache_stats().misses, misses + 1);
+}
+
+TEST(ValueLogTest, AppenderCompletesInSubmissionOrder) {
+  const auto dir = TempDir("value-log-appender");
+  ValueLog vlog{dir};
+  jubilant::storage::vlog::ValueLogAppender appender{vlog};
+
+  std::vector<std::vector<std::byte>> values;
+  for (std::size_t i = 0; i < 8; ++i) {
+    values.push_back(Incompressible(100 + (i * 4096)));
+  }
+  std::vector<std::future<AppendResult>> pending;
+  pending.reserve(values.size());
+  for (const auto& value : values) {
+    pending.push_back(appender.Submit(value));
+  }
+
+  std::uint64_t previous_end = 0;
+  for (std::size_t i = 0; i < pending.size(); ++i) {
+    const auto pointer = pending[i].get().pointer;
+    EXPECT_EQ(pointer.offset, previous_end);
+    previous_end = pointer.offset + pointer.length + (sizeof(std::uint32_t) * 2);
+    EXPECT_EQ(vlog.Read(pointer), std::optional<std::vector<std::byte>>(values[i]));
+  }
+
+  appender.Stop();
+  EXPECT_THROW((void)appender.Submit(values.front()), std::runtime_error);
+}
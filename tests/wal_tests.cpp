@@ -1,13 +1,20 @@
+#include "storage/storage_common.h"
 #include "storage/wal/wal_manager.h"
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <optional>
 #include <string>
 #include <vector>
 
 using jubilant::storage::wal::RecordType;
+using jubilant::storage::wal::WalEncoding;
 using jubilant::storage::wal::WalManager;
+using jubilant::storage::wal::WalOp;
+using jubilant::storage::wal::WalPosition;
 using jubilant::storage::wal::WalRecord;
 
 namespace fs = std::filesystem;
@@ -55,3 +62,219 @@ TEST(WalManagerTest, AssignsMonotonicLsnsAndReplaysFromDisk) {
   EXPECT_EQ(replay.committed.back().type, RecordType::kUpsert);
   EXPECT_EQ(replay.committed.back().lsn, 2U);
 }
+
+TEST(WalManagerTest, TruncatesTornTailOnOpenSoLaterAppendsReplay) {
+  const auto dir = TempDir("jubilant-wal-torn-tail");
+  {
+    WalManager wal{dir};
+    WalRecord begin{};
+    begin.type = RecordType::kTxnBegin;
+    begin.txn_id = 7;
+    (void)wal.Append(begin);
+  }
+
+  const auto wal_path = jubilant::storage::WalSegmentPath(dir, 0);
+  const auto valid_size = fs::file_size(wal_path);
+  {
+    std::ofstream garbage(wal_path, std::ios::binary | std::ios::app);
+    const std::array<char, 6> torn{'\x40', '\x00', '\x00', '\x00', '\x4A', '\x42'};
+    garbage.write(torn.data(), torn.size());
+  }
+  ASSERT_GT(fs::file_size(wal_path), valid_size);
+
+  WalManager reopened{dir};
+  const auto& report = reopened.last_repair();
+  EXPECT_TRUE(report.truncated);
+  EXPECT_EQ(report.last_valid_lsn, 1U);
+  EXPECT_EQ(report.valid_bytes, valid_size);
+  EXPECT_EQ(report.discarded_bytes, 6U);
+  EXPECT_EQ(fs::file_size(wal_path), valid_size);
+
+  WalRecord commit{};
+  commit.type = RecordType::kTxnCommit;
+  commit.txn_id = 7;
+  EXPECT_EQ(reopened.Append(commit), 2U);
+
+  const auto replay = reopened.Replay();
+  ASSERT_EQ(replay.committed.size(), 2U);
+  EXPECT_EQ(replay.committed.back().type, RecordType::kTxnCommit);
+  EXPECT_EQ(replay.valid_bytes, replay.file_bytes);
+
+  const auto offline = WalManager::RepairTail(dir);
+  EXPECT_FALSE(offline.truncated);
+  EXPECT_EQ(offline.records_scanned, 2U);
+}
+
+TEST(WalManagerTest, ViewAppendsRoundTripValuePointersAndTtl) {
+  const auto dir = TempDir("jubilant-wal-views");
+  {
+    WalManager wal{dir};
+    const std::array<std::byte, 3> value{std::byte{0x0A}, std::byte{0x0B}, std::byte{0x0C}};
+    const jubilant::storage::SegmentPointer pointer{.segment_id = 2, .offset = 128, .length = 4096};
+
+    EXPECT_EQ(wal.AppendMarker(RecordType::kTxnBegin, 9), 1U);
+    EXPECT_EQ(wal.AppendUpsert(9, "inline", value, 1700000000), 2U);
+    EXPECT_EQ(wal.AppendUpsert(9, "spilled", {}, 0, pointer), 3U);
+    EXPECT_EQ(wal.AppendTombstone(9, "gone"), 4U);
+    EXPECT_EQ(wal.AppendMarker(RecordType::kTxnCommit, 9), 5U);
+  }
+
+  WalManager reopened{dir};
+  EXPECT_EQ(reopened.next_lsn(), 6U);
+  const auto replay = reopened.Replay();
+  ASSERT_EQ(replay.committed.size(), 5U);
+
+  const auto& inline_record = replay.committed[1];
+  ASSERT_TRUE(inline_record.upsert.has_value());
+  EXPECT_EQ(inline_record.txn_id, 9U);
+  EXPECT_EQ(inline_record.upsert->key, "inline");
+  EXPECT_EQ(inline_record.upsert->value.size(), 3U);
+  EXPECT_EQ(inline_record.upsert->ttl_epoch_seconds, 1700000000U);
+  EXPECT_FALSE(inline_record.upsert->value_ptr.has_value());
+
+  const auto& spilled = replay.committed[2];
+  ASSERT_TRUE(spilled.upsert.has_value());
+  ASSERT_TRUE(spilled.upsert->value_ptr.has_value());
+  EXPECT_EQ(spilled.upsert->value_ptr->segment_id, 2U);
+  EXPECT_EQ(spilled.upsert->value_ptr->offset, 128U);
+  EXPECT_EQ(spilled.upsert->value_ptr->length, 4096U);
+  EXPECT_TRUE(spilled.upsert->value.empty());
+
+  ASSERT_TRUE(replay.committed[3].tombstone_key.has_value());
+  EXPECT_EQ(*replay.committed[3].tombstone_key, "gone");
+  EXPECT_EQ(replay.committed[4].type, RecordType::kTxnCommit);
+}
+
+TEST(WalManagerTest, CompactEncodingBatchesTransactionsIntoFewerBytes) {
+  const std::array<std::byte, 8> value{std::byte{0x2A}};
+  std::array<WalOp, 2> ops{};
+  ops[0].type = RecordType::kUpsert;
+  ops[0].key = "counter:01";
+  ops[0].value = value;
+  ops[1].type = RecordType::kTombstone;
+  ops[1].key = "counter:02";
+
+  std::array<std::uintmax_t, 2> segment_bytes{};
+  for (const auto encoding : {WalEncoding::kFlatBuffer, WalEncoding::kCompact}) {
+    const auto dir = TempDir(encoding == WalEncoding::kCompact ? "jubilant-wal-compact"
+                                                                : "jubilant-wal-flatbuffer");
+    {
+      WalManager wal{dir, encoding};
+      EXPECT_EQ(wal.AppendTransaction(11, ops), 4U);
+      EXPECT_EQ(wal.AppendMarker(RecordType::kTxnBegin, 12), 5U);
+    }
+
+    WalManager reopened{dir, encoding};
+    EXPECT_EQ(reopened.next_lsn(), 6U);
+    const auto replay = reopened.Replay();
+    ASSERT_EQ(replay.committed.size(), 5U);
+    EXPECT_EQ(replay.committed[0].type, RecordType::kTxnBegin);
+    ASSERT_TRUE(replay.committed[1].upsert.has_value());
+    EXPECT_EQ(replay.committed[1].upsert->key, "counter:01");
+    EXPECT_EQ(replay.committed[1].upsert->value.size(), value.size());
+    EXPECT_EQ(replay.committed[1].txn_id, 11U);
+    ASSERT_TRUE(replay.committed[2].tombstone_key.has_value());
+    EXPECT_EQ(*replay.committed[2].tombstone_key, "counter:02");
+    EXPECT_EQ(replay.committed[3].type, RecordType::kTxnCommit);
+    EXPECT_EQ(replay.committed[3].lsn, 4U);
+    EXPECT_EQ(replay.committed[4].txn_id, 12U);
+
+    segment_bytes[static_cast<std::size_t>(encoding)] =
+        fs::file_size(jubilant::storage::WalSegmentPath(dir, 0));
+  }
+
+  EXPECT_LT(segment_bytes[1] * 3, segment_bytes[0]);
+}
+
+TEST(WalManagerTest, GroupCommitReleasesWaitersAfterOneSync) {
+  const auto dir = TempDir("jubilant-wal-group-commit");
+  WalManager wal{dir};
+  wal.StartGroupCommit(std::chrono::milliseconds(5));
+
+  const auto first = wal.AppendMarker(RecordType::kTxnCommit, 1);
+  const auto second = wal.AppendMarker(RecordType::kTxnCommit, 2);
+  EXPECT_LT(first, second);
+
+  EXPECT_TRUE(wal.WaitDurable(second));
+  EXPECT_GE(wal.durable_lsn(), second);
+
+  // Appends after the flusher stops are synced by the caller instead.
+  wal.StopGroupCommit();
+  const auto third = wal.AppendMarker(RecordType::kTxnCommit, 3);
+  EXPECT_TRUE(wal.WaitDurable(third));
+  EXPECT_EQ(wal.durable_lsn(), third);
+}
+
+TEST(WalManagerTest, RollsOverAndReleasesSegmentsACheckpointCovers) {
+  const auto dir = TempDir("jubilant-wal-rollover");
+  {
+    WalManager wal{dir};
+    EXPECT_EQ(wal.AppendMarker(RecordType::kTxnCommit, 1), 1U);
+    EXPECT_EQ(wal.AppendMarker(RecordType::kTxnCommit, 2), 2U);
+
+    EXPECT_EQ(wal.Rollover(2), 3U);
+    EXPECT_EQ(wal.active_segment(), 1U);
+    EXPECT_GE(wal.durable_lsn(), 2U);
+    EXPECT_EQ(wal.AppendMarker(RecordType::kTxnCommit, 3), 4U);
+    EXPECT_TRUE(fs::exists(jubilant::storage::WalSegmentPath(dir, 0)));
+
+    const auto replay = wal.Replay();
+    ASSERT_EQ(replay.committed.size(), 4U);
+    EXPECT_EQ(replay.committed[2].type, RecordType::kCheckpoint);
+    EXPECT_EQ(replay.committed[2].txn_id, 2U);
+    EXPECT_EQ(replay.last_replayed, 4U);
+
+    // Segment 0 ends at LSN 2, so a checkpoint at 1 does not cover it yet.
+    EXPECT_EQ(wal.ReleaseSegmentsThrough(1), 0U);
+    EXPECT_EQ(wal.ReleaseSegmentsThrough(2), 1U);
+    EXPECT_FALSE(fs::exists(jubilant::storage::WalSegmentPath(dir, 0)));
+  }
+
+  // LSNs resume after the checkpoint marker even though the first segment is gone.
+  WalManager reopened{dir};
+  EXPECT_EQ(reopened.active_segment(), 1U);
+  EXPECT_EQ(reopened.next_lsn(), 5U);
+  EXPECT_GT(reopened.active_segment_bytes(), 0U);
+  const auto replay = reopened.Replay();
+  ASSERT_EQ(replay.committed.size(), 2U);
+  EXPECT_EQ(replay.committed.front().lsn, 3U);
+}
+
+TEST(WalManagerTest, ReplaysOnlyTheTailAfterACheckpointPosition) {
+  const auto dir = TempDir("jubilant-wal-position");
+  WalPosition checkpoint{};
+  {
+    WalManager wal{dir};
+    (void)wal.AppendMarker(RecordType::kTxnCommit, 1);
+    (void)wal.AppendMarker(RecordType::kTxnCommit, 2);
+    checkpoint = wal.end_position();
+    EXPECT_EQ(checkpoint.lsn, 2U);
+    (void)wal.AppendMarker(RecordType::kTxnCommit, 3);
+    (void)wal.AppendMarker(RecordType::kTxnCommit, 4);
+
+    const auto tail = wal.Replay(checkpoint);
+    ASSERT_EQ(tail.committed.size(), 2U);
+    EXPECT_EQ(tail.committed.front().lsn, 3U);
+    EXPECT_EQ(wal.Replay().committed.size(), 4U);
+
+    EXPECT_EQ(wal.Rollover(4), 5U);
+    (void)wal.AppendMarker(RecordType::kTxnCommit, 6);
+  }
+
+  {
+    // Segment 0 is bounded by the marker opening segment 1, without scanning segment 0.
+    WalManager wal{dir, WalEncoding::kFlatBuffer, checkpoint};
+    EXPECT_EQ(wal.next_lsn(), 7U);
+    EXPECT_EQ(wal.Replay(checkpoint).committed.size(), 4U);
+    EXPECT_EQ(wal.ReleaseSegmentsThrough(4), 1U);
+    const auto tail = wal.Replay(checkpoint);
+    ASSERT_EQ(tail.committed.size(), 2U);
+    EXPECT_EQ(tail.committed.front().lsn, 5U);
+  }
+
+  // An offset that is not a record boundary falls back to scanning the whole segment.
+  WalManager reopened{dir, WalEncoding::kFlatBuffer,
+                      WalPosition{.segment = 1, .offset = 3, .lsn = 4}};
+  EXPECT_FALSE(reopened.last_repair().truncated);
+  EXPECT_EQ(reopened.next_lsn(), 7U);
+}
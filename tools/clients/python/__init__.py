@@ -9,6 +9,7 @@ from .jubilant_client import (
     get_value,
     send_transaction,
     set_value,
+    set_value_chunked,
 )
 
 __all__ = [
@@ -20,4 +21,5 @@ __all__ = [
     "get_value",
     "send_transaction",
     "set_value",
+    "set_value_chunked",
 ]
@@ -5,12 +5,15 @@ import json
 import secrets
 import socket
 import struct
+import zlib
 from typing import Any, Dict, Iterable, Optional
 
 DEFAULT_HOST = "127.0.0.1"
 DEFAULT_PORT = 6767
 _MAX_TXN_ID = 2**63 - 1
 _LENGTH_PREFIX_FORMAT = "!I"
+_DURABILITY_CLASSES = ("async", "group", "sync")
+_MAX_FRAME_BYTES = 1 << 20
 
 
 class ProtocolError(RuntimeError):
@@ -27,17 +30,39 @@ def connect(
 
 
 def send_transaction(
-    sock: socket.socket, txn_id: int, operations: Iterable[Dict[str, Any]]
+    sock: socket.socket,
+    txn_id: int,
+    operations: Iterable[Dict[str, Any]],
+    *,
+    durability: Optional[str] = None,
+    raw_values: bool = False,
+    chunks: Optional[Iterable[bytes]] = None,
 ) -> Dict[str, Any]:
-    """Send a transaction request and return the parsed JSON response."""
+    """Send a transaction request and return the parsed JSON response.
+
+    ``durability`` may be ``"async"``, ``"group"`` (server default), or ``"sync"``.
+    With ``raw_values`` the server streams value-log backed results after the
+    response frame; each such value gains a ``raw`` entry holding its bytes,
+    decompressed when the server sent them zstd-compressed.
+    ``chunks`` supplies the bytes of any ``"encoding": "chunked"`` set values,
+    in operation order, each chunk at most 1 MiB.
+    """
     _validate_txn_id(txn_id)
 
     normalized_ops = [_normalize_operation(op) for op in operations]
     if not normalized_ops:
         raise ValueError("operations list must be non-empty")
 
-    request = {"txn_id": txn_id, "operations": normalized_ops}
+    request: Dict[str, Any] = {"txn_id": txn_id, "operations": normalized_ops}
+    if durability is not None:
+        if durability not in _DURABILITY_CLASSES:
+            raise ValueError(f"durability must be one of {', '.join(_DURABILITY_CLASSES)}")
+        request["durability"] = durability
+    if raw_values:
+        request["raw_values"] = True
     _send_frame(sock, request)
+    for chunk in chunks or ():
+        _send_chunk(sock, chunk)
     response = _recv_frame(sock)
 
     if not isinstance(response, dict):
@@ -45,6 +70,19 @@ def send_transaction(
     if response.get("txn_id") != txn_id:
         raise ProtocolError("response txn_id does not match request")
 
+    for operation in response.get("operations", []):
+        value = operation.get("value")
+        if isinstance(value, dict) and value.get("encoding") == "raw":
+            length = value.get("length")
+            if not isinstance(length, int) or length < 0:
+                raise ProtocolError("raw value length must be a non-negative integer")
+            data = _read_exact(sock, length)
+            if len(data) != length:
+                raise ProtocolError("connection closed before raw value was fully received")
+            if zlib.crc32(data) != value.get("crc32"):
+                raise ProtocolError("raw value failed its CRC check")
+            value["raw"] = _expand(value.get("codec"), data)
+
     return response
 
 
@@ -65,6 +103,40 @@ def set_value(
     )
 
 
+def set_value_chunked(
+    sock: socket.socket,
+    key: str,
+    data: bytes,
+    *,
+    kind: str = "bytes",
+    chunk_size: int = _MAX_FRAME_BYTES,
+    metadata: Optional[Dict[str, Any]] = None,
+    txn_id: Optional[int] = None,
+) -> Dict[str, Any]:
+    """Execute a single-key set whose value is uploaded in chunks.
+
+    Use this for values larger than the 1 MiB frame limit. ``data`` is raw
+    bytes for either kind; string values must already be UTF-8 encoded.
+    """
+    if kind not in {"bytes", "string"}:
+        raise ValueError("chunked values must be 'bytes' or 'string'")
+    if not 0 < chunk_size <= _MAX_FRAME_BYTES:
+        raise ValueError(f"chunk_size must be within 1..{_MAX_FRAME_BYTES}")
+    view = memoryview(data).cast("B")
+    if len(view) == 0:
+        raise ValueError("chunked values must be non-empty")
+
+    value: Dict[str, Any] = {"kind": kind, "encoding": "chunked", "length": len(view)}
+    if metadata:
+        value["metadata"] = metadata
+    return send_transaction(
+        sock,
+        txn_id if txn_id is not None else _next_txn_id(),
+        [{"type": "set", "key": key, "value": value}],
+        chunks=(view[i : i + chunk_size] for i in range(0, len(view), chunk_size)),
+    )
+
+
 def get_value(
     sock: socket.socket, key: str, *, txn_id: Optional[int] = None
 ) -> Dict[str, Any]:
@@ -154,6 +226,14 @@ def _normalize_value(value: Any) -> Dict[str, Any]:
     if not isinstance(value, dict):
         raise ValueError("value must be a mapping with kind/data")
 
+    if value.get("encoding") == "chunked":
+        if value.get("kind") not in {"bytes", "string"} or "data" in value:
+            raise ValueError("chunked values must be 'bytes' or 'string' without data")
+        length = value.get("length")
+        if not isinstance(length, int) or not 0 < length < 2**30:
+            raise ValueError("chunked values need a length within 1..2**30-1")
+        return dict(value)
+
     if "kind" not in value or "data" not in value:
         raise ValueError("value must include 'kind' and 'data'")
 
@@ -191,6 +271,31 @@ def _send_frame(sock: socket.socket, payload: Dict[str, Any]) -> None:
     sock.sendall(header + body)
 
 
+def _expand(codec: Optional[str], data: bytes) -> bytes:
+    if codec is None:
+        return data
+    if codec != "zstd":
+        raise ProtocolError(f"unsupported raw value codec: {codec}")
+    try:
+        from compression import zstd  # Python 3.14+
+
+        return zstd.decompress(data)
+    except ImportError:
+        pass
+    try:
+        import zstandard
+    except ImportError as exc:
+        raise ProtocolError("zstd raw values need Python 3.14+ or the zstandard package") from exc
+    return zstandard.ZstdDecompressor().decompress(data)
+
+
+def _send_chunk(sock: socket.socket, chunk: bytes) -> None:
+    if not 0 < len(chunk) <= _MAX_FRAME_BYTES:
+        raise ValueError(f"chunks must be within 1..{_MAX_FRAME_BYTES} bytes")
+    sock.sendall(struct.pack(_LENGTH_PREFIX_FORMAT, len(chunk)))
+    sock.sendall(chunk)
+
+
 def _recv_frame(sock: socket.socket) -> Any:
     length_prefix = _read_exact(sock, struct.calcsize(_LENGTH_PREFIX_FORMAT))
     if len(length_prefix) != struct.calcsize(_LENGTH_PREFIX_FORMAT):
@@ -1,6 +1,8 @@
+#include "meta/manifest.h"
 #include "remote_client.h"
 #include "storage/btree/btree.h"
 #include "storage/simple_store.h"
+#include "storage/wal/wal_manager.h"
 
 #include <chrono>
 #include <cstdlib>
@@ -45,6 +47,7 @@ struct RemoteOptions {
   jubilant::cli::RemoteTarget target{};
   std::optional<std::uint64_t> txn_id;
   std::chrono::milliseconds timeout{jubilant::cli::kDefaultRemoteTimeout};
+  std::optional<std::string> durability;
 };
 
 struct ParsedArgs {
@@ -53,7 +56,8 @@ struct ParsedArgs {
 };
 
 void PrintUsage() {
-  std::cout << "jubectl [--remote host:port] [--txn-id id] [--timeout-ms ms] <command> [args]\n"
+  std::cout << "jubectl [--remote host:port] [--txn-id id] [--timeout-ms ms]\n"
+            << "        [--durability async|group|sync] <command> [args]\n"
             << "Local commands (default, on-disk store):\n"
             << "  init <db_dir>\n"
             << "  set <db_dir> <key> <bytes|string|int> <value>\n"
@@ -61,6 +65,8 @@ void PrintUsage() {
             << "  del <db_dir> <key>\n"
             << "  stats <db_dir>\n"
             << "  validate <db_dir>\n"
+            << "  repair <db_dir>\n"
+            << "  gc <db_dir>\n"
             << "\n"
             << "Remote commands (--remote required, speak txn-wire-v0.0.2):\n"
             << "  set <key> <bytes|string|int> <value>\n"
@@ -124,6 +130,13 @@ std::chrono::milliseconds ParseTimeoutMs(std::string_view value) {
   }
 }
 
+std::string ParseDurability(std::string_view value) {
+  if (value != "async" && value != "group" && value != "sync") {
+    throw std::invalid_argument("Invalid --durability: expected async, group, or sync");
+  }
+  return std::string{value};
+}
+
 ParsedArgs ParseArguments(int argc, char** argv) {
   ParsedArgs parsed{};
 
@@ -151,6 +164,13 @@ ParsedArgs ParseArguments(int argc, char** argv) {
       parsed.remote.timeout = ParseTimeoutMs(argv[++i]);
       continue;
     }
+    if (arg == "--durability") {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("--durability requires a value");
+      }
+      parsed.remote.durability = ParseDurability(argv[++i]);
+      continue;
+    }
 
     parsed.positionals.assign(argv + i, argv + argc);
     break;
@@ -212,6 +232,9 @@ nlohmann::json BuildRemoteRequest(const RemoteOptions& remote,
   nlohmann::json request;
   request["txn_id"] = remote.txn_id.value_or(jubilant::cli::GenerateTxnId());
   request["operations"] = std::move(operations);
+  if (remote.durability.has_value()) {
+    request["durability"] = *remote.durability;
+  }
   return request;
 }
 
@@ -254,6 +277,10 @@ nlohmann::json NormalizeTransactionRequest(nlohmann::json request, const RemoteO
     request["txn_id"] = jubilant::cli::GenerateTxnId();
   }
 
+  if (remote.durability.has_value()) {
+    request["durability"] = *remote.durability;
+  }
+
   return request;
 }
 
@@ -311,13 +338,20 @@ int HandleStats(std::string_view db_dir) {
             << "Format: " << stats.manifest.format_major << '.' << stats.manifest.format_minor
             << "\n"
             << "Page size: " << stats.manifest.page_size
-            << ", inline threshold: " << stats.manifest.inline_threshold << "\n"
-            << "DB UUID: " << stats.manifest.db_uuid << "\n"
+            << ", inline threshold: " << stats.manifest.inline_threshold << "\n";
+  for (const auto& rule : stats.manifest.inline_rules) {
+    std::cout << "Inline rule \"" << rule.prefix << "\": " << rule.threshold << "\n";
+  }
+  std::cout << "DB UUID: " << stats.manifest.db_uuid << "\n"
             << "Superblock generation: " << stats.superblock.generation << "\n"
             << "Root page id: " << stats.superblock.root_page_id << "\n"
             << "Last checkpoint LSN: " << stats.superblock.last_checkpoint_lsn << "\n"
             << "Page count: " << stats.page_count << "\n"
             << "Key count: " << stats.key_count << "\n";
+  for (const auto& segment : stats.value_log_segments) {
+    std::cout << "Value log segment " << segment.segment_id << ": " << segment.live_bytes << "/"
+              << segment.total_bytes << " bytes live\n";
+  }
 
   return EXIT_SUCCESS;
 }
@@ -335,6 +369,53 @@ int HandleValidate(std::string_view db_dir) {
   return result.ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
+int HandleRepair(std::string_view db_dir) {
+  // The frame layout depends on the manifest's wal_schema; without a manifest there is nothing the
+  // server could have written yet, so the default encoding is as good as any.
+  auto encoding = jubilant::storage::wal::WalEncoding::kFlatBuffer;
+  if (const auto manifest = jubilant::meta::ManifestStore(db_dir).Load()) {
+    // Repairing a retired framing with the current one would truncate every record.
+    if (jubilant::storage::wal::IsRetiredWalSchema(manifest->wal_schema)) {
+      std::cerr << "WAL schema " << manifest->wal_schema
+                << " uses the retired embedded-CRC framing; refusing to repair\n";
+      return EXIT_FAILURE;
+    }
+    const auto parsed = jubilant::storage::wal::ParseWalSchema(manifest->wal_schema);
+    if (!parsed.has_value()) {
+      std::cerr << "Unsupported WAL schema in MANIFEST: " << manifest->wal_schema << "\n";
+      return EXIT_FAILURE;
+    }
+    encoding = *parsed;
+  }
+
+  const auto report = jubilant::storage::wal::WalManager::RepairTail(db_dir, encoding);
+
+  std::cout << "WAL: " << report.wal_path.string() << "\n"
+            << "Records scanned: " << report.records_scanned
+            << ", last valid LSN: " << report.last_valid_lsn << "\n"
+            << "Valid bytes: " << report.valid_bytes << "\n";
+  if (report.truncated) {
+    std::cout << "Repair: TRUNCATED - discarded " << report.discarded_bytes
+              << " bytes of torn tail\n";
+  } else {
+    std::cout << "Repair: OK - no torn tail found\n";
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int HandleGc(std::string_view db_dir) {
+  auto store = jubilant::storage::SimpleStore::Open(db_dir);
+  const auto report = store.CollectValueLogGarbage();
+  // Sync checkpoints the repointed leaves, which is what lets the retired segments go.
+  store.Sync();
+
+  std::cout << "Segments retired: " << report.retired_segments.size() << "\n"
+            << "Records relocated: " << report.records_relocated << " ("
+            << report.bytes_relocated << " bytes)\n";
+  return EXIT_SUCCESS;
+}
+
 } // namespace
 
 int main(int argc, char** argv) {
@@ -445,6 +526,22 @@ int main(int argc, char** argv) {
       return HandleValidate(parsed.positionals[1]);
     }
 
+    if (command == "repair") {
+      if (parsed.remote.enabled || parsed.positionals.size() != 2) {
+        PrintUsage();
+        return EXIT_FAILURE;
+      }
+      return HandleRepair(parsed.positionals[1]);
+    }
+
+    if (command == "gc") {
+      if (parsed.remote.enabled || parsed.positionals.size() != 2) {
+        PrintUsage();
+        return EXIT_FAILURE;
+      }
+      return HandleGc(parsed.positionals[1]);
+    }
+
     std::cerr << "Command '" << command << "' not yet implemented.\n";
     PrintUsage();
     return EXIT_FAILURE;